@@ -0,0 +1,423 @@
+/**
+ * Throughput benchmarks for datapacker, run with `meson test --benchmark` or directly with
+ * `./benchmarks/datapacker_bench --benchmark_filter=<regex>`
+ */
+#include "datapacker.h"
+#include "datapacker/integer_codecs.h"
+#include <benchmark/benchmark.h>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using datapacker::endian;
+namespace bytes = datapacker::bytes;
+namespace stream = datapacker::stream;
+
+// Number of values encoded/decoded in every iteration of the scalar benchmarks
+constexpr size_t SCALARS_PER_ITERATION = 1024;
+
+// Sequences of 16 to 1M elements
+static void sequence_sizes(benchmark::internal::Benchmark *b)
+{
+    b->RangeMultiplier(16)->Range(16, 1 << 20);
+}
+
+template <typename T> static std::vector<T> make_values(size_t n)
+{
+    std::vector<T> values(n);
+    for (size_t i = 0; i < n; ++i)
+    {
+        if constexpr (std::is_floating_point<T>::value)
+            values[i] = static_cast<T>(i) * static_cast<T>(1.25) - static_cast<T>(n);
+        else
+            values[i] = static_cast<T>(i * 2654435761u);
+    }
+    return values;
+}
+
+template <typename T, endian endianness> static void BM_EncodeScalar(benchmark::State &state)
+{
+    auto values = make_values<T>(SCALARS_PER_ITERATION);
+    std::vector<uint8_t> buffer(SCALARS_PER_ITERATION * sizeof(T));
+    for (auto _ : state)
+    {
+        uint8_t *p = buffer.data();
+        for (const T &value : values)
+            p += bytes::encode<endianness>(p, value);
+        benchmark::DoNotOptimize(buffer.data());
+        benchmark::ClobberMemory();
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * buffer.size()));
+}
+
+template <typename T, endian endianness> static void BM_DecodeScalar(benchmark::State &state)
+{
+    auto values = make_values<T>(SCALARS_PER_ITERATION);
+    std::vector<uint8_t> buffer(SCALARS_PER_ITERATION * sizeof(T));
+    bytes::encode_array<endianness>(buffer.data(), values.data(), values.size());
+    for (auto _ : state)
+    {
+        const uint8_t *p = buffer.data();
+        for (T &value : values)
+            p += bytes::decode<endianness>(p, value);
+        benchmark::DoNotOptimize(values.data());
+        benchmark::ClobberMemory();
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * buffer.size()));
+}
+
+#define SCALAR_BENCHMARKS(type)                                                                   \
+    BENCHMARK_TEMPLATE(BM_EncodeScalar, type, endian::little);                                    \
+    BENCHMARK_TEMPLATE(BM_EncodeScalar, type, endian::big);                                       \
+    BENCHMARK_TEMPLATE(BM_DecodeScalar, type, endian::little);                                    \
+    BENCHMARK_TEMPLATE(BM_DecodeScalar, type, endian::big)
+
+SCALAR_BENCHMARKS(uint8_t);
+SCALAR_BENCHMARKS(uint16_t);
+SCALAR_BENCHMARKS(uint32_t);
+SCALAR_BENCHMARKS(uint64_t);
+SCALAR_BENCHMARKS(int32_t);
+SCALAR_BENCHMARKS(float);
+SCALAR_BENCHMARKS(double);
+
+// The portable shift and mask implementations of encode_le/encode_be and decode_le/decode_be, to
+// compare with the memcpy and byte swap path used by BM_EncodeScalar and BM_DecodeScalar. The
+// shifts are only as fast when the compiler turns them into a single load or store
+template <typename T, endian endianness> static void BM_EncodeShifts(benchmark::State &state)
+{
+    auto values = make_values<T>(SCALARS_PER_ITERATION);
+    std::vector<uint8_t> buffer(SCALARS_PER_ITERATION * sizeof(T));
+    for (auto _ : state)
+    {
+        uint8_t *p = buffer.data();
+        for (const T &value : values)
+        {
+            if constexpr (endianness == endian::little)
+                p += datapacker::internal::encode_le_shifts(p, value);
+            else
+                p += datapacker::internal::encode_be_shifts(p, value);
+        }
+        benchmark::DoNotOptimize(buffer.data());
+        benchmark::ClobberMemory();
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * buffer.size()));
+}
+
+template <typename T, endian endianness> static void BM_DecodeShifts(benchmark::State &state)
+{
+    auto values = make_values<T>(SCALARS_PER_ITERATION);
+    std::vector<uint8_t> buffer(SCALARS_PER_ITERATION * sizeof(T));
+    bytes::encode_array<endianness>(buffer.data(), values.data(), values.size());
+    for (auto _ : state)
+    {
+        const uint8_t *p = buffer.data();
+        for (T &value : values)
+        {
+            if constexpr (endianness == endian::little)
+                p += datapacker::internal::decode_le_shifts(p, value);
+            else
+                p += datapacker::internal::decode_be_shifts(p, value);
+        }
+        benchmark::DoNotOptimize(values.data());
+        benchmark::ClobberMemory();
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * buffer.size()));
+}
+
+#define SHIFT_BENCHMARKS(type)                                                                    \
+    BENCHMARK_TEMPLATE(BM_EncodeShifts, type, endian::little);                                    \
+    BENCHMARK_TEMPLATE(BM_EncodeShifts, type, endian::big);                                       \
+    BENCHMARK_TEMPLATE(BM_DecodeShifts, type, endian::little);                                    \
+    BENCHMARK_TEMPLATE(BM_DecodeShifts, type, endian::big)
+
+SHIFT_BENCHMARKS(uint16_t);
+SHIFT_BENCHMARKS(uint32_t);
+SHIFT_BENCHMARKS(uint64_t);
+
+// A message header made of values of every width, encoded with a single variadic call
+template <endian endianness> static void BM_EncodeVariadic(benchmark::State &state)
+{
+    constexpr size_t message_size = 1 + 2 + 4 + 8 + 4 + 8;
+    std::vector<uint8_t> buffer(SCALARS_PER_ITERATION * message_size);
+    for (auto _ : state)
+    {
+        uint8_t *p = buffer.data();
+        for (size_t i = 0; i < SCALARS_PER_ITERATION; ++i)
+        {
+            p += bytes::encode<endianness>(p, static_cast<uint8_t>(i), static_cast<uint16_t>(i),
+                                           static_cast<uint32_t>(i), static_cast<uint64_t>(i),
+                                           static_cast<float>(i), static_cast<double>(i));
+        }
+        benchmark::DoNotOptimize(buffer.data());
+        benchmark::ClobberMemory();
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * buffer.size()));
+}
+BENCHMARK_TEMPLATE(BM_EncodeVariadic, endian::little);
+BENCHMARK_TEMPLATE(BM_EncodeVariadic, endian::big);
+
+template <endian endianness> static void BM_DecodeVariadic(benchmark::State &state)
+{
+    constexpr size_t message_size = 1 + 2 + 4 + 8 + 4 + 8;
+    std::vector<uint8_t> buffer(SCALARS_PER_ITERATION * message_size);
+    uint8_t a;
+    uint16_t b;
+    uint32_t c;
+    uint64_t d;
+    float e;
+    double f;
+    for (auto _ : state)
+    {
+        const uint8_t *p = buffer.data();
+        for (size_t i = 0; i < SCALARS_PER_ITERATION; ++i)
+        {
+            p += bytes::decode<endianness>(p, a, b, c, d, e, f);
+            benchmark::DoNotOptimize(a);
+            benchmark::DoNotOptimize(b);
+            benchmark::DoNotOptimize(c);
+            benchmark::DoNotOptimize(d);
+            benchmark::DoNotOptimize(e);
+            benchmark::DoNotOptimize(f);
+        }
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * buffer.size()));
+}
+BENCHMARK_TEMPLATE(BM_DecodeVariadic, endian::little);
+BENCHMARK_TEMPLATE(BM_DecodeVariadic, endian::big);
+
+// The same message header as an aggregate, encoded with encode_struct
+struct MessageHeader
+{
+    uint8_t a;
+    uint16_t b;
+    uint32_t c;
+    uint64_t d;
+    float e;
+    double f;
+};
+
+template <endian endianness> static void BM_EncodeStruct(benchmark::State &state)
+{
+    std::vector<MessageHeader> headers(SCALARS_PER_ITERATION);
+    for (size_t i = 0; i < headers.size(); ++i)
+    {
+        headers[i] = {static_cast<uint8_t>(i),  static_cast<uint16_t>(i), static_cast<uint32_t>(i),
+                      static_cast<uint64_t>(i), static_cast<float>(i),    static_cast<double>(i)};
+    }
+    std::vector<uint8_t> buffer(SCALARS_PER_ITERATION * bytes::struct_size<MessageHeader>);
+    for (auto _ : state)
+    {
+        uint8_t *p = buffer.data();
+        for (const auto &header : headers)
+            p += bytes::encode_struct<endianness>(p, header);
+        benchmark::DoNotOptimize(buffer.data());
+        benchmark::ClobberMemory();
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * buffer.size()));
+}
+BENCHMARK_TEMPLATE(BM_EncodeStruct, endian::little);
+BENCHMARK_TEMPLATE(BM_EncodeStruct, endian::big);
+
+template <endian endianness> static void BM_DecodeStruct(benchmark::State &state)
+{
+    std::vector<uint8_t> buffer(SCALARS_PER_ITERATION * bytes::struct_size<MessageHeader>);
+    MessageHeader header;
+    for (auto _ : state)
+    {
+        const uint8_t *p = buffer.data();
+        for (size_t i = 0; i < SCALARS_PER_ITERATION; ++i)
+        {
+            p += bytes::decode_struct<endianness>(p, header);
+            benchmark::DoNotOptimize(header);
+        }
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * buffer.size()));
+}
+BENCHMARK_TEMPLATE(BM_DecodeStruct, endian::little);
+BENCHMARK_TEMPLATE(BM_DecodeStruct, endian::big);
+
+template <typename T, endian endianness> static void BM_EncodeArray(benchmark::State &state)
+{
+    auto values = make_values<T>(static_cast<size_t>(state.range(0)));
+    std::vector<uint8_t> buffer(values.size() * sizeof(T));
+    for (auto _ : state)
+    {
+        bytes::encode_array<endianness>(buffer.data(), values.data(), values.size());
+        benchmark::DoNotOptimize(buffer.data());
+        benchmark::ClobberMemory();
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * buffer.size()));
+}
+
+template <typename T, endian endianness> static void BM_DecodeArray(benchmark::State &state)
+{
+    auto values = make_values<T>(static_cast<size_t>(state.range(0)));
+    std::vector<uint8_t> buffer(values.size() * sizeof(T));
+    bytes::encode_array<endianness>(buffer.data(), values.data(), values.size());
+    for (auto _ : state)
+    {
+        bytes::decode_array<endianness>(buffer.data(), values.data(), values.size());
+        benchmark::DoNotOptimize(values.data());
+        benchmark::ClobberMemory();
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * buffer.size()));
+}
+
+#define ARRAY_BENCHMARKS(type)                                                                    \
+    BENCHMARK_TEMPLATE(BM_EncodeArray, type, endian::little)->Apply(sequence_sizes);              \
+    BENCHMARK_TEMPLATE(BM_EncodeArray, type, endian::big)->Apply(sequence_sizes);                 \
+    BENCHMARK_TEMPLATE(BM_DecodeArray, type, endian::little)->Apply(sequence_sizes);              \
+    BENCHMARK_TEMPLATE(BM_DecodeArray, type, endian::big)->Apply(sequence_sizes)
+
+ARRAY_BENCHMARKS(uint16_t);
+ARRAY_BENCHMARKS(uint32_t);
+ARRAY_BENCHMARKS(uint64_t);
+ARRAY_BENCHMARKS(double);
+
+// Millisecond timestamps with small jitter, bytes processed is the size of the raw int64 values
+static std::vector<int64_t> make_timestamps(size_t n)
+{
+    std::vector<int64_t> values(n);
+    for (size_t i = 0; i < n; ++i)
+        values[i] = 1700000000000LL + static_cast<int64_t>(i * 1000 + (i * 2654435761u) % 50);
+    return values;
+}
+
+template <typename Codec> static void BM_EncodeIntegers(benchmark::State &state)
+{
+    auto values = make_timestamps(static_cast<size_t>(state.range(0)));
+    std::vector<uint8_t> buffer(bytes::integers_bound<Codec, int64_t>(values.size()));
+    int n = 0;
+    for (auto _ : state)
+    {
+        n = bytes::encode_integers<Codec, endian::little>(buffer.data(), values);
+        benchmark::DoNotOptimize(buffer.data());
+        benchmark::ClobberMemory();
+    }
+    state.counters["encoded_bytes"] = n;
+    state.SetBytesProcessed(
+        static_cast<int64_t>(state.iterations() * values.size() * sizeof(int64_t)));
+}
+
+template <typename Codec> static void BM_DecodeIntegers(benchmark::State &state)
+{
+    auto values = make_timestamps(static_cast<size_t>(state.range(0)));
+    std::vector<uint8_t> buffer(bytes::integers_bound<Codec, int64_t>(values.size()));
+    int n = bytes::encode_integers<Codec, endian::little>(buffer.data(), values);
+    for (auto _ : state)
+    {
+        bytes::decode_integers<Codec, endian::little>(buffer.data(), static_cast<size_t>(n),
+                                                      values, values.size());
+        benchmark::DoNotOptimize(values.data());
+        benchmark::ClobberMemory();
+    }
+    state.counters["encoded_bytes"] = n;
+    state.SetBytesProcessed(
+        static_cast<int64_t>(state.iterations() * values.size() * sizeof(int64_t)));
+}
+
+#define INTEGER_CODEC_BENCHMARKS(codec)                                                           \
+    BENCHMARK_TEMPLATE(BM_EncodeIntegers, codec)->Apply(sequence_sizes);                          \
+    BENCHMARK_TEMPLATE(BM_DecodeIntegers, codec)->Apply(sequence_sizes)
+
+INTEGER_CODEC_BENCHMARKS(bytes::fixed_width_codec);
+INTEGER_CODEC_BENCHMARKS(bytes::delta_codec);
+INTEGER_CODEC_BENCHMARKS(bytes::frame_of_reference_codec);
+
+// Unpacking of one frame_of_reference_codec block of values with `state.range(0)` bits, with the
+// kernel selected for the cpu when `dispatched` is true and with the scalar loop otherwise
+template <bool dispatched> static void BM_UnpackBits(benchmark::State &state)
+{
+    constexpr size_t n = datapacker::FRAME_OF_REFERENCE_BLOCK_SIZE;
+    unsigned width = static_cast<unsigned>(state.range(0));
+    uint64_t mask = width == 64 ? ~uint64_t{0} : (uint64_t{1} << width) - 1;
+    std::vector<uint64_t> values(n);
+    for (size_t i = 0; i < n; ++i)
+        values[i] = (i * 2654435761u) & mask;
+    std::vector<uint8_t> buffer(n * sizeof(uint64_t) + 16);
+    datapacker::internal::pack_bits(buffer.data(), values.data(), n, width);
+    for (auto _ : state)
+    {
+        if constexpr (dispatched)
+            datapacker::internal::unpack_bits(buffer.data(), values.data(), n, width);
+        else
+            datapacker::internal::unpack_bits_scalar(buffer.data(), values.data(), 0, n, width,
+                                                     mask);
+        benchmark::DoNotOptimize(values.data());
+        benchmark::ClobberMemory();
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * n * sizeof(uint64_t)));
+}
+BENCHMARK_TEMPLATE(BM_UnpackBits, true)->Arg(3)->Arg(13)->Arg(24)->Arg(40);
+BENCHMARK_TEMPLATE(BM_UnpackBits, false)->Arg(3)->Arg(13)->Arg(24)->Arg(40);
+
+static void BM_EncodeString(benchmark::State &state)
+{
+    std::string s(static_cast<size_t>(state.range(0)), 'x');
+    std::vector<uint8_t> buffer(sizeof(size_t) + s.size());
+    for (auto _ : state)
+    {
+        bytes::encode_length_prefixed<endian::big>(buffer.data(), s);
+        benchmark::DoNotOptimize(buffer.data());
+        benchmark::ClobberMemory();
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * buffer.size()));
+}
+BENCHMARK(BM_EncodeString)->Apply(sequence_sizes);
+
+static void BM_DecodeString(benchmark::State &state)
+{
+    std::string s(static_cast<size_t>(state.range(0)), 'x');
+    std::vector<uint8_t> buffer(sizeof(size_t) + s.size());
+    bytes::encode_length_prefixed<endian::big>(buffer.data(), s);
+    for (auto _ : state)
+    {
+        bytes::decode_length_prefixed<endian::big>(buffer.data(), s, s.size());
+        benchmark::DoNotOptimize(s.data());
+        benchmark::ClobberMemory();
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * buffer.size()));
+}
+BENCHMARK(BM_DecodeString)->Apply(sequence_sizes);
+
+// Writes and reads back many small fields through std::stringstream
+template <endian endianness> static void BM_StreamScalarRoundTrip(benchmark::State &state)
+{
+    std::stringstream ss;
+    for (auto _ : state)
+    {
+        ss.str(std::string());
+        ss.clear();
+        for (size_t i = 0; i < SCALARS_PER_ITERATION; ++i)
+            stream::write<endianness>(ss, static_cast<uint32_t>(i));
+        uint32_t value = 0;
+        for (size_t i = 0; i < SCALARS_PER_ITERATION; ++i)
+            stream::read<endianness>(ss, value);
+        benchmark::DoNotOptimize(value);
+    }
+    state.SetBytesProcessed(
+        static_cast<int64_t>(state.iterations() * SCALARS_PER_ITERATION * sizeof(uint32_t)));
+}
+BENCHMARK_TEMPLATE(BM_StreamScalarRoundTrip, endian::little);
+BENCHMARK_TEMPLATE(BM_StreamScalarRoundTrip, endian::big);
+
+template <endian endianness> static void BM_StreamVectorRoundTrip(benchmark::State &state)
+{
+    auto values = make_values<uint32_t>(static_cast<size_t>(state.range(0)));
+    std::vector<uint32_t> decoded;
+    std::stringstream ss;
+    for (auto _ : state)
+    {
+        ss.str(std::string());
+        ss.clear();
+        stream::write<endianness>(ss, values);
+        stream::read<endianness>(ss, decoded, values.size());
+        benchmark::DoNotOptimize(decoded.data());
+    }
+    state.SetBytesProcessed(
+        static_cast<int64_t>(state.iterations() * values.size() * sizeof(uint32_t)));
+}
+BENCHMARK_TEMPLATE(BM_StreamVectorRoundTrip, endian::little)->Apply(sequence_sizes);
+BENCHMARK_TEMPLATE(BM_StreamVectorRoundTrip, endian::big)->Apply(sequence_sizes);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,182 @@
+/**
+ * Benchmarks of the parsers in datapacker/formats, which decode a header with a record schema,
+ * compared with a chain of `decode_le`/`decode_be` calls and with hand written memcpy and byte
+ * swaps at fixed offsets, which is the fastest that the schema decoder can be
+ */
+#include "datapacker.h"
+#include "datapacker/formats/bmp.h"
+#include "datapacker/formats/png.h"
+#include "datapacker/formats/wav.h"
+#include <benchmark/benchmark.h>
+#include <vector>
+
+using datapacker::endian;
+namespace bytes = datapacker::bytes;
+namespace formats = datapacker::formats;
+
+// Number of headers decoded in every iteration, from different parts of a buffer
+constexpr size_t HEADERS_PER_ITERATION = 1024;
+
+template <typename Header> static std::vector<uint8_t> make_headers(const Header &header)
+{
+    constexpr size_t size = bytes::packed_size<Header>;
+    std::vector<uint8_t> buffer(HEADERS_PER_ITERATION * size);
+    for (size_t i = 0; i < HEADERS_PER_ITERATION; ++i)
+        bytes::encode_record(buffer.data() + i * size, header);
+    return buffer;
+}
+
+template <typename T> static T load(const uint8_t *p)
+{
+    T value;
+    memcpy(&value, p, sizeof(T));
+    return value;
+}
+
+template <typename T> static T load_be(const uint8_t *p)
+{
+    T value = load<T>(p);
+    if constexpr (std::endian::native == std::endian::little && sizeof(T) > 1)
+        value = datapacker::internal::byteswap(value);
+    return value;
+}
+
+template <typename T> static T load_le(const uint8_t *p)
+{
+    T value = load<T>(p);
+    if constexpr (std::endian::native == std::endian::big && sizeof(T) > 1)
+        value = datapacker::internal::byteswap(value);
+    return value;
+}
+
+static bool parse_bmp_chain(const uint8_t *data, size_t size, formats::bmp_header &h)
+{
+    if (size < 54)
+        return false;
+    uint32_t reserved;
+    bytes::decode_le(data, h.signature, h.size, reserved, h.starting_offset, h.dib_header_size,
+                     h.width, h.height, h.color_planes, h.bpp, h.compression, h.image_size,
+                     h.horizontal_resolution, h.vertical_resolution, h.palette_colors,
+                     h.imp_colors);
+    return h.signature == formats::BMP_SIGNATURE && h.dib_header_size >= 40;
+}
+
+static bool parse_bmp_memcpy(const uint8_t *data, size_t size, formats::bmp_header &h)
+{
+    if (size < 54)
+        return false;
+    h.signature = load_le<uint16_t>(data);
+    h.size = load_le<uint32_t>(data + 2);
+    h.starting_offset = load_le<uint32_t>(data + 10);
+    h.dib_header_size = load_le<uint32_t>(data + 14);
+    h.width = load_le<int32_t>(data + 18);
+    h.height = load_le<int32_t>(data + 22);
+    h.color_planes = load_le<uint16_t>(data + 26);
+    h.bpp = load_le<uint16_t>(data + 28);
+    h.compression = load_le<uint32_t>(data + 30);
+    h.image_size = load_le<uint32_t>(data + 34);
+    h.horizontal_resolution = load_le<int32_t>(data + 38);
+    h.vertical_resolution = load_le<int32_t>(data + 42);
+    h.palette_colors = load_le<uint32_t>(data + 46);
+    h.imp_colors = load_le<uint32_t>(data + 50);
+    return h.signature == formats::BMP_SIGNATURE && h.dib_header_size >= 40;
+}
+
+static bool parse_wav_chain(const uint8_t *data, size_t size, formats::wav_header &h)
+{
+    if (size < 36)
+        return false;
+    bytes::decode_be(data, h.riff_id);
+    bytes::decode_le(data + 4, h.riff_size);
+    bytes::decode_be(data + 8, h.wave_id, h.fmt_id);
+    bytes::decode_le(data + 16, h.fmt_size, h.audio_format, h.channels, h.sample_rate,
+                     h.byte_rate, h.block_align, h.bits_per_sample);
+    return h.riff_id == formats::fourcc("RIFF") && h.wave_id == formats::fourcc("WAVE") &&
+           h.fmt_id == formats::fourcc("fmt ") && h.fmt_size >= 16;
+}
+
+static bool parse_wav_memcpy(const uint8_t *data, size_t size, formats::wav_header &h)
+{
+    if (size < 36)
+        return false;
+    h.riff_id = load_be<uint32_t>(data);
+    h.riff_size = load_le<uint32_t>(data + 4);
+    h.wave_id = load_be<uint32_t>(data + 8);
+    h.fmt_id = load_be<uint32_t>(data + 12);
+    h.fmt_size = load_le<uint32_t>(data + 16);
+    h.audio_format = load_le<uint16_t>(data + 20);
+    h.channels = load_le<uint16_t>(data + 22);
+    h.sample_rate = load_le<uint32_t>(data + 24);
+    h.byte_rate = load_le<uint32_t>(data + 28);
+    h.block_align = load_le<uint16_t>(data + 32);
+    h.bits_per_sample = load_le<uint16_t>(data + 34);
+    return h.riff_id == formats::fourcc("RIFF") && h.wave_id == formats::fourcc("WAVE") &&
+           h.fmt_id == formats::fourcc("fmt ") && h.fmt_size >= 16;
+}
+
+static bool parse_png_chain(const uint8_t *data, size_t size, formats::png_header &h)
+{
+    if (size < 33)
+        return false;
+    bytes::decode_be(data, h.signature, h.ihdr_length, h.ihdr_type, h.width, h.height,
+                     h.bit_depth, h.color_type, h.compression, h.filter, h.interlace, h.crc);
+    return h.signature == formats::PNG_SIGNATURE && h.ihdr_length == 13 &&
+           h.ihdr_type == formats::fourcc("IHDR") && h.width != 0 && h.height != 0;
+}
+
+static bool parse_png_memcpy(const uint8_t *data, size_t size, formats::png_header &h)
+{
+    if (size < 33)
+        return false;
+    h.signature = load_be<uint64_t>(data);
+    h.ihdr_length = load_be<uint32_t>(data + 8);
+    h.ihdr_type = load_be<uint32_t>(data + 12);
+    h.width = load_be<uint32_t>(data + 16);
+    h.height = load_be<uint32_t>(data + 20);
+    h.bit_depth = data[24];
+    h.color_type = data[25];
+    h.compression = data[26];
+    h.filter = data[27];
+    h.interlace = data[28];
+    h.crc = load_be<uint32_t>(data + 29);
+    return h.signature == formats::PNG_SIGNATURE && h.ihdr_length == 13 &&
+           h.ihdr_type == formats::fourcc("IHDR") && h.width != 0 && h.height != 0;
+}
+
+static const formats::bmp_header bmp = {formats::BMP_SIGNATURE, 1920054, 54, 40, 800, -600, 1,
+                                        32, 0, 1920000, 2835, 2835, 0, 0};
+static const formats::wav_header wav = {formats::fourcc("RIFF"), 88236, formats::fourcc("WAVE"),
+                                        formats::fourcc("fmt "), 16, 1, 2, 44100, 176400, 4, 16};
+static const formats::png_header png = {formats::PNG_SIGNATURE, 13, formats::fourcc("IHDR"), 640,
+                                        480, 8, 6, 0, 0, 0, 0x12345678};
+
+template <typename Header, bool (*parse)(const uint8_t *, size_t, Header &), const Header &header>
+static void BM_Parse(benchmark::State &state)
+{
+    constexpr size_t size = bytes::packed_size<Header>;
+    auto buffer = make_headers(header);
+    Header h;
+    for (auto _ : state)
+    {
+        for (size_t i = 0; i < HEADERS_PER_ITERATION; ++i)
+        {
+            bool valid = parse(buffer.data() + i * size, size, h);
+            benchmark::DoNotOptimize(valid);
+            benchmark::DoNotOptimize(h);
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * HEADERS_PER_ITERATION));
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * buffer.size()));
+}
+
+#define PARSER_BENCHMARKS(format)                                                                 \
+    BENCHMARK_TEMPLATE(BM_Parse, formats::format##_header, formats::parse_##format##_header,      \
+                       format);                                                                   \
+    BENCHMARK_TEMPLATE(BM_Parse, formats::format##_header, parse_##format##_chain, format);       \
+    BENCHMARK_TEMPLATE(BM_Parse, formats::format##_header, parse_##format##_memcpy, format)
+
+PARSER_BENCHMARKS(bmp);
+PARSER_BENCHMARKS(wav);
+PARSER_BENCHMARKS(png);
+
+BENCHMARK_MAIN();
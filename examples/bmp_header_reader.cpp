@@ -4,9 +4,9 @@
  * possible that this application fails to work with some BMP files
  */
 #include "../include/datapacker.h"
-#include <assert.h>
+#include "../include/datapacker/formats/bmp.h"
+#include "../include/datapacker/mapped_file.h"
 #include <iostream>
-#include <stdio.h>
 
 int main(int argc, char *argv[])
 {
@@ -15,60 +15,34 @@ int main(int argc, char *argv[])
         std::cerr << "Usage: ./a.out <filename.bmp>" << std::endl;
         exit(1);
     }
-    FILE *fp = fopen(argv[1], "rb");
-    if (!fp)
+    datapacker::formats::bmp_header header;
+    try
     {
-        std::cerr << "Could not open image file" << std::endl;
-        exit(1);
-    }
-    uint8_t buffer[54];
-    if (fread(buffer, 54, 1, fp) != 1)
-    {
-        std::cerr << "Could not read BMP header" << std::endl;
-        exit(1);
+        // The header is decoded directly from the mapping, without reading the file into a buffer
+        datapacker::mapped_file file(argv[1]);
+        if (!datapacker::formats::parse_bmp_header(file.data(), file.size(), header))
+        {
+            std::cerr << "Not a BMP file" << std::endl;
+            exit(1);
+        }
     }
-    if (!(buffer[0] == 'B' && buffer[1] == 'M'))
+    catch (const std::system_error &e)
     {
-        std::cerr << "Not a BMP file" << std::endl;
+        std::cerr << "Could not open image file: " << e.what() << std::endl;
         exit(1);
     }
 
-    uint8_t *bufptr = buffer;
-    bufptr = bufptr + 2;
-
-    uint32_t size;
-    uint32_t reserved;
-    uint32_t starting_offset;
-    uint32_t dib_header_size;
-    int32_t width;
-    int32_t height;
-    uint16_t color_planes;
-    uint16_t bpp;
-    uint32_t compression;
-    uint32_t image_size;
-    int32_t horizontal_resolution;
-    int32_t vertical_resolution;
-    uint32_t palette_colors;
-    uint32_t imp_colors;
-
-    datapacker::bytes::decode_le(bufptr, size, reserved, starting_offset, dib_header_size, width,
-                             height, color_planes, bpp, compression, image_size,
-                             horizontal_resolution, vertical_resolution, palette_colors,
-                             imp_colors);
-
-    std::cout << "BMP File size: " << size << std::endl;
-    std::cout << "Starting offset: " << starting_offset << std::endl;
-    std::cout << "DIB Header size: " << dib_header_size << std::endl;
-    std::cout << "Image width: " << width << std::endl;
-    std::cout << "Image height: " << height << std::endl;
-    std::cout << "Color planes: " << color_planes << std::endl;
-    std::cout << "Bits per pixel: " << bpp << std::endl;
-    std::cout << "Compression: " << compression << std::endl;
-    std::cout << "Raw image size: " << image_size << std::endl;
-    std::cout << "Horizontal resolution: " << horizontal_resolution << std::endl;
-    std::cout << "Vertical resolution: " << vertical_resolution << std::endl;
-    std::cout << "Palette colors: " << palette_colors << std::endl;
-    std::cout << "Important colors: " << imp_colors << std::endl;
-
-    fclose(fp);
-}
\ No newline at end of file
+    std::cout << "BMP File size: " << header.size << std::endl;
+    std::cout << "Starting offset: " << header.starting_offset << std::endl;
+    std::cout << "DIB Header size: " << header.dib_header_size << std::endl;
+    std::cout << "Image width: " << header.width << std::endl;
+    std::cout << "Image height: " << header.height << std::endl;
+    std::cout << "Color planes: " << header.color_planes << std::endl;
+    std::cout << "Bits per pixel: " << header.bpp << std::endl;
+    std::cout << "Compression: " << header.compression << std::endl;
+    std::cout << "Raw image size: " << header.image_size << std::endl;
+    std::cout << "Horizontal resolution: " << header.horizontal_resolution << std::endl;
+    std::cout << "Vertical resolution: " << header.vertical_resolution << std::endl;
+    std::cout << "Palette colors: " << header.palette_colors << std::endl;
+    std::cout << "Important colors: " << header.imp_colors << std::endl;
+}
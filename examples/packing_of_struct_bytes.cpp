@@ -31,6 +31,14 @@ struct ExperimentData
     }
 };
 
+// The fixed size fields of the struct, the sequences are written separately after them
+template <>
+struct datapacker::bytes::schema<ExperimentData>
+    : layout<field<&ExperimentData::experiment_code>, field<&ExperimentData::location_id>,
+             field<&ExperimentData::timestamp>>
+{
+};
+
 std::ostream &print_binary_data(std::ostream &os, std::vector<uint8_t> &bytes)
 {
     for (const auto &byt : bytes)
@@ -57,40 +65,36 @@ int main()
     data.experiment_name = "This is a super important experiment!";
     data.samples = {1.15f, -1.32f, 0.1f, 5.614f, 3.1415, 6.623e23, 9e10 - 9, 1.45f, 1.3213e21f};
 
-    std::vector<uint8_t> buffer(sizeof(data.experiment_code) + sizeof(data.location_id) +
-                                sizeof(size_t) + data.experiment_name.size() + sizeof(size_t) +
-                                data.samples.size() * sizeof(float) + sizeof(data.timestamp));
-    uint8_t *buffer_ptr = buffer.data();
-
-    auto n = datapacker::bytes::encode<datapacker::endian::little>(
-        buffer_ptr, data.experiment_code, data.location_id, data.timestamp);
-
-    buffer_ptr += n;
+    std::vector<uint8_t> buffer(
+        datapacker::bytes::encoded_size(data, data.experiment_name, data.samples));
+    datapacker::bytes::writer w(buffer.data(), buffer.size());
 
-    n = datapacker::bytes::encode_length_prefixed<datapacker::endian::little>(buffer_ptr,
-                                                                              data.experiment_name);
-    buffer_ptr += n;
+    w.put_record(data)
+        .put_length_prefixed<datapacker::endian::little>(data.experiment_name)
+        .put_length_prefixed<datapacker::endian::little>(data.samples);
 
-    n = datapacker::bytes::encode_length_prefixed<datapacker::endian::little>(buffer_ptr,
-                                                                              data.samples);
+    if (!w)
+    {
+        std::cerr << "Buffer is too small" << std::endl;
+        return 1;
+    }
 
     print_binary_data(std::cout, buffer);
 
     // Decode the data from the buffer
     ExperimentData data2;
-    buffer_ptr = buffer.data();
-
-    n = datapacker::bytes::decode<datapacker::endian::little>(buffer_ptr, data2.experiment_code,
-                                                              data2.location_id, data2.timestamp);
-    buffer_ptr += n;
+    datapacker::bytes::reader r(buffer.data(), w.position());
 
     // Limit max number of elements to 1000
-    n = datapacker::bytes::decode_length_prefixed<datapacker::endian::little>(
-        buffer_ptr, data2.experiment_name, 1000);
-    buffer_ptr += n;
+    r.get_record(data2)
+        .get_length_prefixed<datapacker::endian::little>(data2.experiment_name, 1000)
+        .get_length_prefixed<datapacker::endian::little>(data2.samples, 1000);
 
-    n = datapacker::bytes::decode_length_prefixed<datapacker::endian::little>(buffer_ptr,
-                                                                              data2.samples, 1000);
+    if (!r)
+    {
+        std::cerr << "Could not decode the data" << std::endl;
+        return 1;
+    }
 
     std::cout << "Original data: " << std::endl;
     data.print();
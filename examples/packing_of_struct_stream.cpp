@@ -33,6 +33,15 @@ struct ExperimentData
         std::cout << std::endl;
     }
 };
+
+// The fixed size fields of the struct, the sequences are written separately after them
+template <>
+struct datapacker::bytes::schema<ExperimentData>
+    : layout<field<&ExperimentData::experiment_code>, field<&ExperimentData::location_id>,
+             field<&ExperimentData::timestamp>>
+{
+};
+
 int main()
 {
 
@@ -44,9 +53,7 @@ int main()
     data.samples = {1.15f, -1.32f, 0.1f, 5.614f, 3.1415, 6.623e23, 9e10 - 9, 1.45f, 1.3213e21f};
 
     std::ostringstream oss;
-    write<endian::little>(oss, data.experiment_code);
-    write<endian::little>(oss, data.location_id);
-    write<endian::little>(oss, data.timestamp);
+    write_record(oss, data);
     write<endian::little>(oss, data.experiment_name);
     write<endian::little>(oss, data.samples);
 
@@ -54,9 +61,7 @@ int main()
     std::istringstream iss(str);
     
     std::cout << "=================================================" << std::endl;
-    read<endian::little>(iss, data2.experiment_code);
-    read<endian::little>(iss, data2.location_id);
-    read<endian::little>(iss, data2.timestamp);
+    read_record(iss, data2);
     read<endian::little>(iss, data2.experiment_name);
     read<endian::little>(iss, data2.samples);
 
@@ -6,7 +6,8 @@
  * portable way. Contains functions to encode/decode little-endian/big-endian, floats (using IEEE754
  * format), strings and arrays.
  * @note
- * - Ensure that buffer has enough length to store all the values to prevent buffer overflows
+ * - Ensure that buffer has enough length to store all the values to prevent buffer overflows, or
+ *   use `bytes::writer` and `bytes::reader` which check the length of the buffer
  * @version 1.0
  * @date 2024-11-14
  * @author Ananthanarayanan Venkitakrishnan
@@ -14,21 +15,92 @@
  */
 #ifndef A_DATAPACKER_H
 #define A_DATAPACKER_H
+#include <array>
+#include <bit>
+#include <errno.h>
+#include <functional>
 #include <inttypes.h>
 #include <istream>
+#include <iterator>
+#include <limits>
 #include <ostream>
 #include <stddef.h>
+#include <stdexcept>
 #include <stdint.h>
+#include <stdio.h>
 #include <string.h>
+#include <span>
 #include <string>
+#include <string_view>
+#include <tuple>
 #include <type_traits>
 #include <utility>
 #include <vector>
 
+// Define DATAPACKER_PORTABLE_FLOAT to 1 to always convert floats and doubles using
+// pack754/unpack754, even if the host uses IEEE754 representation for them
+#ifndef DATAPACKER_PORTABLE_FLOAT
+#define DATAPACKER_PORTABLE_FLOAT 0
+#endif
+
+// Define DATAPACKER_SIMD to 0 to disable the SSSE3/AVX2/NEON array byte swap kernels. On x86 with
+// GCC and Clang, the kernels are compiled with target attributes and selected at runtime from the
+// features of the CPU, so no -m flags are needed. Other compilers use the kernels enabled by the
+// target architecture flags, such as /arch:AVX2 on MSVC
+#ifndef DATAPACKER_SIMD
+#define DATAPACKER_SIMD 1
+#endif
+
+// Define DATAPACKER_STATS to 1 to count the calls, bytes and latencies of the stream api per type,
+// see `datapacker::stats`. It should have the same value in every translation unit
+#ifndef DATAPACKER_STATS
+#define DATAPACKER_STATS 0
+#endif
+
+#if DATAPACKER_SIMD && (defined(__x86_64__) || defined(__i386__)) &&                              \
+    (defined(__GNUC__) || defined(__clang__))
+#define DATAPACKER_X86_DISPATCH 1
+#define DATAPACKER_X86_SIMD 1
+#define DATAPACKER_TARGET(isa) __attribute__((target(isa)))
+#elif DATAPACKER_SIMD && defined(__AVX2__)
+#define DATAPACKER_X86_DISPATCH 0
+#define DATAPACKER_X86_SIMD 1
+#define DATAPACKER_TARGET(isa)
+#else
+#define DATAPACKER_X86_DISPATCH 0
+#define DATAPACKER_X86_SIMD 0
+#endif
+
+#if DATAPACKER_X86_SIMD || defined(__BMI2__)
+#include <immintrin.h>
+#elif DATAPACKER_SIMD && defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <stdlib.h>
+#endif
+
+#if DATAPACKER_STATS
+#include <atomic>
+#include <chrono>
+#include <exception>
+#endif
+
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
 namespace datapacker
 {
 // Default maximum number of elements which can be read using the stream api
 constexpr size_t DEFAULT_MAX_NUMBER_OF_ELEMENTS = 1000 * 1000;
+// Size of the stack buffer used by the stream api to encode/decode sequences in chunks
+constexpr size_t STREAM_CHUNK_SIZE = 4096;
+// Default size of the block of stream::buffered_writer and stream::buffered_reader
+constexpr size_t BUFFERED_BLOCK_SIZE = 64 * 1024;
 enum class endian
 {
     little = 0,
@@ -65,102 +137,470 @@ template <> struct is_double<const double> : std::true_type
 {
 };
 
+template <typename T> struct is_vector : std::false_type
+{
+};
+
+template <typename T, typename Allocator>
+struct is_vector<std::vector<T, Allocator>> : std::true_type
+{
+};
+
+// True for strings of char with any traits and allocator, such as std::pmr::string
+template <typename T> struct is_string : std::false_type
+{
+};
+
+template <typename Traits, typename Allocator>
+struct is_string<std::basic_string<char, Traits, Allocator>> : std::true_type
+{
+};
+
 template <unsigned bits, unsigned expbits> uint64_t pack754(long double f);
 
 template <unsigned bits, unsigned expbits> long double unpack754(uint64_t i);
-} // namespace internal
 
-/**
- * All the functions in this namespace operate on raw bytes, and it is necessary that the caller
- * makes sure that the buffers are of sufficient length to prevent overflow
- */
-namespace bytes
+// True if float and double are IEEE754 single/double precision values on this host, in which case
+// they are converted to their bit patterns with a bit cast instead of pack754/unpack754
+constexpr bool native_ieee754 = !DATAPACKER_PORTABLE_FLOAT &&
+                                std::numeric_limits<float>::is_iec559 &&
+                                std::numeric_limits<double>::is_iec559;
+
+inline uint32_t float_to_bits(float f)
 {
-/**
- * @brief Encodes a float in IEEE754 format and stores it in `buffer`
- * @param buffer Pointer to buffer which will be used to store the encoded data
- * @param value Value to be encoded
- * @return Number of bytes written to the buffer
- * @note `buffer` should have size atleast equal to `sizeof(float)`
- */
+    if constexpr (native_ieee754)
+        return std::bit_cast<uint32_t>(f);
+    else
+        return static_cast<uint32_t>(pack754<32, 8>(f) & 0xFFFFFFFF);
+}
 
-template <typename T> int encode_le(uint8_t *buffer, T value);
+inline uint64_t double_to_bits(double f)
+{
+    if constexpr (native_ieee754)
+        return std::bit_cast<uint64_t>(f);
+    else
+        return pack754<64, 11>(f);
+}
+
+inline float bits_to_float(uint32_t i)
+{
+    if constexpr (native_ieee754)
+        return std::bit_cast<float>(i);
+    else
+        return static_cast<float>(unpack754<32, 8>(static_cast<uint64_t>(i)));
+}
 
-template <typename T> int decode_le(uint8_t *buffer, T &value);
+inline double bits_to_double(uint64_t i)
+{
+    if constexpr (native_ieee754)
+        return std::bit_cast<double>(i);
+    else
+        return static_cast<double>(unpack754<64, 11>(i));
+}
 
-// Note: floats and doubles, when converted to int64_t are encoded in little endian format
+// True if values written in `endianness` byte order have the same representation in memory on
+// this host, so that they can be copied with memcpy
+template <endian endianness>
+constexpr bool is_native_endian =
+    (endianness == endian::little && std::endian::native == std::endian::little) ||
+    (endianness == endian::big && std::endian::native == std::endian::big);
 
-inline int encode_float(uint8_t *buffer, float f)
+// True if `sizeof(T)` bytes of T in host byte order are exactly its encoded form, ignoring byte
+// order, i.e. it is a supported integer or an IEEE754 float/double
+template <typename T>
+constexpr bool is_bit_copyable =
+    (std::is_integral_v<T> && !std::is_same_v<std::remove_cv_t<T>, bool> &&
+     (sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8)) ||
+    (native_ieee754 && (is_float<T>::value || is_double<T>::value));
+
+// True if T is an integer or a real number, which can be passed to encode/decode
+template <typename T>
+constexpr bool is_fixed_width =
+    std::is_integral_v<T> || is_float<T>::value || is_double<T>::value;
+
+template <typename T> struct member_pointer_traits;
+
+template <typename S, typename T> struct member_pointer_traits<T S::*>
 {
-    uint64_t encoded = internal::pack754<32, 8>(f);
-    uint32_t result = static_cast<uint32_t>(encoded & 0xFFFFFFFF);
-    encode_le(buffer, result);
-    return sizeof(float);
+    using record_type = S;
+    using member_type = T;
+};
+
+template <auto member>
+using member_type_of = typename member_pointer_traits<decltype(member)>::member_type;
+
+// Maps signed integers to unsigned integers so that values with a small magnitude have small
+// encodings (0 -> 0, -1 -> 1, 1 -> 2, -2 -> 3, ...), unsigned integers are returned as is
+template <typename T> constexpr std::make_unsigned_t<T> zigzag_encode(T value)
+{
+    static_assert(std::is_integral_v<T> && !std::is_same_v<std::remove_cv_t<T>, bool>);
+    using uT = std::make_unsigned_t<T>;
+    if constexpr (std::is_signed_v<T>)
+        return static_cast<uT>(static_cast<uT>(static_cast<uT>(value) << 1) ^
+                               static_cast<uT>(value >> (sizeof(T) * 8 - 1)));
+    else
+        return value;
 }
 
-/**
- * @brief Encodes a double in IEEE754 format and stores it in `buffer`
- * @param buffer Pointer to buffer which will be used to store the encoded data
- * @param value Value to be encoded
- * @return Number of bytes written to the buffer
- * @note `buffer` should have size atleast equal to `sizeof(double)`
- */
-inline int encode_double(uint8_t *buffer, double f)
+template <typename T> constexpr T zigzag_decode(uint64_t value)
 {
-    uint64_t encoded = internal::pack754<64, 11>(f);
-    encode_le(buffer, encoded);
-    return sizeof(double);
+    using uT = std::make_unsigned_t<T>;
+    auto u = static_cast<uT>(value);
+    if constexpr (std::is_signed_v<T>)
+        return static_cast<T>(static_cast<uT>(u >> 1) ^ static_cast<uT>(uT{0} - (u & 1)));
+    else
+        return static_cast<T>(u);
 }
 
-/**
- * @brief Decodes a float stored in IEEE754 format and stores it in `f`
- * @param buffer Pointer to buffer which contains the encoded data
- * @param value Where the decoded value will be stored
- * @return Number of bytes read from the buffer
- * @note `buffer` should have size atleast equal to `sizeof(float)`
- */
-inline int decode_float(uint8_t *buffer, float &f)
+// Packs the low 7 bits of each of the first n bytes of a little endian word
+inline uint64_t gather_septets(uint64_t word, int n)
 {
-    uint32_t i;
-    decode_le(buffer, i);
-    f = static_cast<float>(internal::unpack754<32, 8>(static_cast<uint64_t>(i)));
-    return sizeof(float);
+    if (n < 8)
+        word &= (uint64_t{1} << (8 * n)) - 1;
+#if defined(__BMI2__)
+    return _pext_u64(word, 0x7F7F7F7F7F7F7F7FULL);
+#else
+    uint64_t result = 0;
+    for (int i = 0; i < n; ++i)
+        result |= ((word >> (8 * i)) & 0x7F) << (7 * i);
+    return result;
+#endif
+}
+
+// Checks that a varint of n bytes with the decoded value is valid for T
+template <typename T> inline bool varint_fits(uint64_t value, int n)
+{
+    using uT = std::make_unsigned_t<T>;
+    return static_cast<size_t>(n) <= (sizeof(T) * 8 + 6) / 7 &&
+           value <= static_cast<uint64_t>(std::numeric_limits<uT>::max());
+}
+
+template <typename T>
+inline int decode_varint_bytewise(const uint8_t *buffer, size_t size, T &value)
+{
+    constexpr size_t max_size = (sizeof(T) * 8 + 6) / 7;
+    uint64_t result = 0;
+    for (size_t i = 0; i < size && i < max_size; ++i)
+    {
+        uint64_t byte = buffer[i];
+        // The 10th byte of a 64 bit varint can only contain the highest bit
+        if (i == 9 && byte > 1)
+            return -1;
+        result |= (byte & 0x7F) << (7 * i);
+        if (!(byte & 0x80))
+        {
+            if (!varint_fits<T>(result, static_cast<int>(i + 1)))
+                return -1;
+            value = zigzag_decode<T>(result);
+            return static_cast<int>(i + 1);
+        }
+    }
+    return -1;
+}
+
+// Offsets of values of the given sizes when they are packed one after the other
+template <size_t... sizes> constexpr std::array<size_t, sizeof...(sizes)> packed_offsets()
+{
+    std::array<size_t, sizeof...(sizes)> offsets{};
+    size_t offset = 0;
+    size_t i = 0;
+    ((offsets[i++] = offset, offset += sizes), ...);
+    return offsets;
+}
+
+// Converts to the type of any field, used to count the fields of an aggregate
+struct any_field
+{
+    template <typename T> operator T() const;
+};
+
+// Number of fields of an aggregate, which is the largest number of values it can be initialized
+// with. Fields which are arrays or aggregates are counted once per element, by brace elision
+template <typename S, typename... Fields> constexpr size_t field_count()
+{
+    if constexpr (requires { S{Fields{}..., any_field{}}; })
+        return field_count<S, Fields..., any_field>();
+    else
+        return sizeof...(Fields);
+}
+
+constexpr size_t MAX_STRUCT_FIELDS = 16;
+
+// Returns a tuple of references to the fields of an aggregate, in order
+template <typename S> constexpr auto tie_fields(S &s)
+{
+    constexpr size_t count = field_count<std::remove_const_t<S>>();
+    static_assert(count > 0 && count <= MAX_STRUCT_FIELDS,
+                  "Only aggregates with 1 to 16 fields can be encoded with encode_struct");
+    if constexpr (count == 1)
+    {
+        auto &[a] = s;
+        return std::tie(a);
+    }
+    else if constexpr (count == 2)
+    {
+        auto &[a, b] = s;
+        return std::tie(a, b);
+    }
+    else if constexpr (count == 3)
+    {
+        auto &[a, b, c] = s;
+        return std::tie(a, b, c);
+    }
+    else if constexpr (count == 4)
+    {
+        auto &[a, b, c, d] = s;
+        return std::tie(a, b, c, d);
+    }
+    else if constexpr (count == 5)
+    {
+        auto &[a, b, c, d, e] = s;
+        return std::tie(a, b, c, d, e);
+    }
+    else if constexpr (count == 6)
+    {
+        auto &[a, b, c, d, e, f] = s;
+        return std::tie(a, b, c, d, e, f);
+    }
+    else if constexpr (count == 7)
+    {
+        auto &[a, b, c, d, e, f, g] = s;
+        return std::tie(a, b, c, d, e, f, g);
+    }
+    else if constexpr (count == 8)
+    {
+        auto &[a, b, c, d, e, f, g, h] = s;
+        return std::tie(a, b, c, d, e, f, g, h);
+    }
+    else if constexpr (count == 9)
+    {
+        auto &[a, b, c, d, e, f, g, h, i] = s;
+        return std::tie(a, b, c, d, e, f, g, h, i);
+    }
+    else if constexpr (count == 10)
+    {
+        auto &[a, b, c, d, e, f, g, h, i, j] = s;
+        return std::tie(a, b, c, d, e, f, g, h, i, j);
+    }
+    else if constexpr (count == 11)
+    {
+        auto &[a, b, c, d, e, f, g, h, i, j, k] = s;
+        return std::tie(a, b, c, d, e, f, g, h, i, j, k);
+    }
+    else if constexpr (count == 12)
+    {
+        auto &[a, b, c, d, e, f, g, h, i, j, k, l] = s;
+        return std::tie(a, b, c, d, e, f, g, h, i, j, k, l);
+    }
+    else if constexpr (count == 13)
+    {
+        auto &[a, b, c, d, e, f, g, h, i, j, k, l, m] = s;
+        return std::tie(a, b, c, d, e, f, g, h, i, j, k, l, m);
+    }
+    else if constexpr (count == 14)
+    {
+        auto &[a, b, c, d, e, f, g, h, i, j, k, l, m, n] = s;
+        return std::tie(a, b, c, d, e, f, g, h, i, j, k, l, m, n);
+    }
+    else if constexpr (count == 15)
+    {
+        auto &[a, b, c, d, e, f, g, h, i, j, k, l, m, n, o] = s;
+        return std::tie(a, b, c, d, e, f, g, h, i, j, k, l, m, n, o);
+    }
+    else if constexpr (count == 16)
+    {
+        auto &[a, b, c, d, e, f, g, h, i, j, k, l, m, n, o, p] = s;
+        return std::tie(a, b, c, d, e, f, g, h, i, j, k, l, m, n, o, p);
+    }
 }
 
 /**
- * @brief Decodes a double stored in IEEE754 format and stores it in `f`
- * @param buffer Pointer to buffer which contains the encoded data
- * @param value Where the decoded value will be stored
- * @return Number of bytes read from the buffer
- * @note `buffer` should have size atleast equal to `sizeof(double)`
+ * Reverses the bytes of an unsigned integer, uses compiler intrinsics when they are available
  */
-inline int decode_double(uint8_t *buffer, double &f)
+template <typename T> inline T byteswap(T value)
 {
-    uint64_t i;
-    decode_le(buffer, i);
-    f = static_cast<double>(internal::unpack754<64, 11>(i));
-    return sizeof(double);
+    static_assert(std::is_unsigned_v<T>);
+    if constexpr (sizeof(T) == 1)
+        return value;
+#if defined(__GNUC__) || defined(__clang__)
+    else if constexpr (sizeof(T) == 2)
+        return __builtin_bswap16(value);
+    else if constexpr (sizeof(T) == 4)
+        return __builtin_bswap32(value);
+    else
+        return __builtin_bswap64(value);
+#elif defined(_MSC_VER)
+    else if constexpr (sizeof(T) == 2)
+        return _byteswap_ushort(value);
+    else if constexpr (sizeof(T) == 4)
+        return _byteswap_ulong(value);
+    else
+        return _byteswap_uint64(value);
+#else
+    else
+    {
+        T result = 0;
+        for (size_t i = 0; i < sizeof(T); ++i)
+        {
+            result = static_cast<T>((result << 8) | (value & 0xFF));
+            value = static_cast<T>(value >> 8);
+        }
+        return result;
+    }
+#endif
+}
+
+#if DATAPACKER_X86_SIMD
+// Instruction set extensions of the CPU which the kernels use
+enum class x86_features
+{
+    baseline,
+    ssse3,
+    avx2
+};
+
+// Detected once, on the first call
+inline x86_features cpu_features()
+{
+#if DATAPACKER_X86_DISPATCH
+    static const x86_features features = [] {
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2"))
+            return x86_features::avx2;
+        if (__builtin_cpu_supports("ssse3"))
+            return x86_features::ssse3;
+        return x86_features::baseline;
+    }();
+    return features;
+#else
+    // Only used when the compiler targets AVX2
+    return x86_features::avx2;
+#endif
+}
+
+template <size_t size> DATAPACKER_TARGET("ssse3") inline __m128i byteswap_mask()
+{
+    if constexpr (size == 2)
+        return _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+    else if constexpr (size == 4)
+        return _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+    else
+        return _mm_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
 }
 
+// Byte swaps the elements in the first `nbytes` bytes, 16 bytes at a time, and returns the number
+// of bytes swapped
+template <size_t size>
+DATAPACKER_TARGET("ssse3")
+inline size_t copy_swapped_ssse3(uint8_t *dst, const uint8_t *src, size_t nbytes)
+{
+    const __m128i mask = byteswap_mask<size>();
+    size_t i = 0;
+    for (; i + 16 <= nbytes; i += 16)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+        v = _mm_shuffle_epi8(v, mask);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), v);
+    }
+    return i;
+}
+
+// Same as copy_swapped_ssse3, 32 bytes at a time
+template <size_t size>
+DATAPACKER_TARGET("avx2")
+inline size_t copy_swapped_avx2(uint8_t *dst, const uint8_t *src, size_t nbytes)
+{
+    const __m256i mask = _mm256_broadcastsi128_si256(byteswap_mask<size>());
+    size_t i = 0;
+    for (; i + 32 <= nbytes; i += 32)
+    {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+        v = _mm256_shuffle_epi8(v, mask);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), v);
+    }
+    return i;
+}
+#endif
+
 /**
- * @brief Encodes a value in big-endian format and stores it in `buffer`
- * @tparam T Type of value to be encoded, `sizeof(T)` bytes are written to the buffer
- * @param buffer Pointer to buffer which will be used to store the encoded data
- * @param value Value to be encoded
- * @return Number of bytes written to the buffer
- * @note `buffer` should have size atleast equal to `sizeof(T)`
- *
- * Example usage:
- * @code
- * uint8_t buffer[4];
- * int x = 32;
- * encode_be(buffer, x);
- * @endcode
+ * Copies `n` elements of `size` bytes each from `src` to `dst`, reversing the bytes of every
+ * element. Uses SSSE3/AVX2/NEON shuffles when the CPU supports them. `dst` may be equal to
+ * `src` to swap in place, but the buffers should not partially overlap
  */
-template <typename T> inline int encode_be(uint8_t *buffer, T value)
+template <size_t size> inline void copy_swapped(uint8_t *dst, const uint8_t *src, size_t n)
+{
+    static_assert(size == 2 || size == 4 || size == 8);
+    size_t nbytes = n * size;
+    size_t i = 0;
+#if DATAPACKER_X86_SIMD
+    if (nbytes >= 16)
+    {
+        x86_features features = cpu_features();
+        if (features == x86_features::avx2)
+            i = copy_swapped_avx2<size>(dst, src, nbytes);
+        if (features != x86_features::baseline)
+            i += copy_swapped_ssse3<size>(dst + i, src + i, nbytes - i);
+    }
+#elif DATAPACKER_SIMD && defined(__ARM_NEON)
+    for (; i + 16 <= nbytes; i += 16)
+    {
+        uint8x16_t v = vld1q_u8(src + i);
+        if constexpr (size == 2)
+            v = vrev16q_u8(v);
+        else if constexpr (size == 4)
+            v = vrev32q_u8(v);
+        else
+            v = vrev64q_u8(v);
+        vst1q_u8(dst + i, v);
+    }
+#endif
+    // Remaining elements, this loop is also vectorized by most compilers when no SIMD
+    // kernel is used
+    using uT = std::conditional_t<size == 2, uint16_t,
+                                  std::conditional_t<size == 4, uint32_t, uint64_t>>;
+    for (; i < nbytes; i += size)
+    {
+        uT value;
+        memcpy(&value, src + i, size);
+        value = byteswap(value);
+        memcpy(dst + i, &value, size);
+    }
+}
+
+// True if the host stores integers in little-endian or big-endian byte order, so that they can be
+// encoded with memcpy and a byte swap. Other hosts use the shift and mask fallbacks below
+constexpr bool has_native_byte_order =
+    std::endian::native == std::endian::little || std::endian::native == std::endian::big;
+
+// Unsigned integer of the same size as the integer T, bool is stored as a single byte
+template <typename T>
+using unsigned_bits = typename std::conditional_t<std::is_same_v<std::remove_cv_t<T>, bool>,
+                                                  std::type_identity<uint8_t>,
+                                                  std::make_unsigned<T>>::type;
+
+// Stores an integer in `endianness` byte order with a single unaligned copy
+template <endian endianness, typename T> inline void store(uint8_t *buffer, T value)
+{
+    auto bits = static_cast<unsigned_bits<T>>(value);
+    if constexpr (!is_native_endian<endianness>)
+        bits = byteswap(bits);
+    memcpy(buffer, &bits, sizeof(bits));
+}
+
+// Loads an integer stored in `endianness` byte order with a single unaligned copy
+template <endian endianness, typename T> inline T load(const uint8_t *buffer)
+{
+    unsigned_bits<T> bits;
+    memcpy(&bits, buffer, sizeof(bits));
+    if constexpr (!is_native_endian<endianness>)
+        bits = byteswap(bits);
+    return static_cast<T>(bits);
+}
+
+// Portable implementations which assemble the bytes with shifts, used when the host byte order is
+// neither little-endian nor big-endian
+template <typename T> inline int encode_be_shifts(uint8_t *buffer, T value)
 {
-    static_assert(std::is_integral<T>::value);
-    static_assert(sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8);
     buffer[0] = static_cast<uint8_t>((value >> (8 * sizeof(T) - 8)) & 0xFF);
     if constexpr (sizeof(T) >= 2)
     {
@@ -181,25 +621,8 @@ template <typename T> inline int encode_be(uint8_t *buffer, T value)
     return sizeof(T);
 }
 
-/**
- * @brief Encodes a value in little-endian format and stores it in `buffer`
- * @tparam T Type of value to be encoded, `sizeof(T)` bytes are written to the buffer
- * @param buffer Pointer to buffer which will be used to store the encoded data
- * @param value Value to be encoded
- * @return Number of bytes written to the buffer
- * @note `buffer` should have size atleast equal to `sizeof(T)`
- *
- * Example usage:
- * @code
- * uint8_t buffer[4];
- * int x = 32;
- * encode_le(buffer, x);
- * @endcode
- */
-template <typename T> inline int encode_le(uint8_t *buffer, T value)
+template <typename T> inline int encode_le_shifts(uint8_t *buffer, T value)
 {
-    static_assert(std::is_integral<T>::value);
-    static_assert(sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8);
     buffer[0] = static_cast<uint8_t>(value & 0xFF);
     if constexpr (sizeof(T) >= 2)
     {
@@ -220,27 +643,8 @@ template <typename T> inline int encode_le(uint8_t *buffer, T value)
     return sizeof(T);
 }
 
-/**
- * @brief Decodes a little-endian encoded value from the buffer and stores it in `value`, the number
- * of bytes processed depends upon the type `T` of value passed
- * @tparam T Type of value to be decoded, `sizeof(T)` bytes are read from the buffer
- * @param buffer Pointer to buffer which contains the encoded data
- * @param value Reference to a variable of type `T`, which will hold the decoded value
- * @return Number of bytes read from the buffer
- * @note `buffer` should have size atleast equal to `sizeof(T)`
- *
- * Example usage:
- * @code
- * // Assume buffer has a little endian encoded value
- * uint8_t buffer[4];
- * int x;
- * decode_le(buffer, x);
- * @endcode
- */
-template <typename T> inline int decode_le(uint8_t *buffer, T &value)
+template <typename T> inline int decode_le_shifts(const uint8_t *buffer, T &value)
 {
-    static_assert(std::is_integral<T>::value);
-    static_assert(sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8);
     // Perform the decoding in unsigned type only, then convert it to the type of T
     using uT = std::make_unsigned_t<T>;
     uT val = 0;
@@ -266,27 +670,8 @@ template <typename T> inline int decode_le(uint8_t *buffer, T &value)
     return sizeof(T);
 }
 
-/**
- * @brief Decodes a big-endian encoded value from the buffer and stores it in `value`, the number of
- * bytes processed depends upon the type `T` of value passed
- * @tparam T Type of value to be decoded, `sizeof(T)` bytes are read from the buffer
- * @param buffer Pointer to buffer which contains the encoded data
- * @param value Reference to a variable of type `T`, which will hold the decoded value
- * @return Number of bytes read from the buffer
- * @note `buffer` should have size atleast equal to `sizeof(T)`
- *
- * Example usage:
- * @code
- * // Assume buffer has a big endian encoded value
- * uint8_t buffer[4];
- * int x;
- * decode_be(buffer, x);
- * @endcode
- */
-template <typename T> inline int decode_be(uint8_t *buffer, T &value)
+template <typename T> inline int decode_be_shifts(const uint8_t *buffer, T &value)
 {
-    static_assert(std::is_integral<T>::value);
-    static_assert(sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8);
     // Perform the decoding in unsigned type only, then convert it to the type of T
     using uT = std::make_unsigned_t<T>;
     uT val = 0;
@@ -294,34 +679,253 @@ template <typename T> inline int decode_be(uint8_t *buffer, T &value)
     val |= static_cast<uT>(buffer[0]);
     if constexpr (sizeof(T) >= 2)
     {
-        val <<= 8;
+        val = static_cast<uT>(val << 8);
         val |= static_cast<uT>(buffer[1]);
     }
     if constexpr (sizeof(T) >= 4)
     {
-        val <<= 8;
+        val = static_cast<uT>(val << 8);
         val |= static_cast<uT>(buffer[2]);
 
-        val <<= 8;
+        val = static_cast<uT>(val << 8);
         val |= static_cast<uT>(buffer[3]);
     }
     if constexpr (sizeof(T) >= 8)
     {
-        val <<= 8;
+        val = static_cast<uT>(val << 8);
         val |= static_cast<uT>(buffer[4]);
 
-        val <<= 8;
+        val = static_cast<uT>(val << 8);
         val |= static_cast<uT>(buffer[5]);
 
-        val <<= 8;
+        val = static_cast<uT>(val << 8);
         val |= static_cast<uT>(buffer[6]);
 
-        val <<= 8;
+        val = static_cast<uT>(val << 8);
         val |= static_cast<uT>(buffer[7]);
     }
     value = static_cast<T>(val);
     return sizeof(T);
 }
+} // namespace internal
+
+/**
+ * All the functions in this namespace operate on raw bytes, and it is necessary that the caller
+ * makes sure that the buffers are of sufficient length to prevent overflow. The `writer` and
+ * `reader` cursors can be used to have the lengths checked
+ */
+namespace bytes
+{
+template <typename T> int encode_le(uint8_t *buffer, T value);
+
+template <typename T> int encode_be(uint8_t *buffer, T value);
+
+template <typename T> int decode_le(const uint8_t *buffer, T &value);
+
+template <typename T> int decode_be(const uint8_t *buffer, T &value);
+
+/**
+ * @brief Encodes a float in IEEE754 format and stores it in `buffer`
+ * @tparam endianness Byte order in which the IEEE754 bit pattern is written
+ * @param buffer Pointer to buffer which will be used to store the encoded data
+ * @param value Value to be encoded
+ * @return Number of bytes written to the buffer
+ * @note `buffer` should have size atleast equal to `sizeof(float)`
+ */
+template <endian endianness> inline int encode_float(uint8_t *buffer, float f)
+{
+    if constexpr (endianness == endian::little)
+        encode_le(buffer, internal::float_to_bits(f));
+    else
+        encode_be(buffer, internal::float_to_bits(f));
+    return sizeof(float);
+}
+
+/**
+ * @brief Encodes a double in IEEE754 format and stores it in `buffer`
+ * @tparam endianness Byte order in which the IEEE754 bit pattern is written
+ * @param buffer Pointer to buffer which will be used to store the encoded data
+ * @param value Value to be encoded
+ * @return Number of bytes written to the buffer
+ * @note `buffer` should have size atleast equal to `sizeof(double)`
+ */
+template <endian endianness> inline int encode_double(uint8_t *buffer, double f)
+{
+    if constexpr (endianness == endian::little)
+        encode_le(buffer, internal::double_to_bits(f));
+    else
+        encode_be(buffer, internal::double_to_bits(f));
+    return sizeof(double);
+}
+
+/**
+ * @brief Decodes a float stored in IEEE754 format and stores it in `f`
+ * @tparam endianness Byte order of the IEEE754 bit pattern in the buffer
+ * @param buffer Pointer to buffer which contains the encoded data
+ * @param value Where the decoded value will be stored
+ * @return Number of bytes read from the buffer
+ * @note `buffer` should have size atleast equal to `sizeof(float)`
+ */
+template <endian endianness> inline int decode_float(const uint8_t *buffer, float &f)
+{
+    uint32_t i;
+    if constexpr (endianness == endian::little)
+        decode_le(buffer, i);
+    else
+        decode_be(buffer, i);
+    f = internal::bits_to_float(i);
+    return sizeof(float);
+}
+
+/**
+ * @brief Decodes a double stored in IEEE754 format and stores it in `f`
+ * @tparam endianness Byte order of the IEEE754 bit pattern in the buffer
+ * @param buffer Pointer to buffer which contains the encoded data
+ * @param value Where the decoded value will be stored
+ * @return Number of bytes read from the buffer
+ * @note `buffer` should have size atleast equal to `sizeof(double)`
+ */
+template <endian endianness> inline int decode_double(const uint8_t *buffer, double &f)
+{
+    uint64_t i;
+    if constexpr (endianness == endian::little)
+        decode_le(buffer, i);
+    else
+        decode_be(buffer, i);
+    f = internal::bits_to_double(i);
+    return sizeof(double);
+}
+
+// Note: The overloads without an endianness parameter store the IEEE754 bit pattern in little
+// endian format
+
+inline int encode_float(uint8_t *buffer, float f)
+{
+    return encode_float<endian::little>(buffer, f);
+}
+
+inline int encode_double(uint8_t *buffer, double f)
+{
+    return encode_double<endian::little>(buffer, f);
+}
+
+inline int decode_float(const uint8_t *buffer, float &f)
+{
+    return decode_float<endian::little>(buffer, f);
+}
+
+inline int decode_double(const uint8_t *buffer, double &f)
+{
+    return decode_double<endian::little>(buffer, f);
+}
+
+/**
+ * @brief Encodes a value in big-endian format and stores it in `buffer`
+ * @tparam T Type of value to be encoded, `sizeof(T)` bytes are written to the buffer
+ * @param buffer Pointer to buffer which will be used to store the encoded data
+ * @param value Value to be encoded
+ * @return Number of bytes written to the buffer
+ * @note `buffer` should have size atleast equal to `sizeof(T)`
+ *
+ * Example usage:
+ * @code
+ * uint8_t buffer[4];
+ * int x = 32;
+ * encode_be(buffer, x);
+ * @endcode
+ */
+template <typename T> inline int encode_be(uint8_t *buffer, T value)
+{
+    static_assert(std::is_integral<T>::value);
+    static_assert(sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8);
+    if constexpr (internal::has_native_byte_order)
+        internal::store<endian::big>(buffer, value);
+    else
+        internal::encode_be_shifts(buffer, value);
+    return sizeof(T);
+}
+
+/**
+ * @brief Encodes a value in little-endian format and stores it in `buffer`
+ * @tparam T Type of value to be encoded, `sizeof(T)` bytes are written to the buffer
+ * @param buffer Pointer to buffer which will be used to store the encoded data
+ * @param value Value to be encoded
+ * @return Number of bytes written to the buffer
+ * @note `buffer` should have size atleast equal to `sizeof(T)`
+ *
+ * Example usage:
+ * @code
+ * uint8_t buffer[4];
+ * int x = 32;
+ * encode_le(buffer, x);
+ * @endcode
+ */
+template <typename T> inline int encode_le(uint8_t *buffer, T value)
+{
+    static_assert(std::is_integral<T>::value);
+    static_assert(sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8);
+    if constexpr (internal::has_native_byte_order)
+        internal::store<endian::little>(buffer, value);
+    else
+        internal::encode_le_shifts(buffer, value);
+    return sizeof(T);
+}
+
+/**
+ * @brief Decodes a little-endian encoded value from the buffer and stores it in `value`, the number
+ * of bytes processed depends upon the type `T` of value passed
+ * @tparam T Type of value to be decoded, `sizeof(T)` bytes are read from the buffer
+ * @param buffer Pointer to buffer which contains the encoded data
+ * @param value Reference to a variable of type `T`, which will hold the decoded value
+ * @return Number of bytes read from the buffer
+ * @note `buffer` should have size atleast equal to `sizeof(T)`
+ *
+ * Example usage:
+ * @code
+ * // Assume buffer has a little endian encoded value
+ * uint8_t buffer[4];
+ * int x;
+ * decode_le(buffer, x);
+ * @endcode
+ */
+template <typename T> inline int decode_le(const uint8_t *buffer, T &value)
+{
+    static_assert(std::is_integral<T>::value);
+    static_assert(sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8);
+    if constexpr (internal::has_native_byte_order)
+        value = internal::load<endian::little, T>(buffer);
+    else
+        internal::decode_le_shifts(buffer, value);
+    return sizeof(T);
+}
+
+/**
+ * @brief Decodes a big-endian encoded value from the buffer and stores it in `value`, the number of
+ * bytes processed depends upon the type `T` of value passed
+ * @tparam T Type of value to be decoded, `sizeof(T)` bytes are read from the buffer
+ * @param buffer Pointer to buffer which contains the encoded data
+ * @param value Reference to a variable of type `T`, which will hold the decoded value
+ * @return Number of bytes read from the buffer
+ * @note `buffer` should have size atleast equal to `sizeof(T)`
+ *
+ * Example usage:
+ * @code
+ * // Assume buffer has a big endian encoded value
+ * uint8_t buffer[4];
+ * int x;
+ * decode_be(buffer, x);
+ * @endcode
+ */
+template <typename T> inline int decode_be(const uint8_t *buffer, T &value)
+{
+    static_assert(std::is_integral<T>::value);
+    static_assert(sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8);
+    if constexpr (internal::has_native_byte_order)
+        value = internal::load<endian::big, T>(buffer);
+    else
+        internal::decode_be_shifts(buffer, value);
+    return sizeof(T);
+}
 
 /**
  * @brief Encodes multiple values in little-endian format and then stores them in a buffer
@@ -336,8 +940,14 @@ template <typename T> inline int decode_be(uint8_t *buffer, T &value)
  */
 template <typename T, typename... Args> inline int encode_le(uint8_t *buffer, T value, Args... args)
 {
-    auto nbytes = encode_le(buffer, value);
-    return nbytes + encode_le(buffer + sizeof(T), args...);
+    // The offset of every value is known at compile time, so the fold expands to a flat sequence
+    // of stores instead of one nested call per argument
+    constexpr auto offsets = internal::packed_offsets<sizeof(Args)...>();
+    encode_le(buffer, value);
+    [&]<size_t... I>(std::index_sequence<I...>) {
+        (encode_le(buffer + sizeof(T) + offsets[I], args), ...);
+    }(std::index_sequence_for<Args...>{});
+    return static_cast<int>((sizeof(T) + ... + sizeof(Args)));
 }
 
 /**
@@ -353,8 +963,12 @@ template <typename T, typename... Args> inline int encode_le(uint8_t *buffer, T
  */
 template <typename T, typename... Args> inline int encode_be(uint8_t *buffer, T value, Args... args)
 {
-    auto nbytes = encode_be(buffer, value);
-    return nbytes + encode_be(buffer + sizeof(T), args...);
+    constexpr auto offsets = internal::packed_offsets<sizeof(Args)...>();
+    encode_be(buffer, value);
+    [&]<size_t... I>(std::index_sequence<I...>) {
+        (encode_be(buffer + sizeof(T) + offsets[I], args), ...);
+    }(std::index_sequence_for<Args...>{});
+    return static_cast<int>((sizeof(T) + ... + sizeof(Args)));
 }
 
 /**
@@ -370,10 +984,14 @@ template <typename T, typename... Args> inline int encode_be(uint8_t *buffer, T
  * equal to the sum of sizes of the types passed
  */
 template <typename T, typename... Args>
-inline int decode_le(uint8_t *buffer, T &value, Args &...args)
+inline int decode_le(const uint8_t *buffer, T &value, Args &...args)
 {
-    auto nbytes = decode_le(buffer, value);
-    return nbytes + decode_le(buffer + sizeof(T), args...);
+    constexpr auto offsets = internal::packed_offsets<sizeof(Args)...>();
+    decode_le(buffer, value);
+    [&]<size_t... I>(std::index_sequence<I...>) {
+        (decode_le(buffer + sizeof(T) + offsets[I], args), ...);
+    }(std::index_sequence_for<Args...>{});
+    return static_cast<int>((sizeof(T) + ... + sizeof(Args)));
 }
 
 /**
@@ -390,10 +1008,14 @@ inline int decode_le(uint8_t *buffer, T &value, Args &...args)
  * equal to the sum of sizes of the types passed
  */
 template <typename T, typename... Args>
-inline int decode_be(uint8_t *buffer, T &value, Args &...args)
+inline int decode_be(const uint8_t *buffer, T &value, Args &...args)
 {
-    auto nbytes = decode_be(buffer, value);
-    return nbytes + decode_be(buffer + sizeof(T), args...);
+    constexpr auto offsets = internal::packed_offsets<sizeof(Args)...>();
+    decode_be(buffer, value);
+    [&]<size_t... I>(std::index_sequence<I...>) {
+        (decode_be(buffer + sizeof(T) + offsets[I], args), ...);
+    }(std::index_sequence_for<Args...>{});
+    return static_cast<int>((sizeof(T) + ... + sizeof(Args)));
 }
 
 /**
@@ -420,11 +1042,11 @@ template <endian endianness, typename T> inline int encode(uint8_t *buffer, T va
     }
     else if constexpr (internal::is_float<T>::value)
     {
-        return encode_float(buffer, value);
+        return encode_float<endianness>(buffer, value);
     }
     else if constexpr (internal::is_double<T>::value)
     {
-        return encode_double(buffer, value);
+        return encode_double<endianness>(buffer, value);
     }
     else
     {
@@ -445,7 +1067,7 @@ template <endian endianness, typename T> inline int encode(uint8_t *buffer, T va
  *
  * @note buffer should be of sufficient length
  */
-template <endian endianness, typename T> inline int decode(uint8_t *buffer, T &value)
+template <endian endianness, typename T> inline int decode(const uint8_t *buffer, T &value)
 {
     if constexpr (std::is_integral<T>::value)
     {
@@ -456,11 +1078,11 @@ template <endian endianness, typename T> inline int decode(uint8_t *buffer, T &v
     }
     else if constexpr (internal::is_float<T>::value)
     {
-        return decode_float(buffer, value);
+        return decode_float<endianness>(buffer, value);
     }
     else if constexpr (internal::is_double<T>::value)
     {
-        return decode_double(buffer, value);
+        return decode_double<endianness>(buffer, value);
     }
     else
     {
@@ -472,252 +1094,3008 @@ template <endian endianness, typename T> inline int decode(uint8_t *buffer, T &v
 template <endian endianness, typename T, typename... Args>
 inline int encode(uint8_t *buffer, T value, Args... args)
 {
-    auto nbytes = encode<endianness, T>(buffer, value);
-    return nbytes + encode<endianness>(buffer + sizeof(T), args...);
+    constexpr auto offsets = internal::packed_offsets<sizeof(Args)...>();
+    encode<endianness, T>(buffer, value);
+    [&]<size_t... I>(std::index_sequence<I...>) {
+        (encode<endianness, Args>(buffer + sizeof(T) + offsets[I], args), ...);
+    }(std::index_sequence_for<Args...>{});
+    return static_cast<int>((sizeof(T) + ... + sizeof(Args)));
 }
 
 template <endian endianness, typename T, typename... Args>
-inline int decode(uint8_t *buffer, T &value, Args &...args)
+inline int decode(const uint8_t *buffer, T &value, Args &...args)
 {
-    auto nbytes = decode<endianness, T>(buffer, value);
-    return nbytes + decode<endianness>(buffer + sizeof(T), args...);
+    constexpr auto offsets = internal::packed_offsets<sizeof(Args)...>();
+    decode<endianness, T>(buffer, value);
+    [&]<size_t... I>(std::index_sequence<I...>) {
+        (decode<endianness, Args>(buffer + sizeof(T) + offsets[I], args), ...);
+    }(std::index_sequence_for<Args...>{});
+    return static_cast<int>((sizeof(T) + ... + sizeof(Args)));
 }
 
 /**
- * @brief Encodes an array with a length prefix into a buffer.
+ * @brief Encodes `n` elements of an array with specified endianness into a buffer
+ *
+ * Integers, and floats/doubles on hosts with IEEE754 representation, are copied with a single
+ * `memcpy` when `endianness` matches the byte order of the host, and with a vectorized byte swap
+ * otherwise. Other types are encoded element by element.
  *
  * @tparam endianness The endianness to use for encoding
- * @tparam T The type of the elements in the array.
- * @tparam U The type used to encode the length of the array.
- * @param buffer The buffer where the encoded data will be stored.
- * @param arr The array of elements to encode.
- * @param n The number of elements in the array.
- * @return The total number of bytes written to the buffer.
- * @note buffer should be of size atleast equal to `sizeof(U) + sizeof(T) * n`
+ * @tparam T The type of the elements in the array
+ * @param buffer The buffer where the encoded data will be stored
+ * @param arr The array of elements to encode
+ * @param n The number of elements in the array
+ * @return The number of bytes written to the buffer
+ * @note buffer should be of size atleast equal to `sizeof(T) * n`
  */
-template <endian endianness, typename T, typename U>
-inline int encode_length_prefixed(uint8_t *buffer, T *arr, U n)
+template <endian endianness, typename T>
+inline int encode_array(uint8_t *buffer, const T *arr, size_t n)
 {
-    encode<endianness, U>(buffer, n);
-
-    buffer += sizeof(U);
-
-    for (U i = 0; i < n; ++i)
+    constexpr endian opposite = endianness == endian::little ? endian::big : endian::little;
+    if (n == 0)
+        return 0;
+    if constexpr (internal::is_bit_copyable<T> &&
+                  (sizeof(T) == 1 || internal::is_native_endian<endianness>))
+    {
+        memcpy(buffer, arr, n * sizeof(T));
+    }
+    else if constexpr (internal::is_bit_copyable<T> && internal::is_native_endian<opposite>)
+    {
+        internal::copy_swapped<sizeof(T)>(buffer, reinterpret_cast<const uint8_t *>(arr), n);
+    }
+    else
     {
-        encode<endianness, T>(buffer, arr[i]);
-        buffer += sizeof(T);
+        for (size_t i = 0; i < n; ++i)
+        {
+            encode<endianness, T>(buffer + i * sizeof(T), arr[i]);
+        }
     }
-    return sizeof(U) + static_cast<int>(n * sizeof(T));
+    return static_cast<int>(n * sizeof(T));
 }
 
 /**
- * @brief Decodes a length-prefixed array from a buffer.
+ * @brief Decodes `n` elements of an array with specified endianness from a buffer
+ *
+ * This is the inverse of `encode_array`, and uses the same `memcpy` / byte swap fast paths.
+ *
  * @tparam endianness The endianness of the data
- * @tparam T The type of the elements in the array.
- * @tparam U The type used for the length prefix.
- * @param buffer The buffer containing the length-prefixed array to decode.
- * @param arr Pointer to the array where the decoded elements will be stored.
- * @param max_arr_length The maximum length of the array to prevent buffer overflow.
- * @return The total number of bytes read from the buffer, or -1 if the length read exceeds
- * max_arr_length
+ * @tparam T The type of the elements in the array
+ * @param buffer The buffer containing the encoded elements
+ * @param arr Pointer to the array where the decoded elements will be stored
+ * @param n The number of elements to decode
+ * @return The number of bytes read from the buffer
+ * @note buffer should be of size atleast equal to `sizeof(T) * n`
  */
-
-template <endian endianness, typename T, typename U>
-inline int decode_length_prefixed(uint8_t *buffer, T *arr, U max_arr_length)
+template <endian endianness, typename T>
+inline int decode_array(const uint8_t *buffer, T *arr, size_t n)
 {
-    U arr_length;
-    decode<endianness, U>(buffer, arr_length);
-
-    if (arr_length > max_arr_length)
+    constexpr endian opposite = endianness == endian::little ? endian::big : endian::little;
+    if (n == 0)
+        return 0;
+    if constexpr (internal::is_bit_copyable<T> &&
+                  (sizeof(T) == 1 || internal::is_native_endian<endianness>))
     {
-        return -1;
+        memcpy(arr, buffer, n * sizeof(T));
     }
-
-    buffer += sizeof(U);
-
-    for (U i = 0; i < arr_length; ++i)
+    else if constexpr (internal::is_bit_copyable<T> && internal::is_native_endian<opposite>)
     {
-        decode<endianness, T>(buffer, arr[i]);
-        buffer += sizeof(T);
+        internal::copy_swapped<sizeof(T)>(reinterpret_cast<uint8_t *>(arr), buffer, n);
     }
-    return sizeof(U) + static_cast<int>(arr_length * sizeof(T));
+    else
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            decode<endianness, T>(buffer + i * sizeof(T), arr[i]);
+        }
+    }
+    return static_cast<int>(n * sizeof(T));
 }
 
 /**
- * @brief Encodes a string as a length prefixed array into a buffer
- * @tparam endianness Endianness of the length to be written
- * @param buffer The buffer where the encoded string will be stored
- * @param s The string to be encoded
- * @return The number of bytes written to the buffer,
- * @note `buffer` should be of size atleast equal to `sizeof(size_t) + s.size()`
+ * Maximum number of bytes of a varint encoded value of type `T`
  */
-template <endian endianness>
-inline int encode_length_prefixed(uint8_t *buffer, const std::string &s)
+template <typename T> constexpr size_t max_varint_size = (sizeof(T) * 8 + 6) / 7;
+
+/**
+ * @brief Number of bytes which `encode_varint` writes for `value`
+ */
+template <typename T> constexpr size_t varint_size(T value)
 {
-    return encode_length_prefixed<endianness>(buffer, s.data(), s.size());
+    auto u = static_cast<uint64_t>(internal::zigzag_encode(value));
+    return (static_cast<size_t>(std::bit_width(u | 1)) + 6) / 7;
 }
 
 /**
- * @brief Decodes a length-prefixed string from a buffer.
- * @tparam endianness Endianness of the length in the buffer
- * @param buffer The buffer containing the length-prefixed string to decode.
- * @param s Reference to a string into which the decoded value will be stored
- * @param max_string_length The maximum length of the string to prevent buffer overflow.
- * @return The total number of bytes read from the buffer, or -1 if the length read exceeds
- * max_string_length
- * @note This function creates a new string, then moves it into s, so it is fine if s is empty
+ * @brief Encodes an integer as a variable length (unsigned LEB128) integer, signed integers are
+ * first mapped to unsigned integers with ZigZag encoding, so that values with a small magnitude
+ * take fewer bytes regardless of their sign
+ * @param buffer Pointer to buffer which will be used to store the encoded data
+ * @param value Value to be encoded
+ * @return Number of bytes written to the buffer, which is between 1 and `max_varint_size<T>`
+ * @note `buffer` should have size atleast equal to `varint_size(value)`
  */
-template <endian endianness>
-inline int decode_length_prefixed(uint8_t *buffer, std::string &s, size_t max_string_length)
+template <typename T> inline int encode_varint(uint8_t *buffer, T value)
 {
-    std::string str;
-    str.resize(max_string_length);
-    auto bytes_read = decode_length_prefixed<endianness>(buffer, str.data(), max_string_length);
-    if (bytes_read == -1)
+    auto u = static_cast<uint64_t>(internal::zigzag_encode(value));
+    int n = 0;
+    while (u >= 0x80)
     {
-        return -1;
+        buffer[n++] = static_cast<uint8_t>(u | 0x80);
+        u >>= 7;
     }
-    str.resize(bytes_read - sizeof(std::string::size_type));
-    s = std::move(str);
-    return bytes_read;
+    buffer[n++] = static_cast<uint8_t>(u);
+    return n;
 }
 
 /**
- * @brief Encodes a vector as a length prefixed array into a buffer
- * @tparam endianness Endianness of the length in the buffer
- * @tparam T The type of elements of the vector
- * @param buffer The buffer where the encoded vector will be stored
- * @param v The vector to be encoded
- * @return The number of bytes written to the buffer,
+ * @brief Decodes a variable length integer written by `encode_varint`
+ * @param buffer Pointer to buffer which contains the encoded data
+ * @param size Number of bytes available in the buffer, atmost `max_varint_size<T>` bytes are read
+ * @param value Where the decoded value will be stored
+ * @return Number of bytes read from the buffer, or -1 if the buffer ends before the varint does,
+ * or if the varint is longer than `max_varint_size<T>` or does not fit in `T`
+ * @note If atleast 8 bytes are available, the end of the varint is found with a single 8 byte load
  */
-template <endian endianness, typename T>
-inline int encode_length_prefixed(uint8_t *buffer, const std::vector<T> &v)
+template <typename T> inline int decode_varint(const uint8_t *buffer, size_t size, T &value)
 {
-    return encode_length_prefixed<endianness>(buffer, v.data(), v.size());
+    if (size >= 8)
+    {
+        uint64_t word;
+        decode_le(buffer, word);
+        // The last byte of the varint is the first one without the continuation bit
+        uint64_t stops = ~word & 0x8080808080808080ULL;
+        if (stops != 0)
+        {
+            int n = std::countr_zero(stops) / 8 + 1;
+            uint64_t result = internal::gather_septets(word, n);
+            if (!internal::varint_fits<T>(result, n))
+                return -1;
+            value = internal::zigzag_decode<T>(result);
+            return n;
+        }
+    }
+    return internal::decode_varint_bytewise(buffer, size, value);
 }
 
 /**
- * @brief Decodes a length-prefixed vector from a buffer.
- * @tparam endianness Endianness of the length in the buffer
- * @tparam T The type of elements of the vector
+ * Policy which stores the length of a string or vector as a variable length integer, it can be
+ * passed in place of the integer type of the length prefix
+ *
+ * Example usage:
+ * @code
+ * encode_length_prefixed<endian::little, varint_prefix>(buffer, s);
+ * @endcode
+ */
+struct varint_prefix
+{
+};
+
+/**
+ * Describes how the length of a length-prefixed string or vector is stored. `P` is the integer
+ * type of a fixed width prefix (`size_t` by default), or `varint_prefix`
+ */
+template <typename P> struct length_prefix
+{
+    static_assert(std::is_integral<P>::value,
+                  "Length prefix should be an integer type or varint_prefix");
+
+    // Largest length which can be stored in the prefix
+    static constexpr size_t max_length = static_cast<size_t>(std::numeric_limits<P>::max());
+    // Largest number of bytes occupied by the prefix
+    static constexpr size_t max_size = sizeof(P);
+
+    static constexpr size_t size(size_t)
+    {
+        return sizeof(P);
+    }
+
+    template <endian endianness> static int encode(uint8_t *buffer, size_t length)
+    {
+        return bytes::encode<endianness>(buffer, static_cast<P>(length));
+    }
+
+    // Decodes a prefix, the buffer should contain the whole prefix
+    template <endian endianness> static int decode(const uint8_t *buffer, size_t &length)
+    {
+        P value;
+        bytes::decode<endianness>(buffer, value);
+        if constexpr (std::is_signed<P>::value)
+        {
+            if (value < 0)
+                return -1;
+        }
+        length = static_cast<size_t>(value);
+        return sizeof(P);
+    }
+
+    // Decodes a prefix from a buffer of `size` bytes, returns -1 if it is truncated
+    template <endian endianness>
+    static int decode(const uint8_t *buffer, size_t size, size_t &length)
+    {
+        if (size < sizeof(P))
+            return -1;
+        return decode<endianness>(buffer, length);
+    }
+};
+
+template <> struct length_prefix<varint_prefix>
+{
+    static constexpr size_t max_length = std::numeric_limits<size_t>::max();
+    static constexpr size_t max_size = max_varint_size<size_t>;
+
+    static constexpr size_t size(size_t length)
+    {
+        return varint_size(length);
+    }
+
+    template <endian> static int encode(uint8_t *buffer, size_t length)
+    {
+        return encode_varint(buffer, length);
+    }
+
+    template <endian> static int decode(const uint8_t *buffer, size_t &length)
+    {
+        // Reads one byte at a time, so that nothing past the end of the varint is accessed
+        return internal::decode_varint_bytewise(buffer, max_size, length);
+    }
+
+    template <endian> static int decode(const uint8_t *buffer, size_t size, size_t &length)
+    {
+        return decode_varint(buffer, size, length);
+    }
+};
+
+/**
+ * @brief Encodes an array with a length prefix into a buffer.
+ *
+ * @tparam endianness The endianness to use for encoding
+ * @tparam T The type of the elements in the array.
+ * @tparam U The type used to encode the length of the array.
+ * @param buffer The buffer where the encoded data will be stored.
+ * @param arr The array of elements to encode.
+ * @param n The number of elements in the array.
+ * @return The total number of bytes written to the buffer.
+ * @note buffer should be of size atleast equal to `sizeof(U) + sizeof(T) * n`
+ */
+template <endian endianness, typename T, typename U>
+inline int encode_length_prefixed(uint8_t *buffer, T *arr, U n)
+{
+    encode<endianness, U>(buffer, n);
+    return sizeof(U) + encode_array<endianness>(buffer + sizeof(U), arr, static_cast<size_t>(n));
+}
+
+/**
+ * @brief Decodes a length-prefixed array from a buffer.
+ * @tparam endianness The endianness of the data
+ * @tparam T The type of the elements in the array.
+ * @tparam U The type used for the length prefix.
+ * @param buffer The buffer containing the length-prefixed array to decode.
+ * @param arr Pointer to the array where the decoded elements will be stored.
+ * @param max_arr_length The maximum length of the array to prevent buffer overflow.
+ * @return The total number of bytes read from the buffer, or -1 if the length read exceeds
+ * max_arr_length
+ */
+
+template <endian endianness, typename T, typename U>
+inline int decode_length_prefixed(const uint8_t *buffer, T *arr, U max_arr_length)
+{
+    U arr_length;
+    decode<endianness, U>(buffer, arr_length);
+
+    if (arr_length > max_arr_length)
+    {
+        return -1;
+    }
+    if constexpr (std::is_signed_v<U>)
+    {
+        if (arr_length < 0)
+            return -1;
+    }
+
+    return sizeof(U) +
+           decode_array<endianness>(buffer + sizeof(U), arr, static_cast<size_t>(arr_length));
+}
+
+/**
+ * @brief Encodes a string as a length prefixed array into a buffer
+ * @tparam endianness Endianness of the length to be written
+ * @tparam Prefix Integer type of the length prefix, or `varint_prefix`
+ * @param buffer The buffer where the encoded string will be stored
+ * @param s The string to be encoded
+ * @return The number of bytes written to the buffer, or -1 if the length of the string cannot be
+ * stored in the prefix
+ * @note `buffer` should be of size atleast equal to `sizeof(size_t) + s.size()`
+ */
+template <endian endianness, typename Prefix = size_t, typename Traits, typename Allocator>
+inline int encode_length_prefixed(uint8_t *buffer,
+                                  const std::basic_string<char, Traits, Allocator> &s)
+{
+    if (s.size() > length_prefix<Prefix>::max_length)
+    {
+        return -1;
+    }
+    int n = length_prefix<Prefix>::template encode<endianness>(buffer, s.size());
+    return n + encode_array<endianness>(buffer + n, s.data(), s.size());
+}
+
+/**
+ * @brief Decodes a length-prefixed string from a buffer.
+ * @tparam endianness Endianness of the length in the buffer
+ * @tparam Prefix Integer type of the length prefix, or `varint_prefix`
+ * @param buffer The buffer containing the length-prefixed string to decode.
+ * @param s Reference to a string into which the decoded value will be stored
+ * @param max_string_length The maximum length of the string to prevent buffer overflow.
+ * @return The total number of bytes read from the buffer, or -1 if the length read exceeds
+ * max_string_length
+ * @note The string is resized to the decoded length and its storage is reused, `s` is not modified
+ * if -1 is returned. Any allocator can be used, so a `std::pmr::string` allocates from its memory
+ * resource
+ */
+template <endian endianness, typename Prefix = size_t, typename Traits, typename Allocator>
+inline int decode_length_prefixed(const uint8_t *buffer,
+                                  std::basic_string<char, Traits, Allocator> &s,
+                                  size_t max_string_length)
+{
+    size_t length;
+    int n = length_prefix<Prefix>::template decode<endianness>(buffer, length);
+    if (n == -1 || length > max_string_length)
+    {
+        return -1;
+    }
+    s.resize(length);
+    return n + decode_array<endianness>(buffer + n, s.data(), length);
+}
+
+/**
+ * @brief Encodes a vector as a length prefixed array into a buffer
+ * @tparam endianness Endianness of the length in the buffer
+ * @tparam Prefix Integer type of the length prefix, or `varint_prefix`
+ * @tparam T The type of elements of the vector
+ * @param buffer The buffer where the encoded vector will be stored
+ * @param v The vector to be encoded
+ * @return The number of bytes written to the buffer, or -1 if the length of the vector cannot be
+ * stored in the prefix
+ */
+template <endian endianness, typename Prefix = size_t, typename T, typename Allocator>
+inline int encode_length_prefixed(uint8_t *buffer, const std::vector<T, Allocator> &v)
+{
+    if (v.size() > length_prefix<Prefix>::max_length)
+    {
+        return -1;
+    }
+    int n = length_prefix<Prefix>::template encode<endianness>(buffer, v.size());
+    return n + encode_array<endianness>(buffer + n, v.data(), v.size());
+}
+
+/**
+ * @brief Decodes a length-prefixed vector from a buffer.
+ * @tparam endianness Endianness of the length in the buffer
+ * @tparam Prefix Integer type of the length prefix, or `varint_prefix`
+ * @tparam T The type of elements of the vector
  * @param buffer The buffer containing the length-prefixed vector to decode.
  * @param v Reference to a vector into which the decoded value will be stored
  * @param max_length The maximum length of the vector to prevent buffer overflow.
  * @return The total number of bytes read from the buffer, or -1 if the length read exceeds
  * max_length
- * @note This function creates a new vector, then moves it into v, so it is fine if v is empty
+ * @note The vector is resized to the decoded length and its storage is reused, `v` is not modified
+ * if -1 is returned. Any allocator can be used, so a `std::pmr::vector` allocates from its memory
+ * resource
+ */
+template <endian endianness, typename Prefix = size_t, typename T, typename Allocator>
+inline int decode_length_prefixed(const uint8_t *buffer, std::vector<T, Allocator> &v,
+                                  size_t max_length)
+{
+    size_t length;
+    int n = length_prefix<Prefix>::template decode<endianness>(buffer, length);
+    if (n == -1 || length > max_length)
+    {
+        return -1;
+    }
+    v.resize(length);
+    return n + decode_array<endianness>(buffer + n, v.data(), length);
+}
+
+/**
+ * A read-only view over `size()` elements of type `T` stored with specified endianness in a buffer.
+ * The elements are decoded when they are accessed, so the buffer is neither copied nor converted.
+ * The buffer must outlive the span.
+ *
+ * Example usage:
+ * @code
+ * endian_span<int32_t, endian::big> values;
+ * view_length_prefixed(buffer, values, 1000);
+ * int32_t first = values[0];
+ * @endcode
+ */
+template <typename T, endian endianness> class endian_span
+{
+  public:
+    using value_type = T;
+
+    class iterator
+    {
+      public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = T;
+
+        iterator() = default;
+
+        explicit iterator(const uint8_t *p) : ptr(p)
+        {
+        }
+
+        T operator*() const
+        {
+            T value;
+            decode<endianness, T>(ptr, value);
+            return value;
+        }
+
+        iterator &operator++()
+        {
+            ptr += sizeof(T);
+            return *this;
+        }
+
+        iterator operator++(int)
+        {
+            iterator it = *this;
+            ptr += sizeof(T);
+            return it;
+        }
+
+        bool operator==(const iterator &other) const = default;
+
+      private:
+        const uint8_t *ptr = nullptr;
+    };
+
+    endian_span() = default;
+
+    /**
+     * @brief Creates a view over `n` elements stored in `buffer`
+     */
+    endian_span(const uint8_t *buffer, size_t n) : ptr(buffer), length(n)
+    {
+    }
+
+    /**
+     * @brief Decodes and returns the element at index `i`, no bounds checking is performed
+     */
+    T operator[](size_t i) const
+    {
+        T value;
+        decode<endianness, T>(ptr + i * sizeof(T), value);
+        return value;
+    }
+
+    size_t size() const
+    {
+        return length;
+    }
+
+    size_t size_bytes() const
+    {
+        return length * sizeof(T);
+    }
+
+    bool empty() const
+    {
+        return length == 0;
+    }
+
+    /**
+     * @brief Returns the encoded bytes of the elements
+     */
+    std::span<const uint8_t> bytes() const
+    {
+        return std::span<const uint8_t>(ptr, size_bytes());
+    }
+
+    iterator begin() const
+    {
+        return iterator(ptr);
+    }
+
+    iterator end() const
+    {
+        return iterator(ptr + size_bytes());
+    }
+
+  private:
+    const uint8_t *ptr = nullptr;
+    size_t length = 0;
+};
+
+/**
+ * @brief Creates a view of a length-prefixed string in a buffer, without copying it
+ * @tparam endianness Endianness of the length in the buffer
+ * @tparam Prefix Integer type of the length prefix, or `varint_prefix`
+ * @param buffer The buffer containing the length-prefixed string
+ * @param s Reference to a string view which will point to the characters in `buffer`
+ * @param max_string_length The maximum length of the string
+ * @return The total number of bytes of the length-prefixed string in the buffer, or -1 if the
+ * length read exceeds max_string_length
+ * @note `s` is only valid as long as `buffer` is
+ */
+template <endian endianness, typename Prefix = size_t>
+inline int view_length_prefixed(const uint8_t *buffer, std::string_view &s,
+                                size_t max_string_length)
+{
+    size_t length;
+    int n = length_prefix<Prefix>::template decode<endianness>(buffer, length);
+    if (n == -1 || length > max_string_length)
+    {
+        return -1;
+    }
+    s = std::string_view(reinterpret_cast<const char *>(buffer + n), length);
+    return n + static_cast<int>(length);
+}
+
+/**
+ * @brief Creates a view of a length-prefixed array (such as an encoded vector) in a buffer, without
+ * copying or decoding it
+ * @tparam endianness Endianness of the length and the elements in the buffer
+ * @tparam Prefix Integer type of the length prefix, or `varint_prefix`
+ * @tparam T The type of the elements
+ * @param buffer The buffer containing the length-prefixed array
+ * @param s Reference to a span which will point to the elements in `buffer`
+ * @param max_length The maximum number of elements
+ * @return The total number of bytes of the length-prefixed array in the buffer, or -1 if the
+ * length read exceeds max_length
+ * @note `s` is only valid as long as `buffer` is
+ */
+template <endian endianness, typename Prefix = size_t, typename T>
+inline int view_length_prefixed(const uint8_t *buffer, endian_span<T, endianness> &s,
+                                size_t max_length)
+{
+    size_t length;
+    int n = length_prefix<Prefix>::template decode<endianness>(buffer, length);
+    if (n == -1 || length > max_length)
+    {
+        return -1;
+    }
+    s = endian_span<T, endianness>(buffer + n, length);
+    return n + static_cast<int>(length * sizeof(T));
+}
+
+/**
+ * @brief Finds the size of a length-prefixed string or vector in a buffer from its prefix, so that
+ * it can be skipped without decoding it
+ * @tparam endianness Endianness of the length in the buffer
+ * @tparam T The type of the sequence, such as `std::string` or `std::vector<float>`
+ * @tparam Prefix Integer type of the length prefix, or `varint_prefix`
+ * @param buffer The buffer containing the length-prefixed sequence
+ * @param size Number of bytes in the buffer
+ * @param max_length The maximum number of elements
+ * @return The total number of bytes of the length-prefixed sequence, or -1 if the length exceeds
+ * `max_length` or the sequence does not fit in `size` bytes
+ */
+template <endian endianness, typename T, typename Prefix = size_t>
+inline int skip_length_prefixed(const uint8_t *buffer, size_t size,
+                                size_t max_length = DEFAULT_MAX_NUMBER_OF_ELEMENTS)
+{
+    static_assert(internal::is_string<T>::value || internal::is_vector<T>::value,
+                  "skip_length_prefixed can only skip strings and vectors");
+    constexpr size_t element_size = sizeof(typename T::value_type);
+    size_t length;
+    int n = length_prefix<Prefix>::template decode<endianness>(buffer, size, length);
+    if (n == -1 || length > max_length ||
+        length > (size - static_cast<size_t>(n)) / element_size)
+    {
+        return -1;
+    }
+    return n + static_cast<int>(length * element_size);
+}
+
+/**
+ * A field of a record schema, `member` is a pointer to a data member which is an integer or a real
+ * number, encoded with specified endianness
+ */
+template <auto member, endian endianness = endian::little> struct field
+{
+    using member_type = typename internal::member_pointer_traits<decltype(member)>::member_type;
+    static_assert(std::is_integral<member_type>::value || internal::is_float<member_type>::value ||
+                      internal::is_double<member_type>::value,
+                  "A field can only be an integer or a real number");
+    static constexpr size_t size = sizeof(member_type);
+    // Bytes per record in the columnar layout
+    static constexpr size_t column_width = size;
+    static constexpr auto pointer = member;
+    static constexpr endian byte_order = endianness;
+
+    template <typename S> static void encode(uint8_t *buffer, const S &s)
+    {
+        bytes::encode<endianness>(buffer, s.*member);
+    }
+
+    template <typename S> static void decode(const uint8_t *buffer, S &s)
+    {
+        bytes::decode<endianness>(buffer, s.*member);
+    }
+
+    // Encodes the member of `n` records one after the other. The members are gathered into a
+    // block, which is then encoded with the bulk array kernel
+    template <typename S> static void encode_column(uint8_t *buffer, const S *records, size_t n)
+    {
+        member_type block[COLUMN_BLOCK];
+        for (size_t i = 0; i < n; i += COLUMN_BLOCK)
+        {
+            size_t count = COLUMN_BLOCK < n - i ? COLUMN_BLOCK : n - i;
+            for (size_t j = 0; j < count; ++j)
+                block[j] = records[i + j].*member;
+            encode_array<endianness>(buffer + i * size, block, count);
+        }
+    }
+
+    template <typename S> static void decode_column(const uint8_t *buffer, S *records, size_t n)
+    {
+        member_type block[COLUMN_BLOCK];
+        for (size_t i = 0; i < n; i += COLUMN_BLOCK)
+        {
+            size_t count = COLUMN_BLOCK < n - i ? COLUMN_BLOCK : n - i;
+            decode_array<endianness>(buffer + i * size, block, count);
+            for (size_t j = 0; j < count; ++j)
+                records[i + j].*member = block[j];
+        }
+    }
+
+  private:
+    static constexpr size_t COLUMN_BLOCK = 4096 / size;
+};
+
+/**
+ * `n` bytes in a record schema which do not correspond to any member, zeros are written when
+ * encoding and the bytes are ignored when decoding
+ */
+template <size_t n> struct padding
+{
+    static constexpr size_t size = n;
+    // Padding is not stored in the columnar layout
+    static constexpr size_t column_width = 0;
+
+    template <typename S> static void encode(uint8_t *buffer, const S &)
+    {
+        memset(buffer, 0, n);
+    }
+
+    template <typename S> static void decode(const uint8_t *, S &)
+    {
+    }
+
+    template <typename S> static void encode_column(uint8_t *, const S *, size_t)
+    {
+    }
+
+    template <typename S> static void decode_column(const uint8_t *, S *, size_t)
+    {
+    }
+};
+
+/**
+ * The fields of a record, in the order in which they are stored. The offset of each field is
+ * computed at compile time.
+ */
+template <typename... Fields> struct layout
+{
+    static constexpr size_t size = (Fields::size + ... + 0);
+    static constexpr std::array<size_t, sizeof...(Fields)> offsets =
+        internal::packed_offsets<Fields::size...>();
+
+    template <typename S> static void encode(uint8_t *buffer, const S &s)
+    {
+        [&]<size_t... I>(std::index_sequence<I...>) {
+            (Fields::encode(buffer + offsets[I], s), ...);
+        }(std::index_sequence_for<Fields...>{});
+    }
+
+    template <typename S> static void decode(const uint8_t *buffer, S &s)
+    {
+        [&]<size_t... I>(std::index_sequence<I...>) {
+            (Fields::decode(buffer + offsets[I], s), ...);
+        }(std::index_sequence_for<Fields...>{});
+    }
+
+    // Size of one record in the columnar layout, which does not include padding
+    static constexpr size_t column_width = (Fields::column_width + ... + 0);
+
+    template <typename S> static void encode_columns(uint8_t *buffer, const S *records, size_t n)
+    {
+        size_t offset = 0;
+        ((Fields::encode_column(buffer + offset, records, n), offset += Fields::column_width * n),
+         ...);
+    }
+
+    template <typename S> static void decode_columns(const uint8_t *buffer, S *records, size_t n)
+    {
+        size_t offset = 0;
+        ((Fields::decode_column(buffer + offset, records, n), offset += Fields::column_width * n),
+         ...);
+    }
+
+    // Offset of the column of `member` per record, i.e. the column starts at `n` times this
+    template <auto member> static constexpr size_t column_offset()
+    {
+        size_t offset = 0;
+        bool found = false;
+        (
+            [&] {
+                if (found)
+                    return;
+                if constexpr (is_field_of<Fields, member>())
+                    found = true;
+                else
+                    offset += Fields::column_width;
+            }(),
+            ...);
+        return found ? offset : SIZE_MAX;
+    }
+
+    // Endianness of the field of `member`
+    template <auto member> static constexpr endian column_byte_order()
+    {
+        endian e = endian::little;
+        (
+            [&] {
+                if constexpr (is_field_of<Fields, member>())
+                    e = Fields::byte_order;
+            }(),
+            ...);
+        return e;
+    }
+
+  private:
+    template <typename F, auto member> static constexpr bool is_field_of()
+    {
+        if constexpr (requires { F::pointer; })
+        {
+            if constexpr (std::is_same_v<std::remove_cv_t<decltype(F::pointer)>, decltype(member)>)
+                return F::pointer == member;
+        }
+        return false;
+    }
+};
+
+/**
+ * Describes the binary layout of a struct `S`, specialize it for a struct to use `encode_record`
+ * and `decode_record` with it
+ *
+ * Example usage:
+ * @code
+ * struct Header
+ * {
+ *     uint32_t size;
+ *     int16_t version;
+ * };
+ *
+ * template <>
+ * struct datapacker::bytes::schema<Header>
+ *     : layout<field<&Header::size, endian::big>, padding<2>, field<&Header::version>>
+ * {
+ * };
+ * @endcode
+ */
+template <typename S> struct schema;
+
+/**
+ * Number of bytes occupied by an encoded record of type `S`
+ */
+template <typename S> constexpr size_t packed_size = schema<S>::size;
+
+/**
+ * @brief Encodes all the fields of a record described by `schema<S>` into a buffer
+ * @param buffer The buffer where the encoded record will be stored
+ * @param s The record to encode
+ * @return Number of bytes written to the buffer, which is `packed_size<S>`
+ * @note `buffer` should be of size atleast equal to `packed_size<S>`
+ */
+template <typename S> inline int encode_record(uint8_t *buffer, const S &s)
+{
+    schema<S>::encode(buffer, s);
+    return static_cast<int>(packed_size<S>);
+}
+
+/**
+ * @brief Decodes all the fields of a record described by `schema<S>` from a buffer
+ * @param buffer The buffer containing the encoded record
+ * @param s The record into which the fields are decoded
+ * @return Number of bytes read from the buffer, which is `packed_size<S>`
+ * @note `buffer` should be of size atleast equal to `packed_size<S>`
+ */
+template <typename S> inline int decode_record(const uint8_t *buffer, S &s)
+{
+    schema<S>::decode(buffer, s);
+    return static_cast<int>(packed_size<S>);
+}
+
+/**
+ * True if `schema<S>` has been specialized for `S`
+ */
+template <typename S>
+concept has_schema = requires { schema<S>::size; };
+
+/**
+ * Number of bytes occupied by one record of type `S` in the columnar layout, see `encode_columns`
+ */
+template <typename S> constexpr size_t column_width = schema<S>::column_width;
+
+/**
+ * @brief Encodes `n` records described by `schema<S>` column by column (struct of arrays)
+ *
+ * All the values of the first field are written, then all the values of the second field, and so
+ * on. Padding is not written. Each column is encoded with the bulk array kernels, and a single
+ * column can then be read sequentially with `decode_column` or `view_column`.
+ *
+ * @param buffer The buffer where the encoded records will be stored
+ * @param records The records to encode
+ * @param n Number of records
+ * @return Number of bytes written to the buffer, which is `column_width<S> * n`
+ * @note `buffer` should be of size atleast equal to `column_width<S> * n`
+ */
+template <typename S> inline size_t encode_columns(uint8_t *buffer, const S *records, size_t n)
+{
+    schema<S>::encode_columns(buffer, records, n);
+    return column_width<S> * n;
+}
+
+/**
+ * @brief Decodes `n` records encoded by `encode_columns` into an array of records
+ * @return Number of bytes read from the buffer, which is `column_width<S> * n`
+ */
+template <typename S> inline size_t decode_columns(const uint8_t *buffer, S *records, size_t n)
+{
+    schema<S>::decode_columns(buffer, records, n);
+    return column_width<S> * n;
+}
+
+/**
+ * @brief Decodes the column of a single field of `n` records encoded by `encode_columns` into an
+ * array, for example `decode_column<&Point::x>(buffer, n, xs)`
+ * @tparam member Pointer to the member of the field in the record
+ * @param buffer The buffer containing the encoded records
+ * @param n Number of records in the buffer
+ * @param out Array of `n` values where the column is decoded
+ */
+template <auto member>
+inline void decode_column(const uint8_t *buffer, size_t n, internal::member_type_of<member> *out)
+{
+    using S = typename internal::member_pointer_traits<decltype(member)>::record_type;
+    constexpr size_t offset = schema<S>::template column_offset<member>();
+    static_assert(offset != SIZE_MAX, "The member is not a field of the schema");
+    decode_array<schema<S>::template column_byte_order<member>()>(buffer + offset * n, out, n);
+}
+
+/**
+ * @brief Returns a view over the column of a single field of `n` records encoded by
+ * `encode_columns`, without decoding it
+ */
+template <auto member>
+inline auto view_column(const uint8_t *buffer, size_t n)
+{
+    using traits = internal::member_pointer_traits<decltype(member)>;
+    using S = typename traits::record_type;
+    constexpr size_t offset = schema<S>::template column_offset<member>();
+    static_assert(offset != SIZE_MAX, "The member is not a field of the schema");
+    return endian_span<typename traits::member_type,
+                       schema<S>::template column_byte_order<member>()>(buffer + offset * n, n);
+}
+
+/**
+ * Number of bytes occupied by an aggregate of type `S` encoded with `encode_struct`, which is the
+ * sum of the sizes of its fields
+ */
+template <typename S>
+constexpr size_t struct_size = []<typename... Fields>(std::tuple<Fields &...> *) {
+    return (sizeof(Fields) + ... + 0);
+}(static_cast<decltype(internal::tie_fields(std::declval<S &>())) *>(nullptr));
+
+/**
+ * @brief Encodes all the fields of an aggregate, in the order in which they are declared, without
+ * padding and without a `schema`
+ *
+ * The number of fields is found at compile time, and the fields are bound with a structured
+ * binding and passed to the variadic `encode`, so every field is stored at a fixed offset.
+ *
+ * @code
+ * struct Reading
+ * {
+ *     uint16_t sensor;
+ *     int32_t value;
+ *     double time;
+ * };
+ * uint8_t buffer[bytes::struct_size<Reading>];
+ * bytes::encode_struct<endian::little>(buffer, reading);
+ * @endcode
+ *
+ * @tparam endianness The endianness to use for encoding
+ * @param buffer The buffer where the encoded aggregate will be stored
+ * @param s An aggregate of 1 to 16 integers and real numbers, with no base classes. Fields which
+ * are arrays or nested aggregates are not supported, use a `schema` for them
+ * @return Number of bytes written to the buffer, which is `struct_size<S>`
+ * @note `buffer` should be of size atleast equal to `struct_size<S>`
+ */
+template <endian endianness, typename S> inline int encode_struct(uint8_t *buffer, const S &s)
+{
+    static_assert(std::is_aggregate_v<S>, "encode_struct can only encode aggregates");
+    return std::apply(
+        [buffer]<typename... Fields>(const Fields &...fields) {
+            static_assert((internal::is_fixed_width<Fields> && ...),
+                          "encode_struct can only encode fields which are integers or real "
+                          "numbers");
+            return encode<endianness>(buffer, fields...);
+        },
+        internal::tie_fields(s));
+}
+
+/**
+ * @brief Decodes all the fields of an aggregate encoded by `encode_struct`
+ * @param buffer The buffer containing the encoded aggregate
+ * @param s The aggregate into which the fields are decoded
+ * @return Number of bytes read from the buffer, which is `struct_size<S>`
+ * @note `buffer` should be of size atleast equal to `struct_size<S>`
+ */
+template <endian endianness, typename S> inline int decode_struct(const uint8_t *buffer, S &s)
+{
+    static_assert(std::is_aggregate_v<S>, "decode_struct can only decode aggregates");
+    return std::apply(
+        [buffer]<typename... Fields>(Fields &...fields) {
+            static_assert((internal::is_fixed_width<Fields> && ...),
+                          "decode_struct can only decode fields which are integers or real "
+                          "numbers");
+            return decode<endianness>(buffer, fields...);
+        },
+        internal::tie_fields(s));
+}
+
+/**
+ * @brief Number of bytes written by `encode` for values of the given integer or real number types,
+ * computed at compile time
+ *
+ * Example usage:
+ * @code
+ * uint8_t buffer[encoded_size<uint8_t, int32_t, double>()];
+ * encode<endian::little>(buffer, code, location_id, value);
+ * @endcode
+ */
+template <typename... Args> constexpr size_t encoded_size()
+{
+    static_assert((internal::is_fixed_width<Args> && ...),
+                  "encoded_size<Args...>() only supports integers and real numbers, pass the "
+                  "values to encoded_size(args...) for strings, vectors and records");
+    return (sizeof(Args) + ... + 0);
+}
+
+/**
+ * @brief Number of bytes needed to encode the given values. Integers and real numbers take their
+ * size, strings (including string literals and string views) and vectors take their length
+ * prefixed size (as written by `encode_length_prefixed`), and records take `packed_size<S>`
+ */
+template <typename T, typename... Args>
+constexpr size_t encoded_size(const T &value, const Args &...args)
+{
+    auto size_of = []<typename U>(const U &v) -> size_t {
+        using V = std::decay_t<U>;
+        if constexpr (internal::is_fixed_width<V>)
+            return sizeof(V);
+        else if constexpr (std::is_same<V, const char *>::value || std::is_same<V, char *>::value)
+            return sizeof(size_t) + std::char_traits<char>::length(v);
+        else if constexpr (internal::is_string<V>::value ||
+                           std::is_same<V, std::string_view>::value ||
+                           internal::is_vector<V>::value)
+            return sizeof(size_t) + v.size() * sizeof(typename V::value_type);
+        else if constexpr (has_schema<V>)
+            return packed_size<V>;
+        else
+            static_assert(internal::False<U>{},
+                          "Invalid type passed to encoded_size, only integers, real numbers, "
+                          "strings, vectors and records supported");
+    };
+    return (size_of(value) + ... + size_of(args));
+}
+
+/**
+ * A cursor which encodes values into a buffer of fixed size, keeping track of the current position.
+ * Every call checks once that all of its values fit in the remaining space. If they do not,
+ * nothing is written and the writer enters a failed state, in which all further calls are ignored.
+ *
+ * Example usage:
+ * @code
+ * uint8_t buffer[64];
+ * bytes::writer w(buffer, sizeof(buffer));
+ * w.put<endian::little>(code, location_id, timestamp).put_length_prefixed<endian::little>(name);
+ * if (!w)
+ *     // Buffer was too small
+ * send(buffer, w.position());
+ * @endcode
+ */
+class writer
+{
+  public:
+    /**
+     * @brief Creates a writer over `size` bytes of `buffer`, starting at position 0
+     */
+    writer(uint8_t *buffer, size_t size) : ptr(buffer), length(size)
+    {
+    }
+
+    /**
+     * @brief Encodes one or more values with specified endianness. Integers and real numbers are
+     * written as is, strings and vectors with a `size_t` length prefix, and records described by
+     * a `schema` with `encode_record`
+     */
+    template <endian endianness, typename T, typename... Args>
+    writer &put(const T &value, const Args &...args)
+    {
+        if constexpr (internal::is_fixed_width<T> && (internal::is_fixed_width<Args> && ...))
+        {
+            constexpr size_t n = encoded_size<T, Args...>();
+            if (reserve(n))
+            {
+                encode<endianness>(ptr + pos, value, args...);
+                pos += n;
+            }
+        }
+        else if (reserve(encoded_size(value, args...)))
+        {
+            put_unchecked<endianness>(value);
+            (put_unchecked<endianness>(args), ...);
+        }
+        return *this;
+    }
+
+    /**
+     * @brief Encodes `n` elements of `arr` with a length prefix, which is a `size_t` by default
+     */
+    template <endian endianness, typename Prefix = size_t, typename T>
+    writer &put_length_prefixed(const T *arr, size_t n)
+    {
+        using prefix = length_prefix<Prefix>;
+        size_t prefix_size = prefix::size(n);
+        if (n <= prefix::max_length && prefix_size <= length - pos &&
+            n <= (length - pos - prefix_size) / sizeof(T) && reserve(prefix_size + n * sizeof(T)))
+        {
+            pos += static_cast<size_t>(prefix::template encode<endianness>(ptr + pos, n));
+            pos += static_cast<size_t>(encode_array<endianness>(ptr + pos, arr, n));
+        }
+        else
+        {
+            failed = true;
+        }
+        return *this;
+    }
+
+    /**
+     * @brief Encodes a string with a length prefix, which is a `size_t` by default
+     */
+    template <endian endianness, typename Prefix = size_t>
+    writer &put_length_prefixed(std::string_view s)
+    {
+        return put_length_prefixed<endianness, Prefix>(s.data(), s.size());
+    }
+
+    /**
+     * @brief Encodes a vector with a length prefix, which is a `size_t` by default
+     */
+    template <endian endianness, typename Prefix = size_t, typename T, typename Allocator>
+    writer &put_length_prefixed(const std::vector<T, Allocator> &v)
+    {
+        return put_length_prefixed<endianness, Prefix>(v.data(), v.size());
+    }
+
+    /**
+     * @brief Encodes an integer as a variable length integer, see `encode_varint`
+     */
+    template <typename T> writer &put_varint(T value)
+    {
+        if (reserve(varint_size(value)))
+        {
+            pos += static_cast<size_t>(encode_varint(ptr + pos, value));
+        }
+        return *this;
+    }
+
+    /**
+     * @brief Encodes a record described by `schema<S>`
+     */
+    template <typename S> writer &put_record(const S &s)
+    {
+        if (reserve(packed_size<S>))
+        {
+            pos += static_cast<size_t>(encode_record(ptr + pos, s));
+        }
+        return *this;
+    }
+
+    /**
+     * @brief Copies `n` raw bytes into the buffer
+     */
+    writer &put_bytes(const void *data, size_t n)
+    {
+        if (reserve(n) && n != 0)
+        {
+            memcpy(ptr + pos, data, n);
+            pos += n;
+        }
+        return *this;
+    }
+
+    /**
+     * @brief Writes `n` zero bytes, which can be used for padding or reserved fields
+     */
+    writer &pad(size_t n)
+    {
+        if (reserve(n) && n != 0)
+        {
+            memset(ptr + pos, 0, n);
+            pos += n;
+        }
+        return *this;
+    }
+
+    /**
+     * @brief Number of bytes written so far
+     */
+    size_t position() const
+    {
+        return pos;
+    }
+
+    size_t size() const
+    {
+        return length;
+    }
+
+    size_t remaining() const
+    {
+        return length - pos;
+    }
+
+    uint8_t *data() const
+    {
+        return ptr;
+    }
+
+    /**
+     * @brief Returns false if a write did not fit in the buffer
+     */
+    bool good() const
+    {
+        return !failed;
+    }
+
+    explicit operator bool() const
+    {
+        return !failed;
+    }
+
+  private:
+    // Encodes a single value, the caller has checked that it fits in the buffer
+    template <endian endianness, typename T> void put_unchecked(const T &value)
+    {
+        using V = std::decay_t<T>;
+        if constexpr (internal::is_fixed_width<V>)
+        {
+            pos += static_cast<size_t>(encode<endianness, V>(ptr + pos, value));
+        }
+        else if constexpr (std::is_same<V, const char *>::value || std::is_same<V, char *>::value)
+        {
+            size_t n = std::char_traits<char>::length(value);
+            pos += static_cast<size_t>(
+                encode_length_prefixed<endianness>(ptr + pos, static_cast<const char *>(value), n));
+        }
+        else if constexpr (has_schema<V>)
+        {
+            pos += static_cast<size_t>(encode_record(ptr + pos, value));
+        }
+        else
+        {
+            pos += static_cast<size_t>(
+                encode_length_prefixed<endianness>(ptr + pos, value.data(), value.size()));
+        }
+    }
+
+    bool reserve(size_t n)
+    {
+        if (failed || n > length - pos)
+        {
+            failed = true;
+            return false;
+        }
+        return true;
+    }
+
+    uint8_t *ptr;
+    size_t length;
+    size_t pos = 0;
+    bool failed = false;
+};
+
+/**
+ * A cursor which decodes values from a buffer of fixed size, keeping track of the current
+ * position. Every call checks once that the buffer contains enough bytes for all of its values. If
+ * it does not, or if a sequence is longer than the maximum length passed, nothing is read and the
+ * reader enters a failed state, in which all further calls are ignored.
+ *
+ * Example usage:
+ * @code
+ * bytes::reader r(buffer, size);
+ * r.get<endian::little>(code, location_id, timestamp);
+ * r.get_length_prefixed<endian::little>(name, 100);
+ * if (!r)
+ *     // Message was truncated or malformed
+ * @endcode
+ */
+class reader
+{
+  public:
+    /**
+     * @brief Creates a reader over `size` bytes of `buffer`, starting at position 0
+     */
+    reader(const uint8_t *buffer, size_t size) : ptr(buffer), length(size)
+    {
+    }
+
+    /**
+     * @brief Decodes one or more integers or real numbers with specified endianness
+     */
+    template <endian endianness, typename T, typename... Args>
+    reader &get(T &value, Args &...args)
+    {
+        constexpr size_t n = (sizeof(T) + ... + sizeof(Args));
+        if (reserve(n))
+        {
+            decode<endianness>(ptr + pos, value, args...);
+            pos += n;
+        }
+        return *this;
+    }
+
+    /**
+     * @brief Decodes a length-prefixed string into `s`, which is not modified if the read fails
+     */
+    template <endian endianness, typename Prefix = size_t, typename Traits, typename Allocator>
+    reader &get_length_prefixed(std::basic_string<char, Traits, Allocator> &s, size_t max_length)
+    {
+        size_t prefix_size;
+        size_t n = sequence_length<endianness, Prefix>(max_length, sizeof(char), prefix_size);
+        if (!failed)
+        {
+            s.assign(reinterpret_cast<const char *>(ptr + pos + prefix_size), n);
+            pos += prefix_size + n;
+        }
+        return *this;
+    }
+
+    /**
+     * @brief Decodes a length-prefixed vector into `v`, which is not modified if the read fails
+     */
+    template <endian endianness, typename Prefix = size_t, typename T, typename Allocator>
+    reader &get_length_prefixed(std::vector<T, Allocator> &v, size_t max_length)
+    {
+        size_t prefix_size;
+        size_t n = sequence_length<endianness, Prefix>(max_length, sizeof(T), prefix_size);
+        if (!failed)
+        {
+            v.resize(n);
+            decode_array<endianness>(ptr + pos + prefix_size, v.data(), n);
+            pos += prefix_size + n * sizeof(T);
+        }
+        return *this;
+    }
+
+    /**
+     * @brief Points `s` to a length-prefixed string in the buffer, without copying it
+     */
+    template <endian endianness, typename Prefix = size_t>
+    reader &view_length_prefixed(std::string_view &s, size_t max_length)
+    {
+        size_t prefix_size;
+        size_t n = sequence_length<endianness, Prefix>(max_length, sizeof(char), prefix_size);
+        if (!failed)
+        {
+            s = std::string_view(reinterpret_cast<const char *>(ptr + pos + prefix_size), n);
+            pos += prefix_size + n;
+        }
+        return *this;
+    }
+
+    /**
+     * @brief Points `s` to a length-prefixed array in the buffer, without copying or decoding it
+     */
+    template <endian endianness, typename Prefix = size_t, typename T>
+    reader &view_length_prefixed(endian_span<T, endianness> &s, size_t max_length)
+    {
+        size_t prefix_size;
+        size_t n = sequence_length<endianness, Prefix>(max_length, sizeof(T), prefix_size);
+        if (!failed)
+        {
+            s = endian_span<T, endianness>(ptr + pos + prefix_size, n);
+            pos += prefix_size + n * sizeof(T);
+        }
+        return *this;
+    }
+
+    /**
+     * @brief Decodes a variable length integer, see `decode_varint`
+     */
+    template <typename T> reader &get_varint(T &value)
+    {
+        int n = failed ? -1 : decode_varint(ptr + pos, length - pos, value);
+        if (n == -1)
+            failed = true;
+        else
+            pos += static_cast<size_t>(n);
+        return *this;
+    }
+
+    /**
+     * @brief Decodes a record described by `schema<S>`
+     */
+    template <typename S> reader &get_record(S &s)
+    {
+        if (reserve(packed_size<S>))
+        {
+            pos += static_cast<size_t>(decode_record(ptr + pos, s));
+        }
+        return *this;
+    }
+
+    /**
+     * @brief Copies `n` raw bytes from the buffer into `data`
+     */
+    reader &get_bytes(void *data, size_t n)
+    {
+        if (reserve(n) && n != 0)
+        {
+            memcpy(data, ptr + pos, n);
+            pos += n;
+        }
+        return *this;
+    }
+
+    /**
+     * @brief Skips `n` bytes
+     */
+    reader &skip(size_t n)
+    {
+        if (reserve(n))
+            pos += n;
+        return *this;
+    }
+
+    /**
+     * @brief Skips a length-prefixed string or vector of type `T` without decoding it, only the
+     * prefix is read
+     */
+    template <endian endianness, typename T, typename Prefix = size_t>
+    reader &skip_length_prefixed(size_t max_length)
+    {
+        static_assert(internal::is_string<T>::value || internal::is_vector<T>::value,
+                      "skip_length_prefixed can only skip strings and vectors");
+        constexpr size_t element_size = sizeof(typename T::value_type);
+        size_t prefix_size;
+        size_t n = sequence_length<endianness, Prefix>(max_length, element_size, prefix_size);
+        if (!failed)
+            pos += prefix_size + n * element_size;
+        return *this;
+    }
+
+    /**
+     * @brief Number of bytes read so far
+     */
+    size_t position() const
+    {
+        return pos;
+    }
+
+    size_t size() const
+    {
+        return length;
+    }
+
+    size_t remaining() const
+    {
+        return length - pos;
+    }
+
+    /**
+     * @brief Pointer to the current position in the buffer
+     */
+    const uint8_t *current() const
+    {
+        return ptr + pos;
+    }
+
+    /**
+     * @brief Returns false if a read went past the end of the buffer or a sequence was too long
+     */
+    bool good() const
+    {
+        return !failed;
+    }
+
+    explicit operator bool() const
+    {
+        return !failed;
+    }
+
+  private:
+    bool reserve(size_t n)
+    {
+        if (failed || n > length - pos)
+        {
+            failed = true;
+            return false;
+        }
+        return true;
+    }
+
+    // Decodes the length prefix of a sequence at the current position, and checks that the
+    // sequence is within max_length and fits in the buffer. Sets the failed state if it does not
+    template <endian endianness, typename Prefix>
+    size_t sequence_length(size_t max_length, size_t element_size, size_t &prefix_size)
+    {
+        size_t n = 0;
+        prefix_size = 0;
+        if (failed)
+            return 0;
+        int result =
+            length_prefix<Prefix>::template decode<endianness>(ptr + pos, length - pos, n);
+        if (result == -1)
+        {
+            failed = true;
+            return 0;
+        }
+        prefix_size = static_cast<size_t>(result);
+        if (n > max_length || n > (length - pos - prefix_size) / element_size)
+            failed = true;
+        return n;
+    }
+
+    const uint8_t *ptr;
+    size_t length;
+    size_t pos = 0;
+    bool failed = false;
+};
+
+} // namespace bytes
+
+/**
+ * Opt-in instrumentation of the stream api. When `DATAPACKER_STATS` is defined to 1, every call to
+ * `stream::write`, `stream::read`, `stream::read_chunked` and the same functions of
+ * `stream::buffered_writer` and `stream::buffered_reader` is counted per type and endianness,
+ * along with the number of bytes, the length of sequences and the time taken by the call.
+ * Otherwise nothing is recorded, and `snapshot()` returns an empty report.
+ *
+ * @code
+ * auto report = datapacker::stats::snapshot();
+ * if (auto s = report.find<std::vector<double>>(endian::little))
+ *     printf("p99 length: %" PRIu64 "\n", s->reads.lengths.quantile(0.99));
+ * @endcode
+ */
+namespace stats
+{
+constexpr bool enabled = DATAPACKER_STATS;
+
+/**
+ * Counts of values in buckets of powers of 2, bucket 0 counts zeros and bucket `i` counts values
+ * in `[2^(i-1), 2^i)`
+ */
+struct histogram
+{
+    std::array<uint64_t, 65> buckets{};
+
+    uint64_t count() const
+    {
+        uint64_t total = 0;
+        for (uint64_t n : buckets)
+            total += n;
+        return total;
+    }
+
+    // Largest value counted in bucket `i`
+    static constexpr uint64_t bucket_limit(size_t i)
+    {
+        return i == 0 ? 0 : i >= 64 ? std::numeric_limits<uint64_t>::max() : (uint64_t(1) << i) - 1;
+    }
+
+    /**
+     * @brief Upper bound of the `q` quantile (0 <= q <= 1), which is the largest value of the
+     * bucket of the quantile, or 0 if nothing was counted
+     */
+    uint64_t quantile(double q) const
+    {
+        uint64_t total = count();
+        if (total == 0)
+            return 0;
+        auto rank = static_cast<uint64_t>(q * static_cast<double>(total - 1));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < buckets.size(); i++)
+        {
+            seen += buckets[i];
+            if (seen > rank)
+                return bucket_limit(i);
+        }
+        return bucket_limit(buckets.size() - 1);
+    }
+};
+
+// Statistics of the writes or the reads of a type
+struct operation_stats
+{
+    uint64_t calls = 0;
+    // Bytes written or read by the calls which succeeded
+    uint64_t bytes = 0;
+    // Number of elements of sequences, not counted for other types
+    histogram lengths;
+    // Time taken by each call
+    histogram nanoseconds;
+};
+
+struct type_stats
+{
+    std::string_view type;
+    endian endianness;
+    operation_stats writes;
+    operation_stats reads;
+};
+
+namespace internal
+{
+// Name of a type as spelt by the compiler, such as `unsigned int` or `std::vector<double>`
+template <typename T> constexpr std::string_view type_name()
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    std::string_view name = __FUNCSIG__;
+    size_t begin = name.find("type_name<") + 10;
+    size_t end = name.rfind(">(void)");
+#else
+    std::string_view name = __PRETTY_FUNCTION__;
+    size_t begin = name.find("T = ") + 4;
+    size_t end = name.find_first_of(";]", begin);
+#endif
+    return name.substr(begin, end - begin);
+}
+} // namespace internal
+
+struct report
+{
+    // Types in an unspecified order, only types which were written or read are included
+    std::vector<type_stats> types;
+    // Number of sequences which were rejected because they had more than `max_elements` elements
+    uint64_t max_elements_rejections = 0;
+    // Lengths of the rejected sequences
+    histogram rejected_lengths;
+
+    /**
+     * @brief Statistics of `T` with the given endianness, or nullptr if it was not used. Strings
+     * written from string literals are counted as `const char *`, and sequences read with
+     * `read_chunked` as `std::span<const T>`.
+     */
+    template <typename T> const type_stats *find(endian endianness) const
+    {
+        for (const type_stats &s : types)
+        {
+            if (s.type == internal::type_name<T>() && s.endianness == endianness)
+                return &s;
+        }
+        return nullptr;
+    }
+};
+
+#if DATAPACKER_STATS
+namespace internal
+{
+enum class operation
+{
+    write,
+    read
+};
+
+struct atomic_histogram
+{
+    std::array<std::atomic<uint64_t>, 65> buckets{};
+
+    void add(uint64_t value)
+    {
+        buckets[std::bit_width(value)].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    histogram load() const
+    {
+        histogram h;
+        for (size_t i = 0; i < buckets.size(); i++)
+            h.buckets[i] = buckets[i].load(std::memory_order_relaxed);
+        return h;
+    }
+
+    void reset()
+    {
+        for (auto &bucket : buckets)
+            bucket.store(0, std::memory_order_relaxed);
+    }
+};
+
+struct counters
+{
+    std::atomic<uint64_t> calls{0};
+    std::atomic<uint64_t> bytes{0};
+    atomic_histogram lengths;
+    atomic_histogram nanoseconds;
+
+    operation_stats load() const
+    {
+        return {calls.load(std::memory_order_relaxed), bytes.load(std::memory_order_relaxed),
+                lengths.load(), nanoseconds.load()};
+    }
+
+    void reset()
+    {
+        calls.store(0, std::memory_order_relaxed);
+        bytes.store(0, std::memory_order_relaxed);
+        lengths.reset();
+        nanoseconds.reset();
+    }
+};
+
+struct entry;
+// Entries form a list which is only prepended to, so that it can be read while it grows
+inline std::atomic<entry *> entries{nullptr};
+inline counters rejections;
+
+struct entry
+{
+    entry(std::string_view name, endian e) : type(name), endianness(e)
+    {
+        next = entries.load(std::memory_order_relaxed);
+        while (!entries.compare_exchange_weak(next, this, std::memory_order_release,
+                                              std::memory_order_relaxed))
+        {
+        }
+    }
+
+    std::string_view type;
+    endian endianness;
+    counters writes;
+    counters reads;
+    entry *next;
+};
+
+template <typename T, endian endianness> inline entry &entry_for()
+{
+    static entry e(type_name<T>(), endianness);
+    return e;
+}
+
+// Counts a sequence which was rejected by the `max_elements` check
+inline void rejected(size_t length)
+{
+    rejections.calls.fetch_add(1, std::memory_order_relaxed);
+    rejections.lengths.add(length);
+}
+
+// Size of a value in the stream, and its number of elements if it is a sequence
+struct value_size
+{
+    size_t bytes;
+    size_t length;
+    bool is_sequence;
+};
+
+// `T` is `std::span<const E>` for sequences read with `read_chunked`, whose length is passed as
+// `value`
+template <typename Prefix, typename T, typename Value> inline value_size size_of(const Value &value)
+{
+    using prefix = bytes::length_prefix<Prefix>;
+    if constexpr (datapacker::internal::is_fixed_width<T>)
+    {
+        return {sizeof(T), 0, false};
+    }
+    else if constexpr (std::is_same<T, const char *>::value || std::is_same<T, char *>::value)
+    {
+        size_t n = strlen(value);
+        return {prefix::size(n) + n, n, true};
+    }
+    else if constexpr (datapacker::internal::is_string<T>::value ||
+                       datapacker::internal::is_vector<T>::value)
+    {
+        size_t n = value.size();
+        return {prefix::size(n) + n * sizeof(typename T::value_type), n, true};
+    }
+    else if constexpr (bytes::has_schema<T>)
+    {
+        return {bytes::packed_size<T>, 0, false};
+    }
+    else
+    {
+        return {prefix::size(value) + value * sizeof(typename T::value_type), value, true};
+    }
+}
+
+template <operation op, typename T, endian endianness> inline counters &counters_for()
+{
+    // String literals decay to `char *`
+    using K = std::conditional_t<std::is_same<T, char *>::value, const char *, T>;
+    entry &e = entry_for<K, endianness>();
+    return op == operation::write ? e.writes : e.reads;
+}
+
+inline void add_size(counters &c, value_size size)
+{
+    c.bytes.fetch_add(size.bytes, std::memory_order_relaxed);
+    if (size.is_sequence)
+        c.lengths.add(size.length);
+}
+
+/**
+ * Records a call when it is destroyed, with the time since it was constructed. The size of
+ * `value` is recorded only if `s` is not in a failed state and no exception was thrown.
+ */
+template <operation op, endian endianness, typename Prefix, typename T, typename Stream,
+          typename Value>
+class probe
+{
+  public:
+    probe(const Stream &stream, const Value &value)
+        : s(stream), v(value), start(std::chrono::steady_clock::now()),
+          exceptions(std::uncaught_exceptions())
+    {
+    }
+
+    probe(const probe &) = delete;
+    probe &operator=(const probe &) = delete;
+
+    ~probe()
+    {
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        counters &c = counters_for<op, T, endianness>();
+        c.calls.fetch_add(1, std::memory_order_relaxed);
+        c.nanoseconds.add(static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+        bool ok = std::uncaught_exceptions() == exceptions;
+        if constexpr (std::is_constructible<bool, const Stream &>::value)
+            ok = ok && static_cast<bool>(s);
+        if (ok)
+            add_size(c, size_of<Prefix, T>(v));
+    }
+
+  private:
+    const Stream &s;
+    const Value &v;
+    std::chrono::steady_clock::time_point start;
+    int exceptions;
+};
+
+// Measures a write of `value` (of type `T`) to `s`, until the returned probe is destroyed
+template <endian endianness, typename Prefix, typename T, typename Stream, typename Value>
+inline auto measure_write(const Stream &s, const Value &value)
+{
+    return probe<operation::write, endianness, Prefix, T, Stream, Value>(s, value);
+}
+
+// Measures a read into `value` from `s`, until the returned probe is destroyed
+template <endian endianness, typename Prefix, typename T, typename Stream, typename Value>
+inline auto measure_read(const Stream &s, const Value &value)
+{
+    return probe<operation::read, endianness, Prefix, T, Stream, Value>(s, value);
+}
+
+// Counts values which were written together, without measuring the time taken
+template <operation op, endian endianness, typename... Args>
+inline void count_values(const Args &...args)
+{
+    auto add = []<typename U>(const U &value) {
+        using T = std::decay_t<U>;
+        counters &c = counters_for<op, T, endianness>();
+        c.calls.fetch_add(1, std::memory_order_relaxed);
+        add_size(c, size_of<size_t, T>(value));
+    };
+    (add(args), ...);
+}
+} // namespace internal
+
+/**
+ * @brief Returns the statistics recorded so far. Counters are read one at a time while other
+ * threads may be updating them, so they are not an exact snapshot of an instant.
+ */
+inline report snapshot()
+{
+    report r;
+    for (auto e = internal::entries.load(std::memory_order_acquire); e != nullptr; e = e->next)
+        r.types.push_back({e->type, e->endianness, e->writes.load(), e->reads.load()});
+    r.max_elements_rejections = internal::rejections.calls.load(std::memory_order_relaxed);
+    r.rejected_lengths = internal::rejections.lengths.load();
+    return r;
+}
+
+/**
+ * @brief Sets all statistics to zero, types which were already used are still reported
+ */
+inline void reset()
+{
+    for (auto e = internal::entries.load(std::memory_order_acquire); e != nullptr; e = e->next)
+    {
+        e->writes.reset();
+        e->reads.reset();
+    }
+    internal::rejections.reset();
+}
+#else
+namespace internal
+{
+enum class operation
+{
+    write,
+    read
+};
+
+struct probe
+{
+};
+
+template <endian, typename, typename, typename Stream, typename Value>
+inline probe measure_write(const Stream &, const Value &)
+{
+    return {};
+}
+
+template <endian, typename, typename, typename Stream, typename Value>
+inline probe measure_read(const Stream &, const Value &)
+{
+    return {};
+}
+
+inline void rejected(size_t)
+{
+}
+
+template <operation, endian, typename... Args> inline void count_values(const Args &...)
+{
+}
+} // namespace internal
+
+inline report snapshot()
+{
+    return {};
+}
+
+inline void reset()
+{
+}
+#endif
+} // namespace stats
+
+/**
+ * Functions in this namespace operate over streams - `istream` and `ostream`. They do not require
+ * manual management of buffers
+ */
+namespace stream
+{
+
+/**
+ * A reusable buffer which can be passed to `write` and `read`. Sequences which need to be byte
+ * swapped or converted are encoded/decoded in chunks of `size()` bytes, so a larger scratch buffer
+ * results in fewer calls to the underlying stream. Without a scratch buffer, a stack buffer of
+ * `STREAM_CHUNK_SIZE` bytes is used.
+ */
+class scratch
+{
+  public:
+    explicit scratch(size_t size = STREAM_CHUNK_SIZE)
+        : buffer(size < MIN_SIZE ? MIN_SIZE : size), ptr(buffer.data()), length(buffer.size())
+    {
+    }
+
+    /**
+     * @brief Uses `size` bytes of `memory` owned by the caller as the buffer, which should be
+     * atleast 16 bytes to read or write sequences
+     */
+    scratch(uint8_t *memory, size_t size) : ptr(memory), length(size)
+    {
+    }
+
+    scratch(const scratch &other)
+        : buffer(other.buffer), ptr(buffer.empty() ? other.ptr : buffer.data()),
+          length(other.length)
+    {
+    }
+
+    scratch &operator=(const scratch &other)
+    {
+        buffer = other.buffer;
+        ptr = buffer.empty() ? other.ptr : buffer.data();
+        length = other.length;
+        return *this;
+    }
+
+    uint8_t *data()
+    {
+        return ptr;
+    }
+
+    size_t size() const
+    {
+        return length;
+    }
+
+  private:
+    // Large enough to hold a length prefix and one element
+    static constexpr size_t MIN_SIZE = 16;
+    std::vector<uint8_t> buffer;
+    uint8_t *ptr;
+    size_t length;
+};
+
+namespace internal
+{
+// True if a sequence of T can be copied between memory and the stream without encoding
+template <endian endianness, typename T>
+constexpr bool is_stream_copyable =
+    datapacker::internal::is_bit_copyable<T> &&
+    (sizeof(T) == 1 || datapacker::internal::is_native_endian<endianness>);
+
+// True if a sequence of T can be read directly into memory and then byte swapped in place
+template <endian endianness, typename T>
+constexpr bool is_stream_swappable =
+    datapacker::internal::is_bit_copyable<T> &&
+    datapacker::internal::is_native_endian<endianness == endian::little ? endian::big
+                                                                        : endian::little>;
+
+/**
+ * Writes `n` elements of `arr` with a length prefix. The elements are encoded in chunks using
+ * `chunk`, which should be atleast 16 bytes, or written directly if no encoding is needed.
+ */
+template <endian endianness, typename Prefix, typename T>
+inline std::ostream &write_sequence(std::ostream &os, const T *arr, size_t n, uint8_t *chunk,
+                                    size_t chunk_size)
+{
+    using prefix = bytes::length_prefix<Prefix>;
+    if (n > prefix::max_length)
+    {
+        throw std::runtime_error("Sequence is too long for its length prefix, write failed");
+    }
+    size_t used = static_cast<size_t>(prefix::template encode<endianness>(chunk, n));
+    if constexpr (is_stream_copyable<endianness, T>)
+    {
+        if (n * sizeof(T) > chunk_size - used)
+        {
+            os.write(reinterpret_cast<const char *>(chunk), static_cast<std::streamsize>(used));
+            return os.write(reinterpret_cast<const char *>(arr),
+                            static_cast<std::streamsize>(n * sizeof(T)));
+        }
+    }
+    size_t i = 0;
+    while (true)
+    {
+        size_t count = (chunk_size - used) / sizeof(T);
+        if (count > n - i)
+            count = n - i;
+        used += static_cast<size_t>(bytes::encode_array<endianness>(chunk + used, arr + i, count));
+        i += count;
+        os.write(reinterpret_cast<const char *>(chunk), static_cast<std::streamsize>(used));
+        if (i == n || !os)
+            break;
+        used = 0;
+    }
+    return os;
+}
+
+/**
+ * Reads the length prefix of a sequence into `sz`, returns false if the stream ended. Throws a
+ * `std::runtime_error` if the prefix is invalid or the length is more than `max_elements`
+ */
+template <endian endianness, typename Prefix>
+inline bool read_length(std::istream &is, size_t max_elements, size_t &sz)
+{
+    using prefix = bytes::length_prefix<Prefix>;
+    uint8_t buffer[prefix::max_size];
+    size_t prefix_size = 0;
+    if constexpr (std::is_same<Prefix, bytes::varint_prefix>::value)
+    {
+        // The size of a varint is only known after its last byte has been read
+        do
+        {
+            is.read(reinterpret_cast<char *>(buffer + prefix_size), 1);
+        } while (is && (buffer[prefix_size++] & 0x80) && prefix_size < prefix::max_size);
+    }
+    else
+    {
+        is.read(reinterpret_cast<char *>(buffer), sizeof(buffer));
+        prefix_size = sizeof(buffer);
+    }
+    if (!is)
+        return false;
+    if (prefix::template decode<endianness>(buffer, prefix_size, sz) == -1)
+    {
+        // Throw error
+        throw std::runtime_error("Sequence size could not be determined");
+    }
+    if (sz > max_elements)
+    {
+        stats::internal::rejected(sz);
+        throw std::runtime_error("Data contains more elements than max_elements, read failed");
+    }
+    return true;
+}
+
+/**
+ * Reads a length prefixed sequence into `value`, the elements are read directly into the storage
+ * of `value` if possible, otherwise they are decoded in chunks using `chunk`
+ */
+template <endian endianness, typename Prefix, typename T>
+inline std::istream &read_sequence(std::istream &is, T &value, size_t max_elements,
+                                   uint8_t *chunk, size_t chunk_size)
+{
+    using V = typename T::value_type;
+    size_t sz = 0;
+    if (!read_length<endianness, Prefix>(is, max_elements, sz))
+        return is;
+    value.resize(sz);
+    if (sz == 0)
+        return is;
+
+    if constexpr (is_stream_copyable<endianness, V> || is_stream_swappable<endianness, V>)
+    {
+        is.read(reinterpret_cast<char *>(value.data()),
+                static_cast<std::streamsize>(sz * sizeof(V)));
+        if constexpr (!is_stream_copyable<endianness, V>)
+        {
+            if (is)
+            {
+                auto data = reinterpret_cast<uint8_t *>(value.data());
+                datapacker::internal::copy_swapped<sizeof(V)>(data, data, sz);
+            }
+        }
+    }
+    else
+    {
+        size_t per_chunk = chunk_size / sizeof(V);
+        for (size_t i = 0; i < sz; i += per_chunk)
+        {
+            size_t count = per_chunk < sz - i ? per_chunk : sz - i;
+            is.read(reinterpret_cast<char *>(chunk),
+                    static_cast<std::streamsize>(count * sizeof(V)));
+            if (!is)
+                return is;
+            bytes::decode_array<endianness>(chunk, value.data() + i, count);
+        }
+    }
+    return is;
+}
+
+/**
+ * Advances the stream by `n` bytes. Seekable streams are advanced with `seekg` without reading the
+ * bytes, other streams with `ignore`, which fails the stream if it ends before `n` bytes
+ */
+inline std::istream &skip_bytes(std::istream &is, size_t n)
+{
+    if (!is || n == 0)
+        return is;
+    if (is.tellg() != std::streampos(-1))
+        return is.seekg(static_cast<std::streamoff>(n), std::ios_base::cur);
+    is.ignore(static_cast<std::streamsize>(n));
+    if (static_cast<size_t>(is.gcount()) != n)
+        is.setstate(std::ios_base::failbit);
+    return is;
+}
+} // namespace internal
+
+/**
+ * @brief Writes a record described by `bytes::schema<S>` to the stream
+ * @param os Stream to write to
+ * @param s Record to be written
+ * @return `os`
+ */
+template <typename S> inline std::ostream &write_record(std::ostream &os, const S &s)
+{
+    uint8_t buffer[bytes::packed_size<S>];
+    bytes::encode_record(buffer, s);
+    return os.write(reinterpret_cast<const char *>(buffer), sizeof(buffer));
+}
+
+/**
+ * @brief Reads a record described by `bytes::schema<S>` from the stream
+ * @param is Stream to read from
+ * @param s Where the record read will be stored, it is not modified if the read fails
+ * @return `is`
+ */
+template <typename S> inline std::istream &read_record(std::istream &is, S &s)
+{
+    uint8_t buffer[bytes::packed_size<S>];
+    if (is.read(reinterpret_cast<char *>(buffer), sizeof(buffer)))
+        bytes::decode_record(buffer, s);
+    return is;
+}
+
+/**
+ * @brief Writes a value to the stream with specified endianness
+ *
+ * Integers and real numbers are written as is, strings (including string literals) and vectors are
+ * written with a length prefix, and records described by `bytes::schema` with `write_record`. No
+ * memory is allocated, sequences are encoded in chunks in `s`.
+ *
+ * @tparam endianness The endianness to use for encoding
+ * @tparam Prefix Type of the length prefix of sequences, `size_t` or `bytes::varint_prefix`, see
+ * `bytes::length_prefix`. A `std::runtime_error` is thrown if a sequence is too long for it
+ * @param os Stream to write to
+ * @param value Value to be written
+ * @param s Buffer used to encode sequences
+ * @return `os`
  */
-template <endian endianness, typename T>
-inline int decode_length_prefixed(uint8_t *buffer, std::vector<T> &v, size_t max_length)
+template <endian endianness, typename Prefix = size_t, typename T>
+inline std::ostream &write(std::ostream &os, const T &value, scratch &s)
 {
-    std::vector<T> vec;
-    vec.resize(max_length);
-    auto bytes_read = decode_length_prefixed<endianness>(buffer, vec.data(), max_length);
-    if (bytes_read == -1)
+    using V = std::decay_t<T>;
+    [[maybe_unused]] auto probe = stats::internal::measure_write<endianness, Prefix, V>(os, value);
+    if constexpr (std::is_integral<V>::value || std::is_floating_point<V>::value)
     {
-        return -1;
+        uint8_t buffer[sizeof(V)];
+        bytes::encode<endianness>(buffer, value);
+        return os.write(reinterpret_cast<const char *>(buffer), sizeof(V));
+    }
+    // If T is a string literal
+    else if constexpr (std::is_same<V, const char *>::value || std::is_same<V, char *>::value)
+    {
+        const char *str = value;
+        return internal::write_sequence<endianness, Prefix>(os, str, strlen(str), s.data(),
+                                                            s.size());
+    }
+    // If T is a vector or a string, the length is written as a Prefix
+    else if constexpr (datapacker::internal::is_string<T>::value ||
+                       datapacker::internal::is_vector<T>::value)
+    {
+        return internal::write_sequence<endianness, Prefix>(os, value.data(), value.size(),
+                                                            s.data(), s.size());
+    }
+    else if constexpr (bytes::has_schema<V>)
+    {
+        return write_record(os, value);
+    }
+    else
+    {
+        static_assert(datapacker::internal::False<T>{},
+                      "Invalid type passed to write, can only encode integers, real "
+                      "numbers, vectors, strings and records");
     }
-    vec.resize((bytes_read - sizeof(typename std::vector<T>::size_type)) / sizeof(T));
-    v = std::move(vec);
-    return bytes_read;
 }
-} // namespace bytes
 
 /**
- * Functions in this namespace operate over streams - `istream` and `ostream`. They do not require
- * manual management of buffers
+ * @brief Writes a value to the stream with specified endianness, see the overload which takes a
+ * `scratch` buffer. Sequences are encoded using a stack buffer of `STREAM_CHUNK_SIZE` bytes.
  */
-namespace stream
+template <endian endianness, typename Prefix = size_t, typename T>
+inline std::ostream &write(std::ostream &os, const T &value)
 {
+    using V = std::decay_t<T>;
+    // Only sequences are encoded in chunks
+    constexpr size_t chunk_size =
+        datapacker::internal::is_fixed_width<V> || bytes::has_schema<V> ? 1 : STREAM_CHUNK_SIZE;
+    uint8_t chunk[chunk_size];
+    scratch s(chunk, chunk_size);
+    return write<endianness, Prefix>(os, value, s);
+}
 
-template <endian endianness, typename T> inline std::ostream &write(std::ostream &os, T value)
+/**
+ * @brief Writes multiple values to the stream with specified endianness. If all of them fit in
+ * `STREAM_CHUNK_SIZE` bytes, they are encoded into a single stack buffer and written with one call
+ * to `os.write`, otherwise they are written one by one
+ */
+template <endian endianness, typename T, typename U, typename... Args>
+    requires(!std::is_same_v<U, scratch>)
+inline std::ostream &write(std::ostream &os, const T &value, const U &next, const Args &...args)
 {
-    std::vector<uint8_t> buffer;
-    // Allocate a buffer of necessary size
+    if (bytes::encoded_size(value, next, args...) <= STREAM_CHUNK_SIZE)
+    {
+        uint8_t buffer[STREAM_CHUNK_SIZE];
+        bytes::writer w(buffer, sizeof(buffer));
+        w.put<endianness>(value, next, args...);
+        if (os.write(reinterpret_cast<const char *>(buffer),
+                     static_cast<std::streamsize>(w.position())))
+            stats::internal::count_values<stats::internal::operation::write, endianness>(
+                value, next, args...);
+        return os;
+    }
+    write<endianness>(os, value);
+    write<endianness>(os, next);
+    (write<endianness>(os, args), ...);
+    return os;
+}
+
+/**
+ * @brief Reads a value from the stream with specified endianness
+ *
+ * Strings and vectors are read directly into the storage of `value`, reusing its capacity. If
+ * elements have to be converted, they are decoded in chunks in `s`.
+ *
+ * @tparam endianness The endianness of the data in the stream
+ * @tparam Prefix Type of the length prefix of sequences, see `bytes::length_prefix`
+ * @param is Stream to read from
+ * @param value Where the value read will be stored
+ * @param s Buffer used to decode sequences
+ * @param max_elements Maximum number of elements in a string or vector, a `std::runtime_error` is
+ * thrown if the stream contains more elements
+ * @return `is`
+ * @note If the read fails, the contents of `value` are unspecified
+ */
+template <endian endianness, typename Prefix = size_t, typename T>
+inline std::istream &read(std::istream &is, T &value, scratch &s,
+                          size_t max_elements = DEFAULT_MAX_NUMBER_OF_ELEMENTS)
+{
+    [[maybe_unused]] auto probe = stats::internal::measure_read<endianness, Prefix, T>(is, value);
     if constexpr (std::is_integral<T>::value || std::is_floating_point<T>::value)
     {
-        buffer.resize(sizeof(T));
-        bytes::encode<endianness>(buffer.data(), value);
+        uint8_t buffer[sizeof(T)];
+        is.read(reinterpret_cast<char *>(buffer), sizeof(T));
+        if (!is)
+            return is;
+        bytes::decode<endianness>(buffer, value);
     }
-    // If T is a const string literal
-    else if constexpr (std::is_same<T, const char *>::value)
+    // If T is a vector or a string, also read the length prefix
+    else if constexpr (datapacker::internal::is_string<T>::value ||
+                       datapacker::internal::is_vector<T>::value)
     {
-        size_t str_size = strlen(value);
-        buffer.resize(sizeof(size_t) + str_size);
-        bytes::encode_length_prefixed<endianness>(buffer.data(), value, str_size);
+        internal::read_sequence<endianness, Prefix>(is, value, max_elements, s.data(),
+                                                    s.size());
     }
-    // If T is a vector or a string, also allocate memory of sizeof(size_t) for the length
-    else if constexpr (std::is_same<T, std::string>::value ||
-                       std::is_same<T, std::vector<typename T::value_type>>::value)
+    else if constexpr (bytes::has_schema<T>)
     {
-        buffer.resize(sizeof(size_t) + value.size() * sizeof(typename T::value_type));
-        bytes::encode_length_prefixed<endianness>(buffer.data(), value);
+        read_record(is, value);
     }
     else
     {
-        static_assert(internal::False<T>{},
-                      "Invalid type passed to write, can only encode integers, real "
-                      "numbers, vectors, and strings");
+        static_assert(datapacker::internal::False<T>{},
+                      "Invalid type passed to read, can only decode integers, real "
+                      "numbers, vectors, strings and records");
     }
-    return os.write(reinterpret_cast<const char *>(buffer.data()), buffer.size());
+    return is;
 }
 
-template <endian endianness, typename T>
+/**
+ * @brief Reads a value from the stream with specified endianness, see the overload which takes a
+ * `scratch` buffer. Sequences are decoded using a stack buffer of `STREAM_CHUNK_SIZE` bytes.
+ */
+template <endian endianness, typename Prefix = size_t, typename T>
 inline std::istream &read(std::istream &is, T &value,
                           size_t max_elements = DEFAULT_MAX_NUMBER_OF_ELEMENTS)
 {
-    std::vector<uint8_t> buffer;
-    // Allocate a buffer of necessary size
+    // Only sequences are decoded in chunks
+    constexpr size_t chunk_size =
+        datapacker::internal::is_fixed_width<T> || bytes::has_schema<T> ? 1 : STREAM_CHUNK_SIZE;
+    uint8_t chunk[chunk_size];
+    scratch s(chunk, chunk_size);
+    return read<endianness, Prefix>(is, value, s, max_elements);
+}
+
+/**
+ * @brief Skips a value of type `T` written by `write`, without reading or decoding it
+ *
+ * Only the length prefix of strings and vectors is read, the rest of the value is skipped with
+ * `seekg` if the stream is seekable, otherwise with `ignore`. Skipping never allocates memory.
+ *
+ * @code
+ * // Finds the record with the given key, skipping the payloads of the other records
+ * while (stream::read<endian::little>(is, key) && key != wanted)
+ *     stream::skip<endian::little, std::vector<uint8_t>>(is);
+ * @endcode
+ *
+ * @tparam endianness The endianness of the data in the stream
+ * @tparam T The type of the value, which is an integer, a real number, a string, a vector or a
+ * record described by `bytes::schema`
+ * @tparam Prefix Type of the length prefix of sequences, see `bytes::length_prefix`
+ * @param is Stream to skip the value in
+ * @param max_elements Maximum number of elements in a string or vector, a `std::runtime_error` is
+ * thrown if the stream contains more elements
+ * @return `is`
+ * @note A seekable stream such as a file may not fail when a value past its end is skipped, the
+ * next read fails instead
+ */
+template <endian endianness, typename T, typename Prefix = size_t>
+inline std::istream &skip(std::istream &is, size_t max_elements = DEFAULT_MAX_NUMBER_OF_ELEMENTS)
+{
     if constexpr (std::is_integral<T>::value || std::is_floating_point<T>::value)
     {
-        buffer.resize(sizeof(T));
-        is.read(reinterpret_cast<char *>(buffer.data()), buffer.size());
-        if (!is)
-            return is;
-        bytes::decode<endianness>(buffer.data(), value);
+        return internal::skip_bytes(is, sizeof(T));
     }
-    // If T is a vector or a string, also allocate memory of sizeof(size_t) for the length
-    else if constexpr (std::is_same<T, std::string>::value ||
-                       std::is_same<T, std::vector<typename T::value_type>>::value)
+    else if constexpr (datapacker::internal::is_string<T>::value ||
+                       datapacker::internal::is_vector<T>::value)
     {
-        buffer.resize(sizeof(size_t));
-        is.read(reinterpret_cast<char *>(buffer.data()), buffer.size());
-        if (!is)
+        constexpr size_t element_size = sizeof(typename T::value_type);
+        size_t sz = 0;
+        if (!internal::read_length<endianness, Prefix>(is, max_elements, sz))
             return is;
+        if (sz > static_cast<size_t>(std::numeric_limits<std::streamoff>::max()) / element_size)
+        {
+            throw std::runtime_error("Sequence size could not be determined");
+        }
+        return internal::skip_bytes(is, sz * element_size);
+    }
+    else if constexpr (bytes::has_schema<T>)
+    {
+        return internal::skip_bytes(is, bytes::packed_size<T>);
+    }
+    else
+    {
+        static_assert(datapacker::internal::False<T>{},
+                      "Invalid type passed to skip, can only skip integers, real "
+                      "numbers, vectors, strings and records");
+    }
+}
+
+/**
+ * @brief Reads a length-prefixed sequence in chunks, without storing the whole sequence
+ *
+ * The elements are decoded into a fixed size stack buffer of `STREAM_CHUNK_SIZE` bytes, and
+ * `callback` is called with a `std::span<const T>` of every chunk, in order. Memory usage does not
+ * depend on the length of the sequence, so it can decode sequences which do not fit in memory.
+ *
+ * @code
+ * double sum = 0;
+ * stream::read_chunked<endian::little, double>(is, [&](std::span<const double> values) {
+ *     for (double v : values)
+ *         sum += v;
+ * });
+ * @endcode
+ *
+ * @tparam endianness The endianness of the data in the stream
+ * @tparam T The type of the elements of the sequence, `char` for strings
+ * @tparam Prefix Type of the length prefix of the sequence, see `bytes::length_prefix`
+ * @param is Stream to read from
+ * @param callback Called with each chunk of decoded elements
+ * @param max_elements Maximum number of elements in the sequence, a `std::runtime_error` is thrown
+ * if the stream contains more elements
+ * @return The number of elements in the sequence, the stream is in a failed state if it ended
+ * before all of them were read
+ */
+template <endian endianness, typename T, typename Prefix = size_t, typename Callback>
+inline size_t read_chunked(std::istream &is, Callback &&callback,
+                           size_t max_elements = std::numeric_limits<size_t>::max())
+{
+    static_assert(datapacker::internal::is_fixed_width<T> && sizeof(T) <= STREAM_CHUNK_SIZE,
+                  "read_chunked can only decode sequences of integers and real numbers");
+    size_t sz = 0;
+    [[maybe_unused]] auto probe =
+        stats::internal::measure_read<endianness, Prefix, std::span<const T>>(is, sz);
+    if (!internal::read_length<endianness, Prefix>(is, max_elements, sz))
+        return 0;
+    constexpr size_t per_chunk = STREAM_CHUNK_SIZE / sizeof(T);
+    T elements[per_chunk];
+    for (size_t i = 0; i < sz; i += per_chunk)
+    {
+        size_t count = per_chunk < sz - i ? per_chunk : sz - i;
+        if constexpr (internal::is_stream_copyable<endianness, T> ||
+                      internal::is_stream_swappable<endianness, T>)
+        {
+            is.read(reinterpret_cast<char *>(elements),
+                    static_cast<std::streamsize>(count * sizeof(T)));
+            if (!is)
+                break;
+            if constexpr (!internal::is_stream_copyable<endianness, T>)
+            {
+                auto data = reinterpret_cast<uint8_t *>(elements);
+                datapacker::internal::copy_swapped<sizeof(T)>(data, data, count);
+            }
+        }
+        else
+        {
+            uint8_t chunk[STREAM_CHUNK_SIZE];
+            is.read(reinterpret_cast<char *>(chunk),
+                    static_cast<std::streamsize>(count * sizeof(T)));
+            if (!is)
+                break;
+            bytes::decode_array<endianness>(chunk, elements, count);
+        }
+        callback(std::span<const T>(elements, count));
+    }
+    return sz;
+}
+
+namespace internal
+{
+/**
+ * Destination of a `buffered_writer` or source of a `buffered_reader`, which is one of a stream,
+ * a `FILE *`, a file descriptor or a function
+ */
+struct endpoint
+{
+    std::ostream *os = nullptr;
+    std::istream *is = nullptr;
+    FILE *file = nullptr;
+    int fd = -1;
+    std::function<bool(const uint8_t *, size_t)> sink;
+    std::function<size_t(uint8_t *, size_t)> source;
+
+    // Writes all `n` bytes, returns false on failure
+    bool write(const uint8_t *data, size_t n)
+    {
+        if (sink)
+            return sink(data, n);
+        if (os)
+            return static_cast<bool>(
+                os->write(reinterpret_cast<const char *>(data), static_cast<std::streamsize>(n)));
+        if (file)
+            return fwrite(data, 1, n, file) == n;
+        while (n > 0)
+        {
+#if defined(_WIN32)
+            size_t chunk = n < MAX_IO_SIZE ? n : MAX_IO_SIZE;
+            int count = _write(fd, data, static_cast<unsigned int>(chunk));
+#else
+            ssize_t count = ::write(fd, data, n);
+#endif
+            if (count < 0 && errno == EINTR)
+                continue;
+            if (count <= 0)
+                return false;
+            data += count;
+            n -= static_cast<size_t>(count);
+        }
+        return true;
+    }
+
+    // Reads upto `n` bytes, returns the number of bytes read, which is 0 only at the end of the
+    // input or on failure. A file descriptor may return fewer bytes, for example from a pipe
+    size_t read(uint8_t *data, size_t n)
+    {
+        if (source)
+            return source(data, n);
+        if (is)
+        {
+            is->read(reinterpret_cast<char *>(data), static_cast<std::streamsize>(n));
+            return static_cast<size_t>(is->gcount());
+        }
+        if (file)
+            return fread(data, 1, n, file);
+        while (true)
+        {
+#if defined(_WIN32)
+            size_t chunk = n < MAX_IO_SIZE ? n : MAX_IO_SIZE;
+            int count = _read(fd, data, static_cast<unsigned int>(chunk));
+#else
+            ssize_t count = ::read(fd, data, n);
+#endif
+            if (count < 0 && errno == EINTR)
+                continue;
+            return count < 0 ? 0 : static_cast<size_t>(count);
+        }
+    }
+
+  private:
+#if defined(_WIN32)
+    static constexpr size_t MAX_IO_SIZE = static_cast<size_t>(std::numeric_limits<int>::max());
+#endif
+};
+} // namespace internal
+
+/**
+ * @brief Collects encoded values in a block of memory, and writes the block to an `ostream`, a
+ * `FILE *` or a file descriptor only when it is full, or when `flush` is called.
+ *
+ * Values are encoded the same way as `write`, so a `buffered_reader` or `read` can decode them.
+ * Writing many small values is much faster than calling `write` for each of them, since every
+ * call to `ostream::write` goes through the stream sentry and virtual `streambuf` calls.
+ *
+ * A `std::runtime_error` is thrown if the destination cannot be written to. The remaining data is
+ * flushed when the writer is destroyed, errors during that flush are ignored, so call `flush`
+ * before the writer goes out of scope to detect them.
+ *
+ * @code
+ * stream::buffered_writer w(stdout);
+ * for (auto &entry : entries)
+ *     w.write<endian::little>(entry.time, entry.level, entry.message);
+ * w.flush();
+ * @endcode
+ */
+class buffered_writer
+{
+  public:
+    explicit buffered_writer(std::ostream &os, size_t block_size = BUFFERED_BLOCK_SIZE)
+        : buffer(block_size < MIN_SIZE ? MIN_SIZE : block_size)
+    {
+        out.os = &os;
+    }
+
+    explicit buffered_writer(FILE *file, size_t block_size = BUFFERED_BLOCK_SIZE)
+        : buffer(block_size < MIN_SIZE ? MIN_SIZE : block_size)
+    {
+        out.file = file;
+    }
+
+    // The descriptor is not closed by the writer
+    explicit buffered_writer(int fd, size_t block_size = BUFFERED_BLOCK_SIZE)
+        : buffer(block_size < MIN_SIZE ? MIN_SIZE : block_size)
+    {
+        out.fd = fd;
+    }
+
+    /**
+     * @brief Writes each block by calling `sink(data, n)`, which should write all `n` bytes and
+     * return false on failure. Used to add a stage such as compression before the destination.
+     */
+    explicit buffered_writer(std::function<bool(const uint8_t *, size_t)> sink,
+                             size_t block_size = BUFFERED_BLOCK_SIZE)
+        : buffer(block_size < MIN_SIZE ? MIN_SIZE : block_size)
+    {
+        out.sink = std::move(sink);
+    }
+
+    buffered_writer(const buffered_writer &) = delete;
+    buffered_writer &operator=(const buffered_writer &) = delete;
+
+    ~buffered_writer()
+    {
+        try
+        {
+            flush();
+        }
+        catch (const std::runtime_error &)
+        {
+        }
+    }
+
+    /**
+     * @brief Encodes a value with specified endianness, see `stream::write` for the types which
+     * are supported
+     * @tparam endianness The endianness to use for encoding
+     * @tparam Prefix Type of the length prefix of sequences, see `bytes::length_prefix`
+     */
+    template <endian endianness, typename Prefix = size_t, typename T>
+    buffered_writer &write(const T &value)
+    {
+        using V = std::decay_t<T>;
+        [[maybe_unused]] auto probe =
+            stats::internal::measure_write<endianness, Prefix, V>(*this, value);
+        if constexpr (std::is_integral<V>::value || std::is_floating_point<V>::value)
+        {
+            bytes::encode<endianness>(reserve(sizeof(V)), value);
+        }
+        else if constexpr (std::is_same<V, const char *>::value || std::is_same<V, char *>::value)
+        {
+            const char *str = value;
+            write_sequence<endianness, Prefix>(str, strlen(str));
+        }
+        else if constexpr (datapacker::internal::is_string<T>::value ||
+                           datapacker::internal::is_vector<T>::value)
+        {
+            write_sequence<endianness, Prefix>(value.data(), value.size());
+        }
+        else if constexpr (bytes::has_schema<V>)
+        {
+            uint8_t record[bytes::packed_size<V>];
+            bytes::encode_record(record, value);
+            write_bytes(record, sizeof(record));
+        }
+        else
+        {
+            static_assert(datapacker::internal::False<T>{},
+                          "Invalid type passed to write, can only encode integers, real "
+                          "numbers, vectors, strings and records");
+        }
+        return *this;
+    }
+
+    /**
+     * @brief Encodes multiple values with specified endianness, one after the other
+     */
+    template <endian endianness, typename T, typename U, typename... Args>
+    buffered_writer &write(const T &value, const U &next, const Args &...args)
+    {
+        write<endianness>(value);
+        write<endianness>(next);
+        (write<endianness>(args), ...);
+        return *this;
+    }
+
+    /**
+     * @brief Writes `n` bytes as is
+     */
+    buffered_writer &write_bytes(const void *data, size_t n)
+    {
+        auto src = static_cast<const uint8_t *>(data);
+        if (n > buffer.size() - used)
+        {
+            flush();
+            // Large blocks are written directly
+            if (n >= buffer.size())
+            {
+                emit(src, n);
+                return *this;
+            }
+        }
+        memcpy(buffer.data() + used, src, n);
+        used += n;
+        return *this;
+    }
+
+    /**
+     * @brief Writes all the data in the block to the destination. Streams and files are not
+     * flushed, only the block of the writer is.
+     */
+    void flush()
+    {
+        if (used == 0)
+            return;
+        size_t n = used;
+        used = 0;
+        emit(buffer.data(), n);
+    }
+
+    /**
+     * @brief Sets a function which is called with every block of data, right before the block is
+     * written to the destination, for example to compute a checksum of the output while the block
+     * is still in the cache. Pass an empty function to remove it.
+     *
+     * @code
+     * crc32c crc;
+     * w.observe([&crc](const uint8_t *data, size_t n) { crc.update(data, n); });
+     * @endcode
+     */
+    void observe(std::function<void(const uint8_t *, size_t)> callback)
+    {
+        observer = std::move(callback);
+    }
+
+    /**
+     * @brief Number of bytes waiting in the block
+     */
+    size_t buffered() const
+    {
+        return used;
+    }
+
+  private:
+    // Large enough to hold any length prefix and a scalar value
+    static constexpr size_t MIN_SIZE = 16;
+    internal::endpoint out;
+    std::vector<uint8_t> buffer;
+    size_t used = 0;
+    std::function<void(const uint8_t *, size_t)> observer;
+
+    void emit(const uint8_t *data, size_t n)
+    {
+        if (observer)
+            observer(data, n);
+        if (!out.write(data, n))
+            throw std::runtime_error("Could not write to the destination");
+    }
+
+    // Returns a pointer to `n` bytes in the block, `n` should be atmost MIN_SIZE
+    uint8_t *reserve(size_t n)
+    {
+        if (n > buffer.size() - used)
+            flush();
+        uint8_t *p = buffer.data() + used;
+        used += n;
+        return p;
+    }
+
+    template <endian endianness, typename Prefix, typename T>
+    void write_sequence(const T *arr, size_t n)
+    {
+        using prefix = bytes::length_prefix<Prefix>;
+        if (n > prefix::max_length)
+        {
+            throw std::runtime_error("Sequence is too long for its length prefix, write failed");
+        }
+        uint8_t *p = reserve(prefix::size(n));
+        prefix::template encode<endianness>(p, n);
+        if constexpr (internal::is_stream_copyable<endianness, T>)
+        {
+            write_bytes(arr, n * sizeof(T));
+        }
+        else
+        {
+            size_t i = 0;
+            while (i < n)
+            {
+                size_t count = (buffer.size() - used) / sizeof(T);
+                if (count == 0)
+                {
+                    flush();
+                    continue;
+                }
+                if (count > n - i)
+                    count = n - i;
+                used += static_cast<size_t>(
+                    bytes::encode_array<endianness>(buffer.data() + used, arr + i, count));
+                i += count;
+            }
+        }
+    }
+};
+
+/**
+ * @brief Reads an `istream`, a `FILE *` or a file descriptor in large blocks, and decodes values
+ * from the block. Decodes data written by `buffered_writer` or `write`.
+ *
+ * If the input ends before a value could be read, the reader enters a failed state and further
+ * reads do nothing. Like `read`, a `std::runtime_error` is thrown if a length prefix is invalid or
+ * if a sequence has more than `max_elements` elements.
+ * @note Since the input is read ahead, data after the last decoded value may have been consumed
+ * from the source
+ */
+class buffered_reader
+{
+  public:
+    explicit buffered_reader(std::istream &is, size_t block_size = BUFFERED_BLOCK_SIZE)
+        : buffer(block_size < MIN_SIZE ? MIN_SIZE : block_size)
+    {
+        in.is = &is;
+    }
+
+    explicit buffered_reader(FILE *file, size_t block_size = BUFFERED_BLOCK_SIZE)
+        : buffer(block_size < MIN_SIZE ? MIN_SIZE : block_size)
+    {
+        in.file = file;
+    }
+
+    // The descriptor is not closed by the reader
+    explicit buffered_reader(int fd, size_t block_size = BUFFERED_BLOCK_SIZE)
+        : buffer(block_size < MIN_SIZE ? MIN_SIZE : block_size)
+    {
+        in.fd = fd;
+    }
+
+    /**
+     * @brief Reads the input by calling `source(data, n)`, which should store upto `n` bytes in
+     * `data` and return the number of bytes stored, or 0 at the end of the input
+     */
+    explicit buffered_reader(std::function<size_t(uint8_t *, size_t)> source,
+                             size_t block_size = BUFFERED_BLOCK_SIZE)
+        : buffer(block_size < MIN_SIZE ? MIN_SIZE : block_size)
+    {
+        in.source = std::move(source);
+    }
+
+    buffered_reader(const buffered_reader &) = delete;
+    buffered_reader &operator=(const buffered_reader &) = delete;
+
+    /**
+     * @brief Decodes a value with specified endianness, see `stream::read` for the types which are
+     * supported
+     * @param value Where the value read will be stored
+     * @param max_elements Maximum number of elements in a string or vector
+     * @note If the read fails, the contents of `value` are unspecified
+     */
+    template <endian endianness, typename Prefix = size_t, typename T>
+    buffered_reader &read(T &value, size_t max_elements = DEFAULT_MAX_NUMBER_OF_ELEMENTS)
+    {
+        [[maybe_unused]] auto probe =
+            stats::internal::measure_read<endianness, Prefix, T>(*this, value);
+        if constexpr (std::is_integral<T>::value || std::is_floating_point<T>::value)
+        {
+            if (fill(sizeof(T)) >= sizeof(T))
+            {
+                bytes::decode<endianness>(buffer.data() + begin, value);
+                begin += sizeof(T);
+            }
+            else
+            {
+                failed = true;
+            }
+        }
+        else if constexpr (datapacker::internal::is_string<T>::value ||
+                           datapacker::internal::is_vector<T>::value)
+        {
+            read_sequence<endianness, Prefix>(value, max_elements);
+        }
+        else if constexpr (bytes::has_schema<T>)
+        {
+            uint8_t record[bytes::packed_size<T>];
+            if (read_bytes(record, sizeof(record)))
+                bytes::decode_record(record, value);
+        }
+        else
+        {
+            static_assert(datapacker::internal::False<T>{},
+                          "Invalid type passed to read, can only decode integers, real "
+                          "numbers, vectors, strings and records");
+        }
+        return *this;
+    }
+
+    /**
+     * @brief Reads a length-prefixed sequence in chunks of atmost `STREAM_CHUNK_SIZE` bytes, see
+     * `stream::read_chunked`. The elements are decoded directly from the block.
+     * @return The number of elements in the sequence, the reader is in a failed state if the input
+     * ended before all of them were read
+     */
+    template <endian endianness, typename T, typename Prefix = size_t, typename Callback>
+    size_t read_chunked(Callback &&callback,
+                        size_t max_elements = std::numeric_limits<size_t>::max())
+    {
+        static_assert(datapacker::internal::is_fixed_width<T> && sizeof(T) <= MIN_SIZE,
+                      "read_chunked can only decode sequences of integers and real numbers");
         size_t sz = 0;
-        if (bytes::decode<endianness>(buffer.data(), sz) != sizeof(size_t))
+        [[maybe_unused]] auto probe =
+            stats::internal::measure_read<endianness, Prefix, std::span<const T>>(*this, sz);
+        if (!read_length<endianness, Prefix>(max_elements, sz))
+            return 0;
+        constexpr size_t per_chunk = STREAM_CHUNK_SIZE / sizeof(T);
+        T elements[per_chunk];
+        size_t i = 0;
+        while (i < sz)
+        {
+            size_t count = fill(sizeof(T)) / sizeof(T);
+            if (count == 0)
+            {
+                failed = true;
+                break;
+            }
+            if (count > sz - i)
+                count = sz - i;
+            if (count > per_chunk)
+                count = per_chunk;
+            bytes::decode_array<endianness>(buffer.data() + begin, elements, count);
+            begin += count * sizeof(T);
+            i += count;
+            callback(std::span<const T>(elements, count));
+        }
+        return sz;
+    }
+
+    /**
+     * @brief Reads `n` bytes as is, returns false and sets the failed state if the input ended
+     */
+    bool read_bytes(void *data, size_t n)
+    {
+        if (failed)
+            return false;
+        auto dst = static_cast<uint8_t *>(data);
+        size_t count = end - begin < n ? end - begin : n;
+        memcpy(dst, buffer.data() + begin, count);
+        begin += count;
+        if (count < n)
+        {
+            // Large reads go directly to the destination
+            if (n - count >= buffer.size())
+            {
+                while (count < n)
+                {
+                    size_t read_count = in.read(dst + count, n - count);
+                    if (read_count == 0)
+                    {
+                        failed = true;
+                        break;
+                    }
+                    count += read_count;
+                }
+            }
+            else if (fill(n - count) >= n - count)
+            {
+                memcpy(dst + count, buffer.data() + begin, n - count);
+                begin += n - count;
+            }
+            else
+            {
+                failed = true;
+            }
+        }
+        return !failed;
+    }
+
+    bool good() const
+    {
+        return !failed;
+    }
+
+    explicit operator bool() const
+    {
+        return !failed;
+    }
+
+  private:
+    // Large enough to hold any length prefix and a scalar value
+    static constexpr size_t MIN_SIZE = 16;
+    internal::endpoint in;
+    std::vector<uint8_t> buffer;
+    size_t begin = 0;
+    size_t end = 0;
+    bool failed = false;
+
+    // Reads from the source until atleast `n` bytes are in the block or the input ends, and
+    // returns the number of bytes in the block. `n` should not be larger than the block
+    size_t fill(size_t n)
+    {
+        if (failed)
+            return 0;
+        if (end - begin < n)
+        {
+            memmove(buffer.data(), buffer.data() + begin, end - begin);
+            end -= begin;
+            begin = 0;
+            while (end < n)
+            {
+                size_t count = in.read(buffer.data() + end, buffer.size() - end);
+                if (count == 0)
+                    break;
+                end += count;
+            }
+        }
+        return end - begin;
+    }
+
+    // Reads the length prefix of a sequence, returns false and sets the failed state if the input
+    // ended. Throws if the prefix is invalid or the length is more than `max_elements`
+    template <endian endianness, typename Prefix> bool read_length(size_t max_elements, size_t &sz)
+    {
+        using prefix = bytes::length_prefix<Prefix>;
+        size_t available = fill(prefix::max_size);
+        if (available == 0)
+        {
+            failed = true;
+            return false;
+        }
+        int n = prefix::template decode<endianness>(buffer.data() + begin, available, sz);
+        if (n == -1)
         {
-            // Throw error
+            // The input ended in the middle of the prefix
+            if (available < prefix::max_size)
+            {
+                failed = true;
+                return false;
+            }
             throw std::runtime_error("Sequence size could not be determined");
         }
         if (sz > max_elements)
         {
+            stats::internal::rejected(sz);
             throw std::runtime_error("Data contains more elements than max_elements, read failed");
         }
-        buffer.resize(sz * sizeof(typename T::value_type) + sizeof(size_t));
-        is.read(reinterpret_cast<char *>(buffer.data() + sizeof(size_t)),
-                buffer.size() - sizeof(size_t));
-        if (!is)
-            return is;
-
-        bytes::decode_length_prefixed<endianness>(buffer.data(), value, max_elements);
+        begin += static_cast<size_t>(n);
+        return true;
     }
-    else
+
+    template <endian endianness, typename Prefix, typename T>
+    void read_sequence(T &value, size_t max_elements)
     {
-        static_assert(internal::False<T>{},
-                      "Invalid type passed to read, can only decode integers, real "
-                      "numbers, vectors, and strings");
+        using V = typename T::value_type;
+        size_t sz = 0;
+        if (!read_length<endianness, Prefix>(max_elements, sz))
+            return;
+        value.resize(sz);
+        if constexpr (internal::is_stream_copyable<endianness, V> ||
+                      internal::is_stream_swappable<endianness, V>)
+        {
+            if (read_bytes(value.data(), sz * sizeof(V)))
+            {
+                if constexpr (!internal::is_stream_copyable<endianness, V>)
+                {
+                    auto data = reinterpret_cast<uint8_t *>(value.data());
+                    datapacker::internal::copy_swapped<sizeof(V)>(data, data, sz);
+                }
+            }
+        }
+        else
+        {
+            size_t i = 0;
+            while (i < sz)
+            {
+                size_t count = fill(sizeof(V)) / sizeof(V);
+                if (count == 0)
+                {
+                    failed = true;
+                    return;
+                }
+                if (count > sz - i)
+                    count = sz - i;
+                bytes::decode_array<endianness>(buffer.data() + begin, value.data() + i, count);
+                begin += count * sizeof(V);
+                i += count;
+            }
+        }
     }
-    return is;
-}
-
+};
 
 } // namespace stream
 
 namespace internal
 {
 // Code taken from https://beej.us/guide/bgnet/source/examples/ieee754.c
-// Does not support NaN and infinity
+// Does not support NaN and infinity, only used when the host does not have IEEE754 floats or if
+// DATAPACKER_PORTABLE_FLOAT is set
 
 /**
  * This function packs a double as an unsigned 64 bit integer, which can be written to a buffer
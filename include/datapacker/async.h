@@ -0,0 +1,343 @@
+/**
+ * @file async.h
+ * @brief Coroutine based reading and writing of values over non blocking sources and sinks
+ *
+ * `async_read` and `async_write` are `co_await`-able, and suspend whenever the underlying source
+ * or sink is not ready, so that a single reactor thread can serve many connections. They are not
+ * tied to a particular event loop, a source or sink only has to satisfy `async_source` or
+ * `async_sink`, whose `readable()` / `writable()` awaitables are resumed by the reactor.
+ */
+#ifndef A_DATAPACKER_ASYNC_H
+#define A_DATAPACKER_ASYNC_H
+#include "../datapacker.h"
+#include "decoder.h"
+#include <concepts>
+#include <coroutine>
+#include <exception>
+#include <optional>
+
+namespace datapacker
+{
+
+/**
+ * @brief A non blocking byte source. `read_some(data, n)` reads upto `n` bytes and returns the
+ * number of bytes read, 0 at the end of the input, or -1 if no data is available yet (`EAGAIN`).
+ * `readable()` returns an awaitable which completes when data may be available.
+ */
+template <typename S>
+concept async_source = requires(S &source, uint8_t *data, size_t n) {
+    { source.read_some(data, n) } -> std::convertible_to<ptrdiff_t>;
+    source.readable();
+};
+
+/**
+ * @brief A non blocking byte sink. `write_some(data, n)` writes upto `n` bytes and returns the
+ * number of bytes written, or -1 if the sink cannot accept data yet (`EAGAIN`). `writable()`
+ * returns an awaitable which completes when the sink may accept data.
+ */
+template <typename S>
+concept async_sink = requires(S &sink, const uint8_t *data, size_t n) {
+    { sink.write_some(data, n) } -> std::convertible_to<ptrdiff_t>;
+    sink.writable();
+};
+
+/**
+ * @brief A lazily started coroutine which produces a value of type `T`
+ *
+ * A task starts running when it is awaited, and resumes the awaiting coroutine when it
+ * completes. Exceptions thrown in the task are rethrown by `co_await`. A top level task, which is
+ * not awaited by another coroutine, is started with `start()`, and its result is available with
+ * `result()` once `done()` is true.
+ */
+template <typename T = void> class task
+{
+  public:
+    struct promise_type;
+    using handle_type = std::coroutine_handle<promise_type>;
+
+    struct final_awaiter
+    {
+        bool await_ready() const noexcept
+        {
+            return false;
+        }
+
+        std::coroutine_handle<> await_suspend(handle_type h) const noexcept
+        {
+            auto continuation = h.promise().continuation;
+            return continuation ? continuation : std::noop_coroutine();
+        }
+
+        void await_resume() const noexcept
+        {
+        }
+    };
+
+    struct promise_base
+    {
+        std::coroutine_handle<> continuation;
+        std::exception_ptr error;
+
+        std::suspend_always initial_suspend() const noexcept
+        {
+            return {};
+        }
+
+        final_awaiter final_suspend() const noexcept
+        {
+            return {};
+        }
+
+        void unhandled_exception() noexcept
+        {
+            error = std::current_exception();
+        }
+    };
+
+    struct value_promise : promise_base
+    {
+        std::optional<T> value;
+
+        template <typename U> void return_value(U &&v)
+        {
+            value.emplace(std::forward<U>(v));
+        }
+    };
+
+    struct void_promise : promise_base
+    {
+        void return_void() const noexcept
+        {
+        }
+    };
+
+    struct promise_type : std::conditional_t<std::is_void_v<T>, void_promise, value_promise>
+    {
+        task get_return_object()
+        {
+            return task(handle_type::from_promise(*this));
+        }
+    };
+
+    task(task &&other) noexcept : handle(std::exchange(other.handle, nullptr))
+    {
+    }
+
+    task &operator=(task &&other) noexcept
+    {
+        if (this != &other)
+        {
+            if (handle)
+                handle.destroy();
+            handle = std::exchange(other.handle, nullptr);
+        }
+        return *this;
+    }
+
+    task(const task &) = delete;
+    task &operator=(const task &) = delete;
+
+    ~task()
+    {
+        if (handle)
+            handle.destroy();
+    }
+
+    bool await_ready() const noexcept
+    {
+        return false;
+    }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> continuation) noexcept
+    {
+        handle.promise().continuation = continuation;
+        return handle;
+    }
+
+    T await_resume()
+    {
+        return result();
+    }
+
+    /**
+     * @brief Starts a top level task, it runs until it first suspends
+     */
+    void start()
+    {
+        handle.resume();
+    }
+
+    bool done() const
+    {
+        return handle.done();
+    }
+
+    /**
+     * @brief Result of a completed task, rethrows the exception thrown by it
+     */
+    T result()
+    {
+        if (handle.promise().error)
+            std::rethrow_exception(handle.promise().error);
+        if constexpr (!std::is_void_v<T>)
+            return std::move(*handle.promise().value);
+    }
+
+  private:
+    handle_type handle;
+
+    explicit task(handle_type h) : handle(h)
+    {
+    }
+};
+
+/**
+ * @brief Writes `n` bytes to the sink, suspending while it is not ready
+ * @note A `std::runtime_error` is thrown if the sink accepts no bytes
+ */
+template <async_sink Sink>
+inline task<> async_write_bytes(Sink &sink, const uint8_t *data, size_t n)
+{
+    while (n > 0)
+    {
+        ptrdiff_t count = sink.write_some(data, n);
+        if (count < 0)
+        {
+            co_await sink.writable();
+            continue;
+        }
+        if (count == 0)
+            throw std::runtime_error("Could not write to the sink");
+        data += count;
+        n -= static_cast<size_t>(count);
+    }
+}
+
+/**
+ * @brief Writes a value to the sink with specified endianness, in the same format as
+ * `stream::write`
+ *
+ * Integers, real numbers and records are encoded into a buffer which is written at once.
+ * Sequences which need no conversion are written directly from `value`, others are encoded in
+ * chunks of `STREAM_CHUNK_SIZE` bytes.
+ *
+ * @tparam endianness The endianness to use for encoding
+ * @tparam Prefix Type of the length prefix of sequences, see `bytes::length_prefix`
+ * @param sink Sink to write to
+ * @param value Value to be written, it should not be modified until the task completes
+ */
+template <endian endianness, typename Prefix = size_t, async_sink Sink, typename T>
+inline task<> async_write(Sink &sink, const T &value)
+{
+    if constexpr (internal::is_fixed_width<T>)
+    {
+        uint8_t buffer[sizeof(T)];
+        bytes::encode<endianness>(buffer, value);
+        co_await async_write_bytes(sink, buffer, sizeof(buffer));
+    }
+    else if constexpr (bytes::has_schema<T>)
+    {
+        uint8_t buffer[bytes::packed_size<T>];
+        bytes::encode_record(buffer, value);
+        co_await async_write_bytes(sink, buffer, sizeof(buffer));
+    }
+    else if constexpr (internal::is_string<T>::value || internal::is_vector<T>::value)
+    {
+        using V = typename T::value_type;
+        using prefix = bytes::length_prefix<Prefix>;
+        if (value.size() > prefix::max_length)
+        {
+            throw std::runtime_error("Sequence is too long for its length prefix, write failed");
+        }
+        uint8_t chunk[STREAM_CHUNK_SIZE];
+        size_t used =
+            static_cast<size_t>(prefix::template encode<endianness>(chunk, value.size()));
+        if constexpr (stream::internal::is_stream_copyable<endianness, V>)
+        {
+            co_await async_write_bytes(sink, chunk, used);
+            co_await async_write_bytes(sink, reinterpret_cast<const uint8_t *>(value.data()),
+                                       value.size() * sizeof(V));
+        }
+        else
+        {
+            size_t i = 0;
+            while (true)
+            {
+                size_t count = (sizeof(chunk) - used) / sizeof(V);
+                if (count > value.size() - i)
+                    count = value.size() - i;
+                used += static_cast<size_t>(
+                    bytes::encode_array<endianness>(chunk + used, value.data() + i, count));
+                i += count;
+                co_await async_write_bytes(sink, chunk, used);
+                if (i == value.size())
+                    break;
+                used = 0;
+            }
+        }
+    }
+    else
+    {
+        static_assert(internal::False<T>{},
+                      "Invalid type passed to async_write, can only encode integers, real "
+                      "numbers, vectors, strings and records");
+    }
+}
+
+/**
+ * @brief Writes multiple values to the sink with specified endianness, one after the other
+ */
+template <endian endianness, async_sink Sink, typename T, typename U, typename... Args>
+inline task<> async_write(Sink &sink, const T &value, const U &next, const Args &...args)
+{
+    co_await async_write<endianness>(sink, value);
+    co_await async_write<endianness>(sink, next);
+    (co_await async_write<endianness>(sink, args), ...);
+}
+
+/**
+ * @brief Reads a value from the source with specified endianness, which was written by
+ * `stream::write` or `async_write`
+ *
+ * The value is decoded with a `bytes::incremental_decoder` as bytes arrive. Only the bytes of the
+ * value are read from the source, so the data after it is left for the next read. Wrap sources
+ * which are expensive to read in small pieces in a buffer.
+ *
+ * @tparam endianness The endianness of the data
+ * @tparam Prefix Type of the length prefix of sequences, see `bytes::length_prefix`
+ * @param source Source to read from
+ * @param value Where the value read will be stored
+ * @param max_elements Maximum number of elements in a string or vector, a `std::runtime_error` is
+ * thrown if the data contains more, or if a length prefix is invalid
+ * @return A task which produces true if the value was read, or false if the input ended before it
+ */
+template <endian endianness, typename Prefix = size_t, async_source Source, typename T>
+inline task<bool> async_read(Source &source, T &value,
+                             size_t max_elements = DEFAULT_MAX_NUMBER_OF_ELEMENTS)
+{
+    bytes::incremental_decoder decoder;
+    decoder.expect<endianness, Prefix>(value, max_elements);
+    uint8_t chunk[STREAM_CHUNK_SIZE];
+    while (true)
+    {
+        size_t wanted = decoder.bytes_wanted();
+        if (wanted == 0)
+            break;
+        ptrdiff_t count = source.read_some(chunk, wanted < sizeof(chunk) ? wanted : sizeof(chunk));
+        if (count < 0)
+        {
+            co_await source.readable();
+            continue;
+        }
+        if (count == 0)
+            co_return false;
+        if (decoder.feed(chunk, static_cast<size_t>(count)) == bytes::decode_status::error)
+        {
+            throw std::runtime_error("Invalid length prefix, or more than max_elements elements");
+        }
+    }
+    co_return true;
+}
+
+} // namespace datapacker
+#endif // A_DATAPACKER_ASYNC_H
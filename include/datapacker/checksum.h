@@ -0,0 +1,523 @@
+/**
+ * @file checksum.h
+ * @brief CRC32C and xxHash64 checksums, and adapters which compute them while encoding/decoding
+ *
+ * `checksum_writer` and `checksum_reader` wrap a `bytes::writer` or `bytes::reader`, and add the
+ * bytes of each value to the checksum right after the value is written or decoded, while they are
+ * still in the L1 cache, instead of making a second pass over the frame.
+ * `stream::buffered_writer::observe` can be used in the same way with a stream.
+ *
+ * CRC32C uses the SSE4.2 `crc32` instruction or the ARMv8 CRC32 extension, and a slice-by-8 table
+ * on cpus without them. With GCC and Clang the instructions are selected at runtime on x86 and on
+ * 64 bit ARM Linux, with other compilers they are used when the target supports them (for example
+ * with `-march=armv8-a+crc`).
+ */
+#ifndef A_DATAPACKER_CHECKSUM_H
+#define A_DATAPACKER_CHECKSUM_H
+#include "../datapacker.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define DATAPACKER_CRC32C_SSE42 1
+#define DATAPACKER_CRC32C_DISPATCH 1
+#define DATAPACKER_CRC32C_TARGET __attribute__((target("sse4.2")))
+#elif defined(__SSE4_2__)
+#define DATAPACKER_CRC32C_SSE42 1
+#define DATAPACKER_CRC32C_DISPATCH 0
+#define DATAPACKER_CRC32C_TARGET
+#elif defined(__aarch64__) && defined(__linux__) && !defined(__ARM_FEATURE_CRC32) &&              \
+    (defined(__GNUC__) || defined(__clang__))
+#define DATAPACKER_CRC32C_ARM 1
+#define DATAPACKER_CRC32C_DISPATCH 1
+#if defined(__clang__)
+#define DATAPACKER_CRC32C_TARGET __attribute__((target("crc")))
+#else
+#define DATAPACKER_CRC32C_TARGET __attribute__((target("+crc")))
+#endif
+#elif defined(__ARM_FEATURE_CRC32)
+#define DATAPACKER_CRC32C_ARM 1
+#define DATAPACKER_CRC32C_DISPATCH 0
+#define DATAPACKER_CRC32C_TARGET
+#endif
+
+#if DATAPACKER_CRC32C_SSE42
+#include <nmmintrin.h>
+#elif DATAPACKER_CRC32C_ARM
+#include <arm_acle.h>
+#if DATAPACKER_CRC32C_DISPATCH
+#include <sys/auxv.h>
+#endif
+#endif
+
+namespace datapacker
+{
+namespace internal
+{
+inline uint32_t load_le32(const uint8_t *p)
+{
+    uint32_t value;
+    bytes::decode<endian::little>(p, value);
+    return value;
+}
+
+inline uint64_t load_le64(const uint8_t *p)
+{
+    uint64_t value;
+    bytes::decode<endian::little>(p, value);
+    return value;
+}
+
+// Tables for the slice-by-8 CRC32C, table[k][b] is the CRC of byte b followed by k zero bytes
+constexpr std::array<std::array<uint32_t, 256>, 8> make_crc32c_table()
+{
+    std::array<std::array<uint32_t, 256>, 8> table{};
+    for (uint32_t b = 0; b < 256; ++b)
+    {
+        uint32_t crc = b;
+        for (int i = 0; i < 8; ++i)
+            crc = (crc >> 1) ^ (0x82F63B78u & (0u - (crc & 1)));
+        table[0][b] = crc;
+    }
+    for (size_t k = 1; k < 8; ++k)
+    {
+        for (size_t b = 0; b < 256; ++b)
+            table[k][b] = (table[k - 1][b] >> 8) ^ table[0][table[k - 1][b] & 0xFF];
+    }
+    return table;
+}
+
+inline constexpr auto crc32c_table = make_crc32c_table();
+
+// Updates a CRC32C which has not been inverted, using the slice-by-8 tables
+inline uint32_t crc32c_update_table(uint32_t crc, const uint8_t *data, size_t n)
+{
+    const auto &t = crc32c_table;
+    for (; n >= 8; n -= 8, data += 8)
+    {
+        uint32_t low = load_le32(data) ^ crc;
+        uint32_t high = load_le32(data + 4);
+        crc = t[7][low & 0xFF] ^ t[6][(low >> 8) & 0xFF] ^ t[5][(low >> 16) & 0xFF] ^
+              t[4][low >> 24] ^ t[3][high & 0xFF] ^ t[2][(high >> 8) & 0xFF] ^
+              t[1][(high >> 16) & 0xFF] ^ t[0][high >> 24];
+    }
+    for (; n > 0; --n, ++data)
+        crc = (crc >> 8) ^ t[0][(crc ^ *data) & 0xFF];
+    return crc;
+}
+
+#if DATAPACKER_CRC32C_SSE42
+// Updates a CRC32C which has not been inverted, using the SSE4.2 crc32 instruction
+DATAPACKER_CRC32C_TARGET inline uint32_t crc32c_update_hw(uint32_t crc, const uint8_t *data,
+                                                           size_t n)
+{
+#if defined(__x86_64__) || defined(_M_X64)
+    uint64_t crc64 = crc;
+    for (; n >= 8; n -= 8, data += 8)
+        crc64 = _mm_crc32_u64(crc64, load_le64(data));
+    crc = static_cast<uint32_t>(crc64);
+#endif
+    for (; n >= 4; n -= 4, data += 4)
+        crc = _mm_crc32_u32(crc, load_le32(data));
+    for (; n > 0; --n, ++data)
+        crc = _mm_crc32_u8(crc, *data);
+    return crc;
+}
+#elif DATAPACKER_CRC32C_ARM
+// Updates a CRC32C which has not been inverted, using the ARMv8 CRC32 extension
+DATAPACKER_CRC32C_TARGET inline uint32_t crc32c_update_hw(uint32_t crc, const uint8_t *data,
+                                                           size_t n)
+{
+    for (; n >= 8; n -= 8, data += 8)
+        crc = __crc32cd(crc, load_le64(data));
+    for (; n > 0; --n, ++data)
+        crc = __crc32cb(crc, *data);
+    return crc;
+}
+#endif
+
+// True if crc32c_update_hw can be used on this cpu, detected once on the first call
+inline bool has_crc32c_instructions()
+{
+#if DATAPACKER_CRC32C_DISPATCH && DATAPACKER_CRC32C_SSE42
+    static const bool supported = [] {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("sse4.2") != 0;
+    }();
+    return supported;
+#elif DATAPACKER_CRC32C_DISPATCH && DATAPACKER_CRC32C_ARM
+    static const bool supported = (getauxval(AT_HWCAP) & HWCAP_CRC32) != 0;
+    return supported;
+#elif DATAPACKER_CRC32C_SSE42 || DATAPACKER_CRC32C_ARM
+    return true;
+#else
+    return false;
+#endif
+}
+
+// Updates a CRC32C which has not been inverted
+inline uint32_t crc32c_update(uint32_t crc, const uint8_t *data, size_t n)
+{
+#if DATAPACKER_CRC32C_SSE42 || DATAPACKER_CRC32C_ARM
+    if (has_crc32c_instructions())
+        return crc32c_update_hw(crc, data, n);
+#endif
+    return crc32c_update_table(crc, data, n);
+}
+} // namespace internal
+
+/**
+ * @brief Incremental CRC32C (Castagnoli) checksum, as used by iSCSI, ext4 and many file formats
+ */
+class crc32c
+{
+  public:
+    using value_type = uint32_t;
+
+    void update(const uint8_t *data, size_t n)
+    {
+        state = internal::crc32c_update(state, data, n);
+    }
+
+    /**
+     * @brief Checksum of all the bytes added since construction or the last reset
+     */
+    uint32_t value() const
+    {
+        return ~state;
+    }
+
+    void reset()
+    {
+        state = 0xFFFFFFFFu;
+    }
+
+  private:
+    uint32_t state = 0xFFFFFFFFu;
+};
+
+/**
+ * @brief Incremental 64 bit xxHash (XXH64), a fast non cryptographic hash
+ */
+class xxhash64
+{
+  public:
+    using value_type = uint64_t;
+
+    explicit xxhash64(uint64_t initial_seed = 0) : seed(initial_seed)
+    {
+        reset();
+    }
+
+    void update(const uint8_t *data, size_t n)
+    {
+        if (n == 0)
+            return;
+        total += n;
+        // Fill the partial stripe from the previous update first
+        if (buffered > 0)
+        {
+            size_t count = 32 - buffered < n ? 32 - buffered : n;
+            memcpy(buffer + buffered, data, count);
+            buffered += count;
+            data += count;
+            n -= count;
+            if (buffered < 32)
+                return;
+            consume(buffer);
+            buffered = 0;
+        }
+        for (; n >= 32; n -= 32, data += 32)
+            consume(data);
+        memcpy(buffer, data, n);
+        buffered = n;
+    }
+
+    /**
+     * @brief Hash of all the bytes added since construction or the last reset
+     */
+    uint64_t value() const
+    {
+        uint64_t h;
+        if (total >= 32)
+        {
+            h = std::rotl(v[0], 1) + std::rotl(v[1], 7) + std::rotl(v[2], 12) + std::rotl(v[3], 18);
+            for (uint64_t lane : v)
+                h = (h ^ round(0, lane)) * PRIME1 + PRIME4;
+        }
+        else
+        {
+            h = seed + PRIME5;
+        }
+        h += total;
+        const uint8_t *p = buffer;
+        size_t n = buffered;
+        for (; n >= 8; n -= 8, p += 8)
+            h = std::rotl(h ^ round(0, internal::load_le64(p)), 27) * PRIME1 + PRIME4;
+        if (n >= 4)
+        {
+            h = std::rotl(h ^ (internal::load_le32(p) * PRIME1), 23) * PRIME2 + PRIME3;
+            p += 4;
+            n -= 4;
+        }
+        for (; n > 0; --n, ++p)
+            h = std::rotl(h ^ (*p * PRIME5), 11) * PRIME1;
+        h ^= h >> 33;
+        h *= PRIME2;
+        h ^= h >> 29;
+        h *= PRIME3;
+        h ^= h >> 32;
+        return h;
+    }
+
+    void reset()
+    {
+        v[0] = seed + PRIME1 + PRIME2;
+        v[1] = seed + PRIME2;
+        v[2] = seed;
+        v[3] = seed - PRIME1;
+        total = 0;
+        buffered = 0;
+    }
+
+  private:
+    static constexpr uint64_t PRIME1 = 0x9E3779B185EBCA87ULL;
+    static constexpr uint64_t PRIME2 = 0xC2B2AE3D27D4EB4FULL;
+    static constexpr uint64_t PRIME3 = 0x165667B19E3779F9ULL;
+    static constexpr uint64_t PRIME4 = 0x85EBCA77C2B2AE63ULL;
+    static constexpr uint64_t PRIME5 = 0x27D4EB2F165667C5ULL;
+
+    uint64_t seed;
+    uint64_t v[4];
+    uint64_t total = 0;
+    // Bytes of a stripe of 32 bytes which is not complete yet
+    uint8_t buffer[32];
+    size_t buffered = 0;
+
+    static uint64_t round(uint64_t acc, uint64_t input)
+    {
+        return std::rotl(acc + input * PRIME2, 31) * PRIME1;
+    }
+
+    void consume(const uint8_t *stripe)
+    {
+        for (int i = 0; i < 4; ++i)
+            v[i] = round(v[i], internal::load_le64(stripe + 8 * i));
+    }
+};
+
+/**
+ * @brief Computes the checksum of `n` bytes in a single call, for example
+ * `checksum<crc32c>(data, n)`
+ */
+template <typename Checksum>
+inline typename Checksum::value_type checksum(const uint8_t *data, size_t n)
+{
+    Checksum c;
+    c.update(data, n);
+    return c.value();
+}
+
+/**
+ * @brief Wraps a `bytes::writer`, and adds every byte written through it to a checksum
+ *
+ * @code
+ * bytes::writer w(buffer, sizeof(buffer));
+ * checksum_writer<crc32c> cw(w);
+ * cw.put<endian::little>(id, timestamp).put_length_prefixed<endian::little>(payload);
+ * w.put<endian::little>(cw.value());
+ * @endcode
+ *
+ * Bytes written directly to the underlying writer are not part of the checksum.
+ */
+template <typename Checksum> class checksum_writer
+{
+  public:
+    explicit checksum_writer(bytes::writer &writer, Checksum initial = Checksum())
+        : w(writer), c(std::move(initial))
+    {
+    }
+
+    template <endian endianness, typename T, typename... Args>
+    checksum_writer &put(const T &value, const Args &...args)
+    {
+        size_t start = w.position();
+        w.put<endianness>(value, args...);
+        return track(start);
+    }
+
+    template <endian endianness, typename Prefix = size_t, typename... Args>
+    checksum_writer &put_length_prefixed(const Args &...args)
+    {
+        size_t start = w.position();
+        w.put_length_prefixed<endianness, Prefix>(args...);
+        return track(start);
+    }
+
+    template <typename T> checksum_writer &put_varint(T value)
+    {
+        size_t start = w.position();
+        w.put_varint(value);
+        return track(start);
+    }
+
+    template <typename S> checksum_writer &put_record(const S &s)
+    {
+        size_t start = w.position();
+        w.put_record(s);
+        return track(start);
+    }
+
+    checksum_writer &put_bytes(const void *data, size_t n)
+    {
+        size_t start = w.position();
+        w.put_bytes(data, n);
+        return track(start);
+    }
+
+    checksum_writer &pad(size_t n)
+    {
+        size_t start = w.position();
+        w.pad(n);
+        return track(start);
+    }
+
+    /**
+     * @brief Checksum of the bytes written so far
+     */
+    typename Checksum::value_type value() const
+    {
+        return c.value();
+    }
+
+    Checksum &checksum()
+    {
+        return c;
+    }
+
+    bool good() const
+    {
+        return w.good();
+    }
+
+    explicit operator bool() const
+    {
+        return w.good();
+    }
+
+  private:
+    bytes::writer &w;
+    Checksum c;
+
+    checksum_writer &track(size_t start)
+    {
+        c.update(w.data() + start, w.position() - start);
+        return *this;
+    }
+};
+
+/**
+ * @brief Wraps a `bytes::reader`, and adds every byte read through it to a checksum
+ *
+ * @code
+ * checksum_reader<crc32c> cr(r);
+ * cr.get<endian::little>(id, timestamp).get_length_prefixed<endian::little>(payload, 4096);
+ * uint32_t expected;
+ * r.get<endian::little>(expected);
+ * bool valid = r && expected == cr.value();
+ * @endcode
+ */
+template <typename Checksum> class checksum_reader
+{
+  public:
+    explicit checksum_reader(bytes::reader &reader, Checksum initial = Checksum())
+        : r(reader), c(std::move(initial))
+    {
+    }
+
+    template <endian endianness, typename T, typename... Args>
+    checksum_reader &get(T &value, Args &...args)
+    {
+        const uint8_t *start = r.current();
+        r.get<endianness>(value, args...);
+        return track(start);
+    }
+
+    template <endian endianness, typename Prefix = size_t, typename... Args>
+    checksum_reader &get_length_prefixed(Args &&...args)
+    {
+        const uint8_t *start = r.current();
+        r.get_length_prefixed<endianness, Prefix>(std::forward<Args>(args)...);
+        return track(start);
+    }
+
+    template <endian endianness, typename Prefix = size_t, typename... Args>
+    checksum_reader &view_length_prefixed(Args &&...args)
+    {
+        const uint8_t *start = r.current();
+        r.view_length_prefixed<endianness, Prefix>(std::forward<Args>(args)...);
+        return track(start);
+    }
+
+    template <typename T> checksum_reader &get_varint(T &value)
+    {
+        const uint8_t *start = r.current();
+        r.get_varint(value);
+        return track(start);
+    }
+
+    template <typename S> checksum_reader &get_record(S &s)
+    {
+        const uint8_t *start = r.current();
+        r.get_record(s);
+        return track(start);
+    }
+
+    checksum_reader &get_bytes(void *data, size_t n)
+    {
+        const uint8_t *start = r.current();
+        r.get_bytes(data, n);
+        return track(start);
+    }
+
+    checksum_reader &skip(size_t n)
+    {
+        const uint8_t *start = r.current();
+        r.skip(n);
+        return track(start);
+    }
+
+    /**
+     * @brief Checksum of the bytes read so far
+     */
+    typename Checksum::value_type value() const
+    {
+        return c.value();
+    }
+
+    Checksum &checksum()
+    {
+        return c;
+    }
+
+    bool good() const
+    {
+        return r.good();
+    }
+
+    explicit operator bool() const
+    {
+        return r.good();
+    }
+
+  private:
+    bytes::reader &r;
+    Checksum c;
+
+    checksum_reader &track(const uint8_t *start)
+    {
+        c.update(start, static_cast<size_t>(r.current() - start));
+        return *this;
+    }
+};
+
+} // namespace datapacker
+#endif // A_DATAPACKER_CHECKSUM_H
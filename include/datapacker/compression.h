@@ -0,0 +1,460 @@
+/**
+ * @file compression.h
+ * @brief Optional block compression for buffered streams, with LZ4 and Zstandard codecs
+ *
+ * `stream::compressed_writer` collects encoded values in a block like `stream::buffered_writer`,
+ * and compresses each block before it is written. `stream::compressed_reader` decompresses the
+ * blocks and decodes values like `stream::buffered_reader`. Compression is only used when one of
+ * these classes is, the other streams are not affected.
+ *
+ * Each block is written as a frame, with a header of one byte for the method, followed by the
+ * size of the block as a little endian 32 bit integer. The method is 0 if the block is stored
+ * as is, which is done for blocks smaller than the threshold and for blocks which do not become
+ * smaller when compressed. For a compressed block (method 1), the header also has the size of
+ * the compressed data as a little endian 32 bit integer.
+ *
+ * `lz4_codec` is available if `lz4.h` can be included and `zstd_codec` if `zstd.h` can be
+ * included, the program should then be linked with `liblz4` or `libzstd`. Any other class which
+ * satisfies `block_codec` can also be used.
+ */
+#ifndef A_DATAPACKER_COMPRESSION_H
+#define A_DATAPACKER_COMPRESSION_H
+#include "../datapacker.h"
+#include <concepts>
+#include <memory>
+
+#if __has_include(<lz4.h>)
+#include <lz4.h>
+#define DATAPACKER_HAS_LZ4 1
+#endif
+
+#if __has_include(<zstd.h>)
+#include <zstd.h>
+#define DATAPACKER_HAS_ZSTD 1
+#endif
+
+namespace datapacker
+{
+// Blocks smaller than this number of bytes are not compressed by stream::compressed_writer
+constexpr size_t COMPRESSION_THRESHOLD = 512;
+
+/**
+ * @brief A codec which compresses a block of memory in a single call
+ *
+ * `bound(n)` is the largest compressed size of `n` bytes, `compress(dst, capacity, src, n)`
+ * returns the size of the compressed data, or 0 on failure, and `decompress(dst, size, src, n)`
+ * returns true if `src` was decompressed to exactly `size` bytes.
+ */
+template <typename C>
+concept block_codec = requires(C c, uint8_t *dst, const uint8_t *src, size_t n) {
+    {
+        c.bound(n)
+    } -> std::convertible_to<size_t>;
+    {
+        c.compress(dst, n, src, n)
+    } -> std::convertible_to<size_t>;
+    {
+        c.decompress(dst, n, src, n)
+    } -> std::convertible_to<bool>;
+};
+
+#if defined(DATAPACKER_HAS_LZ4)
+/**
+ * @brief LZ4 compression, which is very fast and has a moderate ratio
+ */
+class lz4_codec
+{
+  public:
+    // Higher acceleration factors compress faster but less
+    explicit lz4_codec(int acceleration_factor = 1) : acceleration(acceleration_factor)
+    {
+    }
+
+    size_t bound(size_t n) const
+    {
+        return static_cast<size_t>(LZ4_compressBound(static_cast<int>(n)));
+    }
+
+    size_t compress(uint8_t *dst, size_t capacity, const uint8_t *src, size_t n)
+    {
+        int count = LZ4_compress_fast(reinterpret_cast<const char *>(src),
+                                      reinterpret_cast<char *>(dst), static_cast<int>(n),
+                                      static_cast<int>(capacity), acceleration);
+        return count <= 0 ? 0 : static_cast<size_t>(count);
+    }
+
+    bool decompress(uint8_t *dst, size_t size, const uint8_t *src, size_t n)
+    {
+        int count = LZ4_decompress_safe(reinterpret_cast<const char *>(src),
+                                        reinterpret_cast<char *>(dst), static_cast<int>(n),
+                                        static_cast<int>(size));
+        return count >= 0 && static_cast<size_t>(count) == size;
+    }
+
+  private:
+    int acceleration;
+};
+#endif
+
+#if defined(DATAPACKER_HAS_ZSTD)
+/**
+ * @brief Zstandard compression, which is slower than LZ4 but has a much better ratio
+ */
+class zstd_codec
+{
+  public:
+    explicit zstd_codec(int compression_level = 3) : level(compression_level)
+    {
+    }
+
+    size_t bound(size_t n) const
+    {
+        return ZSTD_compressBound(n);
+    }
+
+    size_t compress(uint8_t *dst, size_t capacity, const uint8_t *src, size_t n)
+    {
+        // The contexts are reused for every block, since creating them is expensive
+        if (!cctx)
+            cctx.reset(ZSTD_createCCtx());
+        if (!cctx)
+            return 0;
+        size_t count = ZSTD_compressCCtx(cctx.get(), dst, capacity, src, n, level);
+        return ZSTD_isError(count) ? 0 : count;
+    }
+
+    bool decompress(uint8_t *dst, size_t size, const uint8_t *src, size_t n)
+    {
+        if (!dctx)
+            dctx.reset(ZSTD_createDCtx());
+        if (!dctx)
+            return false;
+        size_t count = ZSTD_decompressDCtx(dctx.get(), dst, size, src, n);
+        return !ZSTD_isError(count) && count == size;
+    }
+
+  private:
+    int level;
+    std::unique_ptr<ZSTD_CCtx, size_t (*)(ZSTD_CCtx *)> cctx{nullptr, ZSTD_freeCCtx};
+    std::unique_ptr<ZSTD_DCtx, size_t (*)(ZSTD_DCtx *)> dctx{nullptr, ZSTD_freeDCtx};
+};
+#endif
+
+namespace stream
+{
+namespace internal
+{
+enum compressed_block_method : uint8_t
+{
+    raw_block = 0,
+    compressed_block = 1
+};
+
+constexpr size_t BLOCK_HEADER_SIZE = 5;
+constexpr size_t COMPRESSED_BLOCK_HEADER_SIZE = 9;
+// Sizes are stored in 32 bits, and codecs take sizes as int
+constexpr size_t MAX_COMPRESSED_BLOCK_SIZE = size_t(1) << 30;
+} // namespace internal
+
+/**
+ * @brief Encodes values like `buffered_writer`, and compresses each block with `Codec` before it
+ * is written to an `ostream`, a `FILE *` or a file descriptor
+ *
+ * Blocks smaller than `min_size` bytes are stored without compression. Only `flush` and the
+ * destructor write the last partial block, so flush only when the data is actually needed by
+ * the reader, since smaller blocks compress less. Blocks are atmost `block_size` bytes, which
+ * should not be larger than the `limit` passed to the reader.
+ *
+ * @code
+ * stream::compressed_writer<lz4_codec> w(socket_fd);
+ * w.write<endian::little>(samples).write<endian::little>(names);
+ * w.flush();
+ * @endcode
+ */
+template <block_codec Codec> class compressed_writer
+{
+  public:
+    explicit compressed_writer(std::ostream &os, Codec c = Codec(),
+                               size_t min_size = COMPRESSION_THRESHOLD,
+                               size_t block_size = BUFFERED_BLOCK_SIZE)
+        : compressed_writer(std::move(c), min_size, block_size)
+    {
+        out.os = &os;
+    }
+
+    explicit compressed_writer(FILE *file, Codec c = Codec(),
+                               size_t min_size = COMPRESSION_THRESHOLD,
+                               size_t block_size = BUFFERED_BLOCK_SIZE)
+        : compressed_writer(std::move(c), min_size, block_size)
+    {
+        out.file = file;
+    }
+
+    // The descriptor is not closed by the writer
+    explicit compressed_writer(int fd, Codec c = Codec(),
+                               size_t min_size = COMPRESSION_THRESHOLD,
+                               size_t block_size = BUFFERED_BLOCK_SIZE)
+        : compressed_writer(std::move(c), min_size, block_size)
+    {
+        out.fd = fd;
+    }
+
+    compressed_writer(const compressed_writer &) = delete;
+    compressed_writer &operator=(const compressed_writer &) = delete;
+
+    /**
+     * @brief Encodes a value with specified endianness, see `buffered_writer::write`
+     */
+    template <endian endianness, typename Prefix = size_t, typename T>
+    compressed_writer &write(const T &value)
+    {
+        w.template write<endianness, Prefix>(value);
+        return *this;
+    }
+
+    /**
+     * @brief Encodes multiple values with specified endianness, one after the other
+     */
+    template <endian endianness, typename T, typename U, typename... Args>
+    compressed_writer &write(const T &value, const U &next, const Args &...args)
+    {
+        w.template write<endianness>(value, next, args...);
+        return *this;
+    }
+
+    compressed_writer &write_bytes(const void *data, size_t n)
+    {
+        w.write_bytes(data, n);
+        return *this;
+    }
+
+    /**
+     * @brief Compresses and writes the data in the block, see `buffered_writer::flush`
+     */
+    void flush()
+    {
+        w.flush();
+    }
+
+    /**
+     * @brief Number of bytes written to the destination, including the headers of the blocks
+     */
+    size_t written() const
+    {
+        return total;
+    }
+
+  private:
+    internal::endpoint out;
+    Codec codec;
+    size_t threshold;
+    size_t frame_size;
+    size_t total = 0;
+    std::vector<uint8_t> scratch;
+    // Declared last, so that it is destroyed and flushed before the other members
+    buffered_writer w;
+
+    compressed_writer(Codec c, size_t min_size, size_t block_size)
+        : codec(std::move(c)), threshold(min_size),
+          frame_size(block_size < internal::MAX_COMPRESSED_BLOCK_SIZE
+                         ? block_size
+                         : internal::MAX_COMPRESSED_BLOCK_SIZE),
+          w([this](const uint8_t *data, size_t n) { return write_blocks(data, n); }, frame_size)
+    {
+    }
+
+    // Large writes of buffered_writer go directly to the sink, so they are split into blocks
+    bool write_blocks(const uint8_t *data, size_t n)
+    {
+        while (n > 0)
+        {
+            size_t count = n < frame_size ? n : frame_size;
+            if (!write_block(data, count))
+                return false;
+            data += count;
+            n -= count;
+        }
+        return true;
+    }
+
+    bool write_block(const uint8_t *data, size_t n)
+    {
+        size_t stored = 0;
+        if (n >= threshold)
+        {
+            size_t bound = codec.bound(n);
+            if (scratch.size() < internal::COMPRESSED_BLOCK_HEADER_SIZE + bound)
+                scratch.resize(internal::COMPRESSED_BLOCK_HEADER_SIZE + bound);
+            stored = codec.compress(scratch.data() + internal::COMPRESSED_BLOCK_HEADER_SIZE, bound,
+                                    data, n);
+        }
+        if (stored > 0 && stored < n)
+        {
+            scratch[0] = internal::compressed_block;
+            bytes::encode<endian::little>(scratch.data() + 1, static_cast<uint32_t>(n));
+            bytes::encode<endian::little>(scratch.data() + 5, static_cast<uint32_t>(stored));
+            total += internal::COMPRESSED_BLOCK_HEADER_SIZE + stored;
+            return out.write(scratch.data(), internal::COMPRESSED_BLOCK_HEADER_SIZE + stored);
+        }
+        uint8_t header[internal::BLOCK_HEADER_SIZE] = {internal::raw_block};
+        bytes::encode<endian::little>(header + 1, static_cast<uint32_t>(n));
+        total += sizeof(header) + n;
+        return out.write(header, sizeof(header)) && out.write(data, n);
+    }
+};
+
+/**
+ * @brief Decompresses blocks written by `compressed_writer` with the same codec, and decodes
+ * values like `buffered_reader`
+ *
+ * A `std::runtime_error` is thrown if the header of a block is invalid, if a block is larger
+ * than `limit`, or if a block could not be decompressed. If the input ends in the
+ * middle of a block, the reader enters a failed state like `buffered_reader`.
+ */
+template <block_codec Codec> class compressed_reader
+{
+  public:
+    explicit compressed_reader(std::istream &is, Codec c = Codec(),
+                               size_t limit = BUFFERED_BLOCK_SIZE)
+        : compressed_reader(std::move(c), limit)
+    {
+        in.is = &is;
+    }
+
+    explicit compressed_reader(FILE *file, Codec c = Codec(),
+                               size_t limit = BUFFERED_BLOCK_SIZE)
+        : compressed_reader(std::move(c), limit)
+    {
+        in.file = file;
+    }
+
+    // The descriptor is not closed by the reader
+    explicit compressed_reader(int fd, Codec c = Codec(),
+                               size_t limit = BUFFERED_BLOCK_SIZE)
+        : compressed_reader(std::move(c), limit)
+    {
+        in.fd = fd;
+    }
+
+    compressed_reader(const compressed_reader &) = delete;
+    compressed_reader &operator=(const compressed_reader &) = delete;
+
+    /**
+     * @brief Decodes a value with specified endianness, see `buffered_reader::read`
+     */
+    template <endian endianness, typename Prefix = size_t, typename T>
+    compressed_reader &read(T &value, size_t max_elements = DEFAULT_MAX_NUMBER_OF_ELEMENTS)
+    {
+        r.template read<endianness, Prefix>(value, max_elements);
+        return *this;
+    }
+
+    /**
+     * @brief Reads a length-prefixed sequence in chunks, see `buffered_reader::read_chunked`
+     */
+    template <endian endianness, typename T, typename Prefix = size_t, typename Callback>
+    size_t read_chunked(Callback &&callback,
+                        size_t max_elements = std::numeric_limits<size_t>::max())
+    {
+        return r.template read_chunked<endianness, T, Prefix>(std::forward<Callback>(callback),
+                                                              max_elements);
+    }
+
+    bool read_bytes(void *data, size_t n)
+    {
+        return r.read_bytes(data, n);
+    }
+
+    bool good() const
+    {
+        return r.good();
+    }
+
+    explicit operator bool() const
+    {
+        return r.good();
+    }
+
+  private:
+    internal::endpoint in;
+    Codec codec;
+    size_t max_block_size;
+    // The decompressed block, of which `block.size() - pos` bytes have not been read yet
+    std::vector<uint8_t> block;
+    std::vector<uint8_t> scratch;
+    size_t pos = 0;
+    buffered_reader r;
+
+    compressed_reader(Codec c, size_t limit)
+        : codec(std::move(c)), max_block_size(limit),
+          r([this](uint8_t *data, size_t n) { return read_blocks(data, n); }, limit)
+    {
+    }
+
+    size_t read_blocks(uint8_t *data, size_t n)
+    {
+        if (pos == block.size() && !next_block())
+            return 0;
+        size_t count = block.size() - pos < n ? block.size() - pos : n;
+        memcpy(data, block.data() + pos, count);
+        pos += count;
+        return count;
+    }
+
+    bool read_exact(uint8_t *data, size_t n)
+    {
+        while (n > 0)
+        {
+            size_t count = in.read(data, n);
+            if (count == 0)
+                return false;
+            data += count;
+            n -= count;
+        }
+        return true;
+    }
+
+    // Reads and decompresses the next block, returns false if the input ended
+    bool next_block()
+    {
+        block.clear();
+        pos = 0;
+        uint8_t header[internal::COMPRESSED_BLOCK_HEADER_SIZE];
+        if (!read_exact(header, internal::BLOCK_HEADER_SIZE))
+            return false;
+        uint32_t size;
+        bytes::decode<endian::little>(header + 1, size);
+        if (header[0] > internal::compressed_block || size == 0 || size > max_block_size)
+            throw std::runtime_error("Invalid compressed block header");
+        block.resize(size);
+        if (header[0] == internal::raw_block)
+        {
+            if (read_exact(block.data(), size))
+                return true;
+            block.clear();
+            return false;
+        }
+        uint32_t stored;
+        if (!read_exact(header + internal::BLOCK_HEADER_SIZE, 4))
+        {
+            block.clear();
+            return false;
+        }
+        bytes::decode<endian::little>(header + internal::BLOCK_HEADER_SIZE, stored);
+        // The writer only compresses a block if it becomes smaller
+        if (stored == 0 || stored >= size)
+            throw std::runtime_error("Invalid compressed block header");
+        scratch.resize(stored);
+        if (!read_exact(scratch.data(), stored))
+        {
+            block.clear();
+            return false;
+        }
+        if (!codec.decompress(block.data(), size, scratch.data(), stored))
+            throw std::runtime_error("Compressed block could not be decoded");
+        return true;
+    }
+};
+} // namespace stream
+} // namespace datapacker
+#endif // A_DATAPACKER_COMPRESSION_H
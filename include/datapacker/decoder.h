@@ -0,0 +1,343 @@
+/**
+ * @file decoder.h
+ * @brief A resumable decoder, which decodes a message from fragments as they arrive
+ *
+ * The decoder is a state machine over a list of expected values. Bytes are fed to it in pieces of
+ * any size, for example as they are received from a non blocking socket, and it continues from
+ * where the previous piece ended, including the middle of a field or of a length-prefixed
+ * sequence. Nothing is parsed twice, and no byte is buffered except for a field which is split
+ * across two pieces.
+ */
+#ifndef A_DATAPACKER_DECODER_H
+#define A_DATAPACKER_DECODER_H
+#include "../datapacker.h"
+
+namespace datapacker
+{
+namespace bytes
+{
+
+/**
+ * @brief Result of feeding bytes to an `incremental_decoder`
+ */
+enum class decode_status
+{
+    // All the bytes were consumed, and more are needed to complete the message
+    need_more = 0,
+    // The message is complete, bytes after it were not consumed
+    done = 1,
+    // The data is invalid, a length prefix could not be decoded or exceeded its maximum
+    error = 2
+};
+
+/**
+ * @brief Decodes a message whose bytes arrive in fragments
+ *
+ * The fields of the message are declared with `expect`, in the order in which they are encoded,
+ * with references to the variables where they will be stored. `feed` then decodes as much as
+ * possible from every fragment. Data is in the format written by `bytes::writer`.
+ *
+ * @code
+ * uint32_t id;
+ * std::string name;
+ * bytes::incremental_decoder d;
+ * d.expect<endian::big>(id).expect<endian::big>(name, 256);
+ * while (d.feed(data, size) == bytes::decode_status::need_more)
+ *     size = recv(socket, data, capacity, 0);
+ * // Bytes after d.consumed() belong to the next message, call restart() to decode it
+ * @endcode
+ *
+ * @note The variables passed to `expect` should outlive the decoder, and should not be modified
+ * until the message has been decoded. If `feed` returns `error`, further calls also return
+ * `error` until `restart` is called.
+ */
+class incremental_decoder
+{
+  public:
+    /**
+     * @brief Expects an integer, a real number, a record described by `schema`, or a
+     * length-prefixed string or vector
+     * @tparam endianness The endianness of the field
+     * @tparam Prefix Type of the length prefix of sequences, see `length_prefix`
+     * @param value Where the decoded value will be stored
+     * @param max_elements Maximum number of elements in a string or vector, the decoder reports an
+     * error if the data contains more
+     */
+    template <endian endianness, typename Prefix = size_t, typename T>
+    incremental_decoder &expect(T &value, size_t max_elements = DEFAULT_MAX_NUMBER_OF_ELEMENTS)
+    {
+        if constexpr (internal::is_fixed_width<T>)
+        {
+            steps.push_back(step{&value, 0, sizeof(T), 0, &decode_fixed<endianness, T>});
+        }
+        else if constexpr (has_schema<T>)
+        {
+            steps.push_back(step{&value, 0, packed_size<T>, 0, &decode_record_step<T>});
+        }
+        else if constexpr (internal::is_string<T>::value || internal::is_vector<T>::value)
+        {
+            static_assert(internal::is_fixed_width<typename T::value_type>,
+                          "Only sequences of integers and real numbers can be decoded");
+            constexpr size_t prefix_size =
+                std::is_same<Prefix, varint_prefix>::value ? 0 : length_prefix<Prefix>::max_size;
+            steps.push_back(step{&value, max_elements, prefix_size, sizeof(typename T::value_type),
+                                 &decode_sequence<endianness, Prefix, T>});
+        }
+        else
+        {
+            static_assert(internal::False<T>{},
+                          "Invalid type passed to expect, can only decode integers, real "
+                          "numbers, vectors, strings and records");
+        }
+        return *this;
+    }
+
+    /**
+     * @brief Expects an integer encoded as a variable length integer, see `encode_varint`
+     */
+    template <typename T> incremental_decoder &expect_varint(T &value)
+    {
+        static_assert(std::is_integral<T>::value, "Only integers can be decoded as varints");
+        steps.push_back(step{&value, 0, 0, 0, &decode_varint_step<T>});
+        return *this;
+    }
+
+    /**
+     * @brief Decodes as much of the message as possible from `size` bytes of `data`
+     * @return `done` if the message is complete, `need_more` if all the bytes were consumed and
+     * the message is incomplete, or `error` if the data is invalid. The number of bytes consumed
+     * is returned by `consumed()`
+     */
+    decode_status feed(const uint8_t *data, size_t size)
+    {
+        const uint8_t *p = data;
+        const uint8_t *end = data + size;
+        while (status == decode_status::need_more)
+        {
+            if (current == steps.size())
+            {
+                status = decode_status::done;
+                break;
+            }
+            decode_status result = steps[current].run(*this, steps[current], p, end);
+            if (result == decode_status::error)
+                status = result;
+            if (result != decode_status::done)
+                break;
+            ++current;
+        }
+        used = static_cast<size_t>(p - data);
+        return status;
+    }
+
+    decode_status feed(std::span<const uint8_t> data)
+    {
+        return feed(data.data(), data.size());
+    }
+
+    /**
+     * @brief Number of bytes consumed by the last call to `feed`
+     */
+    size_t consumed() const
+    {
+        return used;
+    }
+
+    /**
+     * @brief Number of bytes which can be fed next without going past the end of the message,
+     * atleast 1 until the message is complete. Useful to read a message from a source without
+     * consuming any bytes of the next message
+     */
+    size_t bytes_wanted() const
+    {
+        if (status != decode_status::need_more || current == steps.size())
+            return 0;
+        const step &s = steps[current];
+        if (s.element_size && phase == 1)
+            return (length - index) * s.element_size - pending.size();
+        // Varints are read one byte at a time, since their size is not known in advance
+        if (s.size == 0)
+            return 1;
+        return s.size - pending.size();
+    }
+
+    /**
+     * @brief Current status, `need_more` until the message is complete
+     */
+    decode_status state() const
+    {
+        return status;
+    }
+
+    /**
+     * @brief Starts decoding a new message with the same fields
+     */
+    void restart()
+    {
+        current = 0;
+        phase = 0;
+        length = 0;
+        index = 0;
+        used = 0;
+        pending.clear();
+        status = decode_status::need_more;
+    }
+
+    /**
+     * @brief Removes all the expected fields, and starts a new message
+     */
+    void clear()
+    {
+        steps.clear();
+        restart();
+    }
+
+  private:
+    // A field of the message, `run` decodes it from [data, end) and advances data
+    struct step
+    {
+        void *target;
+        size_t max_elements;
+        // Size of the field or of the length prefix of a sequence, 0 for varints
+        size_t size;
+        // Size of the elements of a sequence, 0 for other fields
+        size_t element_size;
+        decode_status (*run)(incremental_decoder &, step &, const uint8_t *&, const uint8_t *);
+    };
+
+    std::vector<step> steps;
+    // Bytes of a field which is split across fragments
+    std::vector<uint8_t> pending;
+    size_t current = 0;
+    // 0 while the length prefix of a sequence is decoded, then 1 while its elements are
+    int phase = 0;
+    // Number of elements of the current sequence, and the number which have been decoded
+    size_t length = 0;
+    size_t index = 0;
+    size_t used = 0;
+    decode_status status = decode_status::need_more;
+
+    // Appends bytes to `pending` until it has `n` bytes, returns false if data ran out
+    bool accumulate(size_t n, const uint8_t *&data, const uint8_t *end)
+    {
+        size_t available = static_cast<size_t>(end - data);
+        size_t count = n - pending.size() < available ? n - pending.size() : available;
+        pending.insert(pending.end(), data, data + count);
+        data += count;
+        return pending.size() == n;
+    }
+
+    // Returns a pointer to `n` bytes of the field, directly from the fragment if the whole field
+    // is in it, otherwise from `pending`. Returns nullptr if the field is not complete yet
+    const uint8_t *field(size_t n, const uint8_t *&data, const uint8_t *end)
+    {
+        if (pending.empty() && static_cast<size_t>(end - data) >= n)
+        {
+            const uint8_t *p = data;
+            data += n;
+            return p;
+        }
+        return accumulate(n, data, end) ? pending.data() : nullptr;
+    }
+
+    // Appends the bytes of a varint to `pending` until its last byte, returns false if data ran
+    // out before it
+    bool accumulate_varint(size_t max_size, const uint8_t *&data, const uint8_t *end)
+    {
+        while (data < end && pending.size() < max_size)
+        {
+            uint8_t byte = *data++;
+            pending.push_back(byte);
+            if (!(byte & 0x80))
+                return true;
+        }
+        return pending.size() == max_size;
+    }
+
+    template <endian endianness, typename T>
+    static decode_status decode_fixed(incremental_decoder &d, step &s, const uint8_t *&data,
+                                      const uint8_t *end)
+    {
+        const uint8_t *p = d.field(sizeof(T), data, end);
+        if (!p)
+            return decode_status::need_more;
+        decode<endianness>(p, *static_cast<T *>(s.target));
+        d.pending.clear();
+        return decode_status::done;
+    }
+
+    template <typename S>
+    static decode_status decode_record_step(incremental_decoder &d, step &s, const uint8_t *&data,
+                                            const uint8_t *end)
+    {
+        const uint8_t *p = d.field(packed_size<S>, data, end);
+        if (!p)
+            return decode_status::need_more;
+        decode_record(p, *static_cast<S *>(s.target));
+        d.pending.clear();
+        return decode_status::done;
+    }
+
+    template <typename T>
+    static decode_status decode_varint_step(incremental_decoder &d, step &s, const uint8_t *&data,
+                                            const uint8_t *end)
+    {
+        if (!d.accumulate_varint(max_varint_size<T>, data, end))
+            return decode_status::need_more;
+        int n = decode_varint(d.pending.data(), d.pending.size(), *static_cast<T *>(s.target));
+        d.pending.clear();
+        return n == -1 ? decode_status::error : decode_status::done;
+    }
+
+    template <endian endianness, typename Prefix, typename C>
+    static decode_status decode_sequence(incremental_decoder &d, step &s, const uint8_t *&data,
+                                         const uint8_t *end)
+    {
+        using V = typename C::value_type;
+        using prefix = length_prefix<Prefix>;
+        C &value = *static_cast<C *>(s.target);
+        if (d.phase == 0)
+        {
+            bool complete = std::is_same<Prefix, varint_prefix>::value
+                                ? d.accumulate_varint(prefix::max_size, data, end)
+                                : d.accumulate(prefix::max_size, data, end);
+            if (!complete)
+                return decode_status::need_more;
+            size_t sz = 0;
+            int n = prefix::template decode<endianness>(d.pending.data(), d.pending.size(), sz);
+            d.pending.clear();
+            if (n == -1 || sz > s.max_elements)
+                return decode_status::error;
+            value.resize(sz);
+            d.length = sz;
+            d.index = 0;
+            d.phase = 1;
+        }
+        while (d.index < d.length)
+        {
+            size_t available = static_cast<size_t>(end - data);
+            if (!d.pending.empty() || available < sizeof(V))
+            {
+                // An element is split across fragments
+                if (!d.accumulate(sizeof(V), data, end))
+                    return decode_status::need_more;
+                decode_array<endianness>(d.pending.data(), value.data() + d.index, 1);
+                d.pending.clear();
+                ++d.index;
+                continue;
+            }
+            size_t count = available / sizeof(V);
+            if (count > d.length - d.index)
+                count = d.length - d.index;
+            decode_array<endianness>(data, value.data() + d.index, count);
+            data += count * sizeof(V);
+            d.index += count;
+        }
+        d.phase = 0;
+        return decode_status::done;
+    }
+};
+
+} // namespace bytes
+} // namespace datapacker
+#endif // A_DATAPACKER_DECODER_H
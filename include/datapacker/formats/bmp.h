@@ -0,0 +1,79 @@
+/**
+ * @file bmp.h
+ * @brief Header of BMP images, decoded with a record schema
+ *
+ * Only files with a BITMAPINFOHEADER (or a larger DIB header, of which the first 40 bytes are
+ * decoded) are supported.
+ */
+#ifndef A_DATAPACKER_FORMATS_BMP_H
+#define A_DATAPACKER_FORMATS_BMP_H
+#include "../../datapacker.h"
+
+namespace datapacker
+{
+namespace formats
+{
+// 'B', 'M' decoded as a little endian integer
+constexpr uint16_t BMP_SIGNATURE = 0x4D42;
+
+/**
+ * @brief The BMP file header followed by the BITMAPINFOHEADER, which are the first 54 bytes of
+ * the file. All the fields are stored in little endian format.
+ */
+struct bmp_header
+{
+    uint16_t signature;
+    uint32_t size;
+    uint32_t starting_offset;
+    uint32_t dib_header_size;
+    int32_t width;
+    int32_t height;
+    uint16_t color_planes;
+    uint16_t bpp;
+    uint32_t compression;
+    uint32_t image_size;
+    int32_t horizontal_resolution;
+    int32_t vertical_resolution;
+    uint32_t palette_colors;
+    uint32_t imp_colors;
+};
+} // namespace formats
+
+namespace bytes
+{
+template <>
+struct schema<formats::bmp_header>
+    : layout<field<&formats::bmp_header::signature>, field<&formats::bmp_header::size>,
+             padding<4>, field<&formats::bmp_header::starting_offset>,
+             field<&formats::bmp_header::dib_header_size>, field<&formats::bmp_header::width>,
+             field<&formats::bmp_header::height>, field<&formats::bmp_header::color_planes>,
+             field<&formats::bmp_header::bpp>, field<&formats::bmp_header::compression>,
+             field<&formats::bmp_header::image_size>,
+             field<&formats::bmp_header::horizontal_resolution>,
+             field<&formats::bmp_header::vertical_resolution>,
+             field<&formats::bmp_header::palette_colors>,
+             field<&formats::bmp_header::imp_colors>>
+{
+};
+} // namespace bytes
+
+namespace formats
+{
+static_assert(bytes::packed_size<bmp_header> == 54);
+
+/**
+ * @brief Decodes the header from the first `size` bytes of a BMP file. The size is checked once,
+ * and every field is then decoded from a fixed offset.
+ * @return false if there are fewer than 54 bytes, if the signature is not "BM" or if the DIB
+ * header is smaller than a BITMAPINFOHEADER
+ */
+inline bool parse_bmp_header(const uint8_t *data, size_t size, bmp_header &header)
+{
+    if (size < bytes::packed_size<bmp_header>)
+        return false;
+    bytes::decode_record(data, header);
+    return header.signature == BMP_SIGNATURE && header.dib_header_size >= 40;
+}
+} // namespace formats
+} // namespace datapacker
+#endif // A_DATAPACKER_FORMATS_BMP_H
@@ -0,0 +1,26 @@
+/**
+ * @file fourcc.h
+ * @brief Four character codes, which identify the chunks of RIFF, PNG and many other formats
+ */
+#ifndef A_DATAPACKER_FORMATS_FOURCC_H
+#define A_DATAPACKER_FORMATS_FOURCC_H
+#include "../../datapacker.h"
+
+namespace datapacker
+{
+namespace formats
+{
+/**
+ * @brief The value of a four character code such as `"RIFF"`, when its bytes are decoded as a big
+ * endian integer, so that codes can be compared with fields decoded with `endian::big`
+ */
+constexpr uint32_t fourcc(const char (&code)[5])
+{
+    return static_cast<uint32_t>(static_cast<uint8_t>(code[0])) << 24 |
+           static_cast<uint32_t>(static_cast<uint8_t>(code[1])) << 16 |
+           static_cast<uint32_t>(static_cast<uint8_t>(code[2])) << 8 |
+           static_cast<uint32_t>(static_cast<uint8_t>(code[3]));
+}
+} // namespace formats
+} // namespace datapacker
+#endif // A_DATAPACKER_FORMATS_FOURCC_H
@@ -0,0 +1,108 @@
+/**
+ * @file png.h
+ * @brief Signature, IHDR chunk and chunk headers of PNG images, decoded with record schemas
+ *
+ * The CRCs of the chunks are decoded but not verified.
+ */
+#ifndef A_DATAPACKER_FORMATS_PNG_H
+#define A_DATAPACKER_FORMATS_PNG_H
+#include "../../datapacker.h"
+#include "fourcc.h"
+
+namespace datapacker
+{
+namespace formats
+{
+// The 8 bytes at the start of every PNG file, decoded as a big endian integer
+constexpr uint64_t PNG_SIGNATURE = 0x89504E470D0A1A0AULL;
+
+/**
+ * @brief The signature followed by the IHDR chunk, which are the first 33 bytes of a PNG file.
+ * All the fields are stored in big endian format.
+ */
+struct png_header
+{
+    uint64_t signature;
+    uint32_t ihdr_length;
+    uint32_t ihdr_type;
+    uint32_t width;
+    uint32_t height;
+    uint8_t bit_depth;
+    uint8_t color_type;
+    uint8_t compression;
+    uint8_t filter;
+    uint8_t interlace;
+    uint32_t crc;
+};
+
+/**
+ * @brief Length and type of a PNG chunk, which are followed by `length` bytes of data and a CRC
+ */
+struct png_chunk_header
+{
+    uint32_t length;
+    uint32_t type;
+};
+} // namespace formats
+
+namespace bytes
+{
+template <>
+struct schema<formats::png_header>
+    : layout<field<&formats::png_header::signature, endian::big>,
+             field<&formats::png_header::ihdr_length, endian::big>,
+             field<&formats::png_header::ihdr_type, endian::big>,
+             field<&formats::png_header::width, endian::big>,
+             field<&formats::png_header::height, endian::big>,
+             field<&formats::png_header::bit_depth>, field<&formats::png_header::color_type>,
+             field<&formats::png_header::compression>, field<&formats::png_header::filter>,
+             field<&formats::png_header::interlace>,
+             field<&formats::png_header::crc, endian::big>>
+{
+};
+
+template <>
+struct schema<formats::png_chunk_header>
+    : layout<field<&formats::png_chunk_header::length, endian::big>,
+             field<&formats::png_chunk_header::type, endian::big>>
+{
+};
+} // namespace bytes
+
+namespace formats
+{
+static_assert(bytes::packed_size<png_header> == 33);
+static_assert(bytes::packed_size<png_chunk_header> == 8);
+
+/**
+ * @brief Decodes the signature and the IHDR chunk from the first `size` bytes of a PNG file,
+ * with a single size check
+ * @return false if there are fewer than 33 bytes, if the signature is invalid or if the first
+ * chunk is not a valid IHDR chunk
+ */
+inline bool parse_png_header(const uint8_t *data, size_t size, png_header &header)
+{
+    if (size < bytes::packed_size<png_header>)
+        return false;
+    bytes::decode_record(data, header);
+    return header.signature == PNG_SIGNATURE && header.ihdr_length == 13 &&
+           header.ihdr_type == fourcc("IHDR") && header.width != 0 && header.height != 0;
+}
+
+/**
+ * @brief Decodes the header of the chunk at `offset`, the first chunk starts at offset 8
+ * @return false if the chunk, including its data and CRC, does not fit in `size` bytes
+ */
+inline bool parse_png_chunk_header(const uint8_t *data, size_t size, size_t offset,
+                                   png_chunk_header &chunk)
+{
+    constexpr size_t header_size = bytes::packed_size<png_chunk_header>;
+    if (offset > size || size - offset < header_size)
+        return false;
+    bytes::decode_record(data + offset, chunk);
+    // The length of a chunk is atmost 2^31 - 1
+    return chunk.length <= 0x7FFFFFFFu && size - offset - header_size >= size_t(chunk.length) + 4;
+}
+} // namespace formats
+} // namespace datapacker
+#endif // A_DATAPACKER_FORMATS_PNG_H
@@ -0,0 +1,128 @@
+/**
+ * @file wav.h
+ * @brief Header and chunks of WAV (RIFF WAVE) audio files, decoded with record schemas
+ */
+#ifndef A_DATAPACKER_FORMATS_WAV_H
+#define A_DATAPACKER_FORMATS_WAV_H
+#include "../../datapacker.h"
+#include "fourcc.h"
+
+namespace datapacker
+{
+namespace formats
+{
+/**
+ * @brief The RIFF header and the "fmt " chunk, which are the first 36 bytes of a WAV file. Chunk
+ * identifiers are decoded as big endian integers so that they can be compared with `fourcc`, the
+ * other fields are little endian.
+ */
+struct wav_header
+{
+    uint32_t riff_id;
+    uint32_t riff_size;
+    uint32_t wave_id;
+    uint32_t fmt_id;
+    uint32_t fmt_size;
+    uint16_t audio_format;
+    uint16_t channels;
+    uint32_t sample_rate;
+    uint32_t byte_rate;
+    uint16_t block_align;
+    uint16_t bits_per_sample;
+};
+
+/**
+ * @brief Identifier and size of a chunk of a RIFF file, the data of the chunk follows the header
+ * and is padded to an even number of bytes
+ */
+struct riff_chunk_header
+{
+    uint32_t id;
+    uint32_t size;
+};
+} // namespace formats
+
+namespace bytes
+{
+template <>
+struct schema<formats::wav_header>
+    : layout<field<&formats::wav_header::riff_id, endian::big>,
+             field<&formats::wav_header::riff_size>,
+             field<&formats::wav_header::wave_id, endian::big>,
+             field<&formats::wav_header::fmt_id, endian::big>,
+             field<&formats::wav_header::fmt_size>, field<&formats::wav_header::audio_format>,
+             field<&formats::wav_header::channels>, field<&formats::wav_header::sample_rate>,
+             field<&formats::wav_header::byte_rate>, field<&formats::wav_header::block_align>,
+             field<&formats::wav_header::bits_per_sample>>
+{
+};
+
+template <>
+struct schema<formats::riff_chunk_header>
+    : layout<field<&formats::riff_chunk_header::id, endian::big>,
+             field<&formats::riff_chunk_header::size>>
+{
+};
+} // namespace bytes
+
+namespace formats
+{
+static_assert(bytes::packed_size<wav_header> == 36);
+static_assert(bytes::packed_size<riff_chunk_header> == 8);
+
+/**
+ * @brief Decodes the header from the first `size` bytes of a WAV file, with a single size check
+ * @return false if there are fewer than 36 bytes, or if the file does not start with a RIFF
+ * WAVE header followed by a "fmt " chunk
+ */
+inline bool parse_wav_header(const uint8_t *data, size_t size, wav_header &header)
+{
+    if (size < bytes::packed_size<wav_header>)
+        return false;
+    bytes::decode_record(data, header);
+    return header.riff_id == fourcc("RIFF") && header.wave_id == fourcc("WAVE") &&
+           header.fmt_id == fourcc("fmt ") && header.fmt_size >= 16;
+}
+
+/**
+ * @brief Decodes the header of the chunk at `offset`
+ * @return false if the header, or the data of the chunk, does not fit in `size` bytes
+ */
+inline bool parse_riff_chunk_header(const uint8_t *data, size_t size, size_t offset,
+                                    riff_chunk_header &chunk)
+{
+    if (offset > size || size - offset < bytes::packed_size<riff_chunk_header>)
+        return false;
+    bytes::decode_record(data + offset, chunk);
+    return chunk.size <= size - offset - bytes::packed_size<riff_chunk_header>;
+}
+
+/**
+ * @brief Finds the first chunk with identifier `id` after the RIFF header, for example the
+ * "data" chunk which contains the samples
+ * @param offset Set to the offset of the data of the chunk
+ * @param length Set to the size of the data of the chunk
+ * @return false if there is no such chunk, or if a chunk before it is truncated
+ */
+inline bool find_riff_chunk(const uint8_t *data, size_t size, uint32_t id, size_t &offset,
+                            size_t &length)
+{
+    // Chunks start after "RIFF", the size and "WAVE"
+    size_t pos = 12;
+    riff_chunk_header chunk;
+    while (parse_riff_chunk_header(data, size, pos, chunk))
+    {
+        pos += bytes::packed_size<riff_chunk_header>;
+        if (chunk.id == id)
+        {
+            offset = pos;
+            length = chunk.size;
+            return true;
+        }
+        pos += chunk.size + (chunk.size & 1);
+    }
+    return false;
+}
+} // namespace formats
+} // namespace datapacker
+#endif // A_DATAPACKER_FORMATS_WAV_H
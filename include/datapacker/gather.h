@@ -0,0 +1,202 @@
+/**
+ * @file gather.h
+ * @brief Scatter/gather encoding, which describes a message as a list of `iovec` segments
+ *
+ * Length prefixes and small fields are encoded into a header buffer, and large byte arrays which
+ * need no conversion are referenced in place, so the message can be sent with `writev` or
+ * `sendmsg` without copying the bulk payload.
+ */
+#ifndef A_DATAPACKER_GATHER_H
+#define A_DATAPACKER_GATHER_H
+#include "../datapacker.h"
+
+#if !defined(_WIN32)
+#include <sys/uio.h>
+#endif
+
+namespace datapacker
+{
+#if defined(_WIN32)
+// Same layout as the POSIX struct, which is not available on Windows
+struct iovec
+{
+    void *iov_base;
+    size_t iov_len;
+};
+#else
+using iovec = ::iovec;
+#endif
+
+// Sequences smaller than this number of bytes are copied into the header buffer by gather_writer
+constexpr size_t GATHER_COPY_THRESHOLD = 256;
+
+/**
+ * @brief Encodes a message into a header buffer and references to large arrays, which together
+ * form a list of `iovec` segments
+ *
+ * Values are encoded in the same format as `bytes::writer`, the segments concatenated together
+ * are equal to the output of a `bytes::writer` with the same calls. Sequences of at least
+ * `copy_threshold` bytes whose elements need no byte swapping are referenced instead of being
+ * copied, all other data is encoded into the header buffer. Like `bytes::writer`, if the header
+ * buffer is too small the writer enters a failed state and further calls do nothing.
+ *
+ * @code
+ * uint8_t header[64];
+ * datapacker::gather_writer g(header, sizeof(header));
+ * g.put<endian::little>(message_type, sequence_number).put_length_prefixed<endian::little>(blob);
+ * auto segments = g.segments();
+ * writev(fd, segments.data(), static_cast<int>(segments.size()));
+ * @endcode
+ *
+ * @note The referenced arrays and the header buffer should outlive the segments
+ */
+class gather_writer
+{
+  public:
+    /**
+     * @brief Creates a writer which encodes small fields into `size` bytes of `header`
+     */
+    gather_writer(uint8_t *header, size_t size, size_t copy_threshold = GATHER_COPY_THRESHOLD)
+        : w(header, size), threshold(copy_threshold)
+    {
+    }
+
+    /**
+     * @brief Encodes one or more values with specified endianness, see `bytes::writer::put`.
+     * Strings and vectors are written with `put_length_prefixed`
+     */
+    template <endian endianness, typename T, typename... Args>
+    gather_writer &put(const T &value, const Args &...args)
+    {
+        put_one<endianness>(value);
+        (put_one<endianness>(args), ...);
+        return *this;
+    }
+
+    /**
+     * @brief Encodes `n` elements of `arr` with a length prefix, which is a `size_t` by default.
+     * The elements are referenced if they are large enough and need no conversion.
+     */
+    template <endian endianness, typename Prefix = size_t, typename T>
+    gather_writer &put_length_prefixed(const T *arr, size_t n)
+    {
+        if constexpr (sizeof(T) == 1 ||
+                      (internal::is_bit_copyable<T> && internal::is_native_endian<endianness>))
+        {
+            using prefix = bytes::length_prefix<Prefix>;
+            if (n <= prefix::max_length && n * sizeof(T) >= threshold && n <= SIZE_MAX / sizeof(T))
+            {
+                uint8_t buffer[prefix::max_size];
+                int prefix_size = prefix::template encode<endianness>(buffer, n);
+                w.put_bytes(buffer, static_cast<size_t>(prefix_size));
+                return put_bytes(arr, n * sizeof(T));
+            }
+        }
+        w.put_length_prefixed<endianness, Prefix>(arr, n);
+        return *this;
+    }
+
+    /**
+     * @brief Encodes a string with a length prefix, which is a `size_t` by default
+     */
+    template <endian endianness, typename Prefix = size_t>
+    gather_writer &put_length_prefixed(std::string_view s)
+    {
+        return put_length_prefixed<endianness, Prefix>(s.data(), s.size());
+    }
+
+    /**
+     * @brief Encodes a vector with a length prefix, which is a `size_t` by default
+     */
+    template <endian endianness, typename Prefix = size_t, typename T, typename Allocator>
+    gather_writer &put_length_prefixed(const std::vector<T, Allocator> &v)
+    {
+        return put_length_prefixed<endianness, Prefix>(v.data(), v.size());
+    }
+
+    /**
+     * @brief Writes `n` bytes as is, they are referenced if `n` is atleast the copy threshold
+     */
+    gather_writer &put_bytes(const void *data, size_t n)
+    {
+        if (n < threshold)
+        {
+            w.put_bytes(data, n);
+        }
+        else if (w)
+        {
+            close_header_segment();
+            iov.push_back(iovec{const_cast<void *>(data), n});
+            referenced += n;
+        }
+        return *this;
+    }
+
+    /**
+     * @brief Returns the segments of the message, in order. The span is valid until the next call
+     * to a member function which modifies the writer.
+     */
+    std::span<const iovec> segments()
+    {
+        close_header_segment();
+        return std::span<const iovec>(iov.data(), iov.size());
+    }
+
+    /**
+     * @brief Total size of the message in bytes
+     */
+    size_t size() const
+    {
+        return w.position() + referenced;
+    }
+
+    /**
+     * @brief Clears the segments, and starts encoding at the beginning of the header buffer
+     */
+    void clear()
+    {
+        w = bytes::writer(w.data(), w.size());
+        iov.clear();
+        header_start = 0;
+        referenced = 0;
+    }
+
+    bool good() const
+    {
+        return w.good();
+    }
+
+    explicit operator bool() const
+    {
+        return w.good();
+    }
+
+  private:
+    bytes::writer w;
+    size_t threshold;
+    std::vector<iovec> iov;
+    // Start of the part of the header buffer which is not yet part of a segment
+    size_t header_start = 0;
+    // Number of bytes in referenced segments
+    size_t referenced = 0;
+
+    void close_header_segment()
+    {
+        if (w.position() > header_start)
+        {
+            iov.push_back(iovec{w.data() + header_start, w.position() - header_start});
+            header_start = w.position();
+        }
+    }
+
+    template <endian endianness, typename T> void put_one(const T &value)
+    {
+        if constexpr (internal::is_string<T>::value || internal::is_vector<T>::value)
+            put_length_prefixed<endianness>(value);
+        else
+            w.put<endianness>(value);
+    }
+};
+
+} // namespace datapacker
+#endif // A_DATAPACKER_GATHER_H
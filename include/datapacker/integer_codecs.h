@@ -0,0 +1,348 @@
+/**
+ * @file integer_codecs.h
+ * @brief Compact encodings of integer arrays, with delta + ZigZag varints or bit-packed
+ * frame-of-reference blocks
+ *
+ * The codecs can be selected in place of `fixed_width_codec`, which encodes elements in the same
+ * format as `encode_length_prefixed`. Timestamps, sequence numbers and other sorted or slowly
+ * changing values usually take one or two bytes per element with `delta_codec`, and values which
+ * are close to each other take a few bits per element with `frame_of_reference_codec`.
+ *
+ * @code
+ * std::vector<uint8_t> buffer(bytes::integers_bound<bytes::delta_codec, int64_t>(v.size()));
+ * int n = bytes::encode_integers<bytes::delta_codec, endian::little>(buffer.data(), v);
+ * bytes::decode_integers<bytes::delta_codec, endian::little>(buffer.data(), n, out, 1000000);
+ * @endcode
+ */
+#ifndef A_DATAPACKER_INTEGER_CODECS_H
+#define A_DATAPACKER_INTEGER_CODECS_H
+#include "../datapacker.h"
+
+namespace datapacker
+{
+// Number of values in each block of frame_of_reference_codec
+constexpr size_t FRAME_OF_REFERENCE_BLOCK_SIZE = 128;
+
+namespace internal
+{
+template <typename T>
+constexpr bool is_codec_integer =
+    std::is_integral_v<T> && !std::is_same_v<std::remove_cv_t<T>, bool>;
+
+// Writes the low `width` bits of each value one after the other, starting from the lowest bit of
+// the first byte, and returns the number of bytes written, which is `ceil(n * width / 8)`
+inline size_t pack_bits(uint8_t *buffer, const uint64_t *values, size_t n, unsigned width)
+{
+    if (width == 0)
+        return 0;
+    uint64_t acc = 0;
+    unsigned filled = 0;
+    size_t pos = 0;
+    for (size_t i = 0; i < n; ++i)
+    {
+        acc |= values[i] << filled;
+        if (filled + width >= 64)
+        {
+            bytes::encode<endian::little>(buffer + pos, acc);
+            pos += 8;
+            // Bits of the value which did not fit in the word
+            acc = filled == 0 ? 0 : values[i] >> (64 - filled);
+            filled = filled + width - 64;
+        }
+        else
+        {
+            filled += width;
+        }
+    }
+    for (; filled > 0; filled = filled > 8 ? filled - 8 : 0, acc >>= 8)
+        buffer[pos++] = static_cast<uint8_t>(acc);
+    return pos;
+}
+
+#if DATAPACKER_X86_SIMD
+// Reads the first values packed by pack_bits 4 at a time with a gather, and returns the number of
+// values which were read. Each value is within the 8 bytes starting at the byte which contains its
+// first bit, so `width` should be atmost 57
+DATAPACKER_TARGET("avx2")
+inline size_t unpack_bits_avx2(const uint8_t *buffer, uint64_t *values, size_t n, unsigned width,
+                               uint64_t mask)
+{
+    const __m256i vmask = _mm256_set1_epi64x(static_cast<long long>(mask));
+    const __m256i step = _mm256_set1_epi64x(static_cast<long long>(4 * width));
+    const __m256i seven = _mm256_set1_epi64x(7);
+    __m256i bit = _mm256_setr_epi64x(0, width, 2 * width, 3 * width);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        __m256i offset = _mm256_srli_epi64(bit, 3);
+        __m256i words =
+            _mm256_i64gather_epi64(reinterpret_cast<const long long *>(buffer), offset, 1);
+        words = _mm256_srlv_epi64(words, _mm256_and_si256(bit, seven));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(values + i),
+                            _mm256_and_si256(words, vmask));
+        bit = _mm256_add_epi64(bit, step);
+    }
+    return i;
+}
+#endif
+
+// Reads the values from index `first` to `n - 1` packed by pack_bits, one at a time
+inline void unpack_bits_scalar(const uint8_t *buffer, uint64_t *values, size_t first, size_t n,
+                               unsigned width, uint64_t mask)
+{
+    for (size_t i = first; i < n; ++i)
+    {
+        size_t bit = i * width;
+        unsigned shift = static_cast<unsigned>(bit & 7);
+        uint64_t word;
+        bytes::decode<endian::little>(buffer + bit / 8, word);
+        uint64_t value = word >> shift;
+        if (shift + width > 64)
+            value |= static_cast<uint64_t>(buffer[bit / 8 + 8]) << (64 - shift);
+        values[i] = value & mask;
+    }
+}
+
+// Reads `n` values packed by pack_bits. Atleast 9 bytes after the packed data should be
+// readable, their contents are ignored
+inline void unpack_bits(const uint8_t *buffer, uint64_t *values, size_t n, unsigned width)
+{
+    if (width == 0)
+    {
+        memset(values, 0, n * sizeof(uint64_t));
+        return;
+    }
+    const uint64_t mask = width == 64 ? ~uint64_t{0} : (uint64_t{1} << width) - 1;
+    size_t i = 0;
+#if DATAPACKER_X86_SIMD
+    if (width <= 57 && cpu_features() == x86_features::avx2)
+        i = unpack_bits_avx2(buffer, values, n, width, mask);
+#endif
+    unpack_bits_scalar(buffer, values, i, n, width, mask);
+}
+} // namespace internal
+
+namespace bytes
+{
+/**
+ * Stores each element with `sizeof(T)` bytes, in the same format as `encode_array`
+ */
+struct fixed_width_codec
+{
+    template <typename T> static constexpr size_t bound(size_t n)
+    {
+        return n * sizeof(T);
+    }
+
+    template <endian endianness, typename T>
+    static size_t encode(uint8_t *buffer, const T *arr, size_t n)
+    {
+        return static_cast<size_t>(encode_array<endianness>(buffer, arr, n));
+    }
+
+    template <endian endianness, typename T>
+    static int decode(const uint8_t *buffer, size_t size, T *arr, size_t n)
+    {
+        if (size < n * sizeof(T))
+            return -1;
+        return decode_array<endianness>(buffer, arr, n);
+    }
+};
+
+/**
+ * Stores the first element, followed by the difference of each element from the previous one,
+ * as ZigZag encoded varints (see `encode_varint`). Differences are computed with wrap around, so
+ * any sequence can be encoded, but unsorted sequences with large jumps take more space than with
+ * `fixed_width_codec`. The endianness is not used, since varints have a single byte order.
+ */
+struct delta_codec
+{
+    template <typename T> static constexpr size_t bound(size_t n)
+    {
+        return n * max_varint_size<T>;
+    }
+
+    template <endian endianness, typename T>
+    static size_t encode(uint8_t *buffer, const T *arr, size_t n)
+    {
+        static_assert(internal::is_codec_integer<T>, "delta_codec can only encode integers");
+        using uT = std::make_unsigned_t<T>;
+        using sT = std::make_signed_t<T>;
+        uT previous = 0;
+        size_t pos = 0;
+        for (size_t i = 0; i < n; ++i)
+        {
+            auto value = static_cast<uT>(arr[i]);
+            pos += static_cast<size_t>(
+                encode_varint(buffer + pos, static_cast<sT>(static_cast<uT>(value - previous))));
+            previous = value;
+        }
+        return pos;
+    }
+
+    template <endian endianness, typename T>
+    static int decode(const uint8_t *buffer, size_t size, T *arr, size_t n)
+    {
+        static_assert(internal::is_codec_integer<T>, "delta_codec can only decode integers");
+        using uT = std::make_unsigned_t<T>;
+        using sT = std::make_signed_t<T>;
+        uT previous = 0;
+        size_t pos = 0;
+        for (size_t i = 0; i < n; ++i)
+        {
+            sT delta;
+            int count = decode_varint(buffer + pos, size - pos, delta);
+            if (count == -1)
+                return -1;
+            pos += static_cast<size_t>(count);
+            previous = static_cast<uT>(previous + static_cast<uT>(delta));
+            arr[i] = static_cast<T>(previous);
+        }
+        return static_cast<int>(pos);
+    }
+};
+
+/**
+ * Splits the array into blocks of `FRAME_OF_REFERENCE_BLOCK_SIZE` elements (the last block may
+ * be smaller). Each block stores its smallest element with `sizeof(T)` bytes, then the number of
+ * bits `b` needed for the largest difference from it in one byte, and then the difference of
+ * every element from the smallest one with `b` bits, starting from the lowest bit of the first
+ * byte. Unpacking uses AVX2 gathers when the target supports them.
+ */
+struct frame_of_reference_codec
+{
+    template <typename T> static constexpr size_t bound(size_t n)
+    {
+        size_t blocks = (n + FRAME_OF_REFERENCE_BLOCK_SIZE - 1) / FRAME_OF_REFERENCE_BLOCK_SIZE;
+        return blocks * (sizeof(T) + 1) + n * sizeof(T);
+    }
+
+    template <endian endianness, typename T>
+    static size_t encode(uint8_t *buffer, const T *arr, size_t n)
+    {
+        static_assert(internal::is_codec_integer<T>,
+                      "frame_of_reference_codec can only encode integers");
+        using uT = std::make_unsigned_t<T>;
+        uint64_t offsets[FRAME_OF_REFERENCE_BLOCK_SIZE];
+        size_t pos = 0;
+        for (size_t start = 0; start < n; start += FRAME_OF_REFERENCE_BLOCK_SIZE)
+        {
+            size_t count = n - start < FRAME_OF_REFERENCE_BLOCK_SIZE
+                               ? n - start
+                               : FRAME_OF_REFERENCE_BLOCK_SIZE;
+            T low = arr[start];
+            T high = arr[start];
+            for (size_t i = 1; i < count; ++i)
+            {
+                low = arr[start + i] < low ? arr[start + i] : low;
+                high = arr[start + i] > high ? arr[start + i] : high;
+            }
+            auto base = static_cast<uT>(low);
+            for (size_t i = 0; i < count; ++i)
+                offsets[i] = static_cast<uT>(static_cast<uT>(arr[start + i]) - base);
+            auto range = static_cast<uT>(static_cast<uT>(high) - base);
+            auto width = static_cast<unsigned>(std::bit_width(range));
+            pos += static_cast<size_t>(bytes::encode<endianness>(buffer + pos, low));
+            buffer[pos++] = static_cast<uint8_t>(width);
+            pos += internal::pack_bits(buffer + pos, offsets, count, width);
+        }
+        return pos;
+    }
+
+    template <endian endianness, typename T>
+    static int decode(const uint8_t *buffer, size_t size, T *arr, size_t n)
+    {
+        static_assert(internal::is_codec_integer<T>,
+                      "frame_of_reference_codec can only decode integers");
+        using uT = std::make_unsigned_t<T>;
+        uint64_t offsets[FRAME_OF_REFERENCE_BLOCK_SIZE];
+        // The last blocks are copied here, so that unpacking can read past their end
+        uint8_t padded[FRAME_OF_REFERENCE_BLOCK_SIZE * sizeof(T) + 16];
+        size_t pos = 0;
+        for (size_t start = 0; start < n; start += FRAME_OF_REFERENCE_BLOCK_SIZE)
+        {
+            size_t count = n - start < FRAME_OF_REFERENCE_BLOCK_SIZE
+                               ? n - start
+                               : FRAME_OF_REFERENCE_BLOCK_SIZE;
+            if (size - pos < sizeof(T) + 1)
+                return -1;
+            T low;
+            pos += static_cast<size_t>(bytes::decode<endianness>(buffer + pos, low));
+            unsigned width = buffer[pos++];
+            if (width > sizeof(T) * 8)
+                return -1;
+            size_t packed = (count * width + 7) / 8;
+            if (size - pos < packed)
+                return -1;
+            const uint8_t *data = buffer + pos;
+            if (size - pos < packed + 16)
+            {
+                memcpy(padded, data, packed);
+                memset(padded + packed, 0, 16);
+                data = padded;
+            }
+            internal::unpack_bits(data, offsets, count, width);
+            for (size_t i = 0; i < count; ++i)
+                arr[start + i] = static_cast<T>(static_cast<uT>(static_cast<uT>(low) + offsets[i]));
+            pos += packed;
+        }
+        return static_cast<int>(pos);
+    }
+};
+
+/**
+ * @brief Largest number of bytes which `encode_integers` writes for `n` elements of type `T`
+ */
+template <typename Codec, typename T, typename Prefix = size_t>
+constexpr size_t integers_bound(size_t n)
+{
+    return length_prefix<Prefix>::max_size + Codec::template bound<T>(n);
+}
+
+/**
+ * @brief Encodes a vector of integers with a length prefix, using one of `fixed_width_codec`,
+ * `delta_codec` or `frame_of_reference_codec`
+ * @tparam Codec The encoding of the elements
+ * @tparam endianness The endianness to use for the prefix and for fixed width values
+ * @tparam Prefix Integer type of the length prefix, or `varint_prefix`
+ * @return The number of bytes written to the buffer, or -1 if the length of the vector cannot be
+ * stored in the prefix
+ * @note `buffer` should have size atleast equal to `integers_bound<Codec, T, Prefix>(v.size())`
+ */
+template <typename Codec, endian endianness, typename Prefix = size_t, typename T,
+          typename Allocator>
+inline int encode_integers(uint8_t *buffer, const std::vector<T, Allocator> &v)
+{
+    if (v.size() > length_prefix<Prefix>::max_length)
+        return -1;
+    int n = length_prefix<Prefix>::template encode<endianness>(buffer, v.size());
+    return n + static_cast<int>(
+                   Codec::template encode<endianness>(buffer + n, v.data(), v.size()));
+}
+
+/**
+ * @brief Decodes a vector written by `encode_integers` with the same codec
+ * @param size Number of bytes available in the buffer
+ * @param max_length The maximum length of the vector
+ * @return The number of bytes read from the buffer, or -1 if the buffer is truncated or invalid,
+ * or if the length exceeds max_length
+ * @note `v` is resized before the elements are decoded, so its contents are unspecified if -1 is
+ * returned after the prefix was read
+ */
+template <typename Codec, endian endianness, typename Prefix = size_t, typename T,
+          typename Allocator>
+inline int decode_integers(const uint8_t *buffer, size_t size, std::vector<T, Allocator> &v,
+                           size_t max_length)
+{
+    size_t length;
+    int n = length_prefix<Prefix>::template decode<endianness>(buffer, size, length);
+    if (n == -1 || length > max_length)
+        return -1;
+    v.resize(length);
+    int count = Codec::template decode<endianness>(buffer + n, size - static_cast<size_t>(n),
+                                                   v.data(), length);
+    return count == -1 ? -1 : n + count;
+}
+} // namespace bytes
+} // namespace datapacker
+#endif // A_DATAPACKER_INTEGER_CODECS_H
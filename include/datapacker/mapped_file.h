@@ -0,0 +1,274 @@
+/**
+ * @file mapped_file.h
+ * @brief Read only memory mapped files, which can be decoded in place with `bytes::reader`
+ *
+ * Uses `mmap` on POSIX systems and `MapViewOfFile` on Windows. The file is mapped once, and the
+ * `bytes::decode*` functions then read directly from the page cache, without copying the data
+ * into a buffer or going through an `istream`.
+ * @note
+ * - The file should not be truncated by another process while it is mapped, reading a page past
+ *   the new end of the file raises `SIGBUS` on POSIX systems
+ */
+#ifndef A_DATAPACKER_MAPPED_FILE_H
+#define A_DATAPACKER_MAPPED_FILE_H
+#include "../datapacker.h"
+#include <system_error>
+
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace datapacker
+{
+
+/**
+ * @brief How a mapped file will be accessed, used as a hint to the operating system
+ */
+enum class access_pattern
+{
+    // Default read ahead
+    normal = 0,
+    // Pages are read aggressively ahead, and can be dropped soon after they have been accessed
+    sequential = 1,
+    // Pages are not read ahead
+    random = 2,
+    // Pages are expected to be accessed soon, so they are read in the background
+    willneed = 3
+};
+
+/**
+ * @brief A file mapped read only into memory.
+ *
+ * @code
+ * datapacker::mapped_file file("capture.bin", datapacker::access_pattern::sequential);
+ * auto r = file.reader();
+ * uint64_t timestamp;
+ * while (r.get<endian::little>(timestamp))
+ *     ...
+ * @endcode
+ *
+ * A `std::system_error` is thrown if the file cannot be opened or mapped. An empty file has no
+ * mapping, `data()` is `nullptr` and `size()` is 0. The mapping is released when the object is
+ * destroyed, so readers and views obtained from it should not outlive it.
+ */
+class mapped_file
+{
+  public:
+    /**
+     * @brief Maps the whole file at `path`
+     * @param path Path of the file
+     * @param pattern Expected access pattern of the file, see `advise`
+     */
+    explicit mapped_file(const char *path, access_pattern pattern = access_pattern::normal)
+    {
+#if defined(_WIN32)
+        DWORD flags = FILE_ATTRIBUTE_NORMAL;
+        if (pattern == access_pattern::sequential)
+            flags |= FILE_FLAG_SEQUENTIAL_SCAN;
+        else if (pattern == access_pattern::random)
+            flags |= FILE_FLAG_RANDOM_ACCESS;
+        HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                                  flags, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+            fail("Could not open file", GetLastError());
+        LARGE_INTEGER file_size;
+        if (!GetFileSizeEx(file, &file_size))
+        {
+            DWORD error = GetLastError();
+            CloseHandle(file);
+            fail("Could not determine the size of the file", error);
+        }
+        if (static_cast<unsigned long long>(file_size.QuadPart) > SIZE_MAX)
+        {
+            CloseHandle(file);
+            fail("File is too large to be mapped", ERROR_FILE_TOO_LARGE);
+        }
+        length = static_cast<size_t>(file_size.QuadPart);
+        if (length > 0)
+        {
+            HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            DWORD error = GetLastError();
+            CloseHandle(file);
+            if (!mapping)
+                fail("Could not map file", error);
+            // The view keeps the mapping open
+            void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            error = GetLastError();
+            CloseHandle(mapping);
+            if (!view)
+                fail("Could not map file", error);
+            ptr = static_cast<const uint8_t *>(view);
+        }
+        else
+        {
+            CloseHandle(file);
+        }
+#else
+        int fd;
+        do
+        {
+            fd = ::open(path, O_RDONLY | O_CLOEXEC);
+        } while (fd == -1 && errno == EINTR);
+        if (fd == -1)
+            fail("Could not open file", errno);
+        struct stat st;
+        if (fstat(fd, &st) == -1)
+        {
+            int error = errno;
+            ::close(fd);
+            fail("Could not determine the size of the file", error);
+        }
+        if (static_cast<unsigned long long>(st.st_size) > SIZE_MAX)
+        {
+            ::close(fd);
+            fail("File is too large to be mapped", EFBIG);
+        }
+        length = static_cast<size_t>(st.st_size);
+        if (length > 0)
+        {
+            void *view = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+            int error = errno;
+            // The mapping stays valid after the descriptor is closed
+            ::close(fd);
+            if (view == MAP_FAILED)
+                fail("Could not map file", error);
+            ptr = static_cast<const uint8_t *>(view);
+            advise(pattern);
+        }
+        else
+        {
+            ::close(fd);
+        }
+#endif
+    }
+
+    explicit mapped_file(const std::string &path, access_pattern pattern = access_pattern::normal)
+        : mapped_file(path.c_str(), pattern)
+    {
+    }
+
+    mapped_file(const mapped_file &) = delete;
+    mapped_file &operator=(const mapped_file &) = delete;
+
+    mapped_file(mapped_file &&other) noexcept
+        : ptr(std::exchange(other.ptr, nullptr)), length(std::exchange(other.length, 0))
+    {
+    }
+
+    mapped_file &operator=(mapped_file &&other) noexcept
+    {
+        if (this != &other)
+        {
+            unmap();
+            ptr = std::exchange(other.ptr, nullptr);
+            length = std::exchange(other.length, 0);
+        }
+        return *this;
+    }
+
+    ~mapped_file()
+    {
+        unmap();
+    }
+
+    /**
+     * @brief Hints how `length` bytes starting at `offset` will be accessed, which is the whole
+     * file by default. The hint is ignored if it is not supported.
+     * @note On Windows, only the pattern passed to the constructor is used
+     */
+    void advise(access_pattern pattern, size_t offset = 0, size_t size = SIZE_MAX) const
+    {
+#if !defined(_WIN32)
+        if (!ptr || offset >= length)
+            return;
+        if (size > length - offset)
+            size = length - offset;
+        // madvise requires the address to be aligned to a page boundary
+        size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        size_t aligned = offset - offset % page_size;
+        int advice = MADV_NORMAL;
+        if (pattern == access_pattern::sequential)
+            advice = MADV_SEQUENTIAL;
+        else if (pattern == access_pattern::random)
+            advice = MADV_RANDOM;
+        else if (pattern == access_pattern::willneed)
+            advice = MADV_WILLNEED;
+        madvise(const_cast<uint8_t *>(ptr) + aligned, size + offset - aligned, advice);
+#else
+        (void)pattern;
+        (void)offset;
+        (void)size;
+#endif
+    }
+
+    /**
+     * @brief Returns a `bytes::reader` over the whole file
+     */
+    bytes::reader reader() const
+    {
+        return bytes::reader(ptr, length);
+    }
+
+    const uint8_t *data() const
+    {
+        return ptr;
+    }
+
+    size_t size() const
+    {
+        return length;
+    }
+
+    bool empty() const
+    {
+        return length == 0;
+    }
+
+    std::span<const uint8_t> bytes() const
+    {
+        return std::span<const uint8_t>(ptr, length);
+    }
+
+  private:
+    const uint8_t *ptr = nullptr;
+    size_t length = 0;
+
+    void unmap()
+    {
+        if (!ptr)
+            return;
+#if defined(_WIN32)
+        UnmapViewOfFile(ptr);
+#else
+        munmap(const_cast<uint8_t *>(ptr), length);
+#endif
+        ptr = nullptr;
+        length = 0;
+    }
+
+#if defined(_WIN32)
+    [[noreturn]] static void fail(const char *message, DWORD error)
+    {
+        throw std::system_error(static_cast<int>(error), std::system_category(), message);
+    }
+#else
+    [[noreturn]] static void fail(const char *message, int error)
+    {
+        throw std::system_error(error, std::generic_category(), message);
+    }
+#endif
+};
+
+} // namespace datapacker
+#endif // A_DATAPACKER_MAPPED_FILE_H
@@ -0,0 +1,144 @@
+/**
+ * @file offset_index.h
+ * @brief Index of the offsets at which the records of a stream or a buffer start, for random
+ * access to records without scanning the data again
+ *
+ * The index is built by scanning the data once, skipping over each record with `stream::skip` or
+ * `bytes::reader::skip_length_prefixed`, and can be stored with the data to avoid the scan later.
+ *
+ * @code
+ * auto index = datapacker::offset_index::build(is, [](std::istream &is) {
+ *     stream::skip<endian::little, uint64_t>(is);
+ *     stream::skip<endian::little, std::string>(is);
+ * });
+ * index.seek(is, 1000);
+ * stream::read<endian::little>(is, key);
+ * @endcode
+ */
+#ifndef A_DATAPACKER_OFFSET_INDEX_H
+#define A_DATAPACKER_OFFSET_INDEX_H
+#include "../datapacker.h"
+
+namespace datapacker
+{
+/**
+ * @brief Offsets in bytes of records from the start of a stream or a buffer, in order. Offsets in
+ * a stream are positions returned by `tellg`, and offsets in a buffer are positions of the reader.
+ */
+class offset_index
+{
+  public:
+    offset_index() = default;
+
+    /**
+     * @brief Creates an index from offsets which were saved earlier, for example with
+     * `stream::write<endian::little>(os, index.offsets())`
+     */
+    explicit offset_index(std::vector<uint64_t> record_offsets) : starts(std::move(record_offsets))
+    {
+    }
+
+    /**
+     * @brief Builds the index of a seekable stream, by calling `skip_record(is)` at the start of
+     * every record until the end of the stream. A record which ends early is not included, and
+     * the index ends at the first record for which `skip_record` does not move the stream.
+     * @note Throws a `std::runtime_error` if the stream is not seekable
+     */
+    template <typename SkipRecord>
+    static offset_index build(std::istream &is, SkipRecord &&skip_record)
+    {
+        std::streampos start = is.tellg();
+        if (start == std::streampos(-1))
+            throw std::runtime_error("The offset index can only be built for seekable streams");
+        is.seekg(0, std::ios_base::end);
+        std::streampos end = is.tellg();
+        is.seekg(start);
+        offset_index index;
+        while (is && start < end)
+        {
+            skip_record(is);
+            // Seeking past the end of a file does not fail the stream, so the position is checked
+            std::streampos next = is ? is.tellg() : std::streampos(-1);
+            if (next == std::streampos(-1) || next > end || next == start)
+                break;
+            index.add(static_cast<uint64_t>(static_cast<std::streamoff>(start)));
+            start = next;
+        }
+        return index;
+    }
+
+    /**
+     * @brief Builds the index of the records read by `r`, by calling `skip_record(r)` at the start
+     * of every record until no bytes remain. A record which does not fit in the buffer is not
+     * included, and `r` is in a failed state after it. The index also ends at the first record for
+     * which `skip_record` does not move the reader.
+     */
+    template <typename SkipRecord>
+    static offset_index build(bytes::reader &r, SkipRecord &&skip_record)
+    {
+        offset_index index;
+        while (r && r.remaining() > 0)
+        {
+            size_t start = r.position();
+            skip_record(r);
+            if (!r || r.position() == start)
+                break;
+            index.add(start);
+        }
+        return index;
+    }
+
+    // Adds the offset of the next record, offsets should be added in increasing order
+    void add(uint64_t offset)
+    {
+        starts.push_back(offset);
+    }
+
+    // Number of records in the index
+    size_t size() const
+    {
+        return starts.size();
+    }
+
+    bool empty() const
+    {
+        return starts.empty();
+    }
+
+    uint64_t operator[](size_t i) const
+    {
+        return starts[i];
+    }
+
+    const std::vector<uint64_t> &offsets() const
+    {
+        return starts;
+    }
+
+    /**
+     * @brief Clears the state of the stream and moves it to the start of record `i`
+     * @return `is`
+     */
+    std::istream &seek(std::istream &is, size_t i) const
+    {
+        is.clear();
+        return is.seekg(static_cast<std::streamoff>(starts.at(i)));
+    }
+
+    /**
+     * @brief Creates a reader over record `i` and the records after it in `buffer`, which should
+     * be the buffer the index was built from
+     */
+    bytes::reader reader(const uint8_t *buffer, size_t size, size_t i) const
+    {
+        size_t start = static_cast<size_t>(starts.at(i));
+        if (start > size)
+            start = size;
+        return bytes::reader(buffer + start, size - start);
+    }
+
+  private:
+    std::vector<uint64_t> starts;
+};
+} // namespace datapacker
+#endif // A_DATAPACKER_OFFSET_INDEX_H
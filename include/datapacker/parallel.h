@@ -0,0 +1,259 @@
+/**
+ * @file parallel.h
+ * @brief Encoding and decoding of large arrays on multiple threads
+ *
+ * Elements of an array are at fixed offsets, so an array is split into chunks of about
+ * `PARALLEL_CHUNK_SIZE` bytes which are encoded/decoded independently, either with a standard
+ * execution policy or with an executor supplied by the caller.
+ * @note With libstdc++, parallel execution policies may require linking with TBB (`-ltbb`)
+ */
+#ifndef A_DATAPACKER_PARALLEL_H
+#define A_DATAPACKER_PARALLEL_H
+#include "../datapacker.h"
+#include <algorithm>
+#include <concepts>
+#include <compare>
+#include <execution>
+#include <iterator>
+
+namespace datapacker
+{
+// Arrays smaller than this number of bytes are encoded/decoded on the calling thread
+constexpr size_t PARALLEL_THRESHOLD = 1024 * 1024;
+// Size in bytes of the chunks of an array which are processed by a single task, chosen so that
+// a chunk and its encoded form fit in the L2 cache of a core
+constexpr size_t PARALLEL_CHUNK_SIZE = 256 * 1024;
+
+namespace internal
+{
+// A task which captures state, like the lambdas that run_chunked passes to executors
+struct capturing_task
+{
+    void *state;
+
+    void operator()(size_t) const
+    {
+    }
+};
+
+/**
+ * An executor which runs `task(i)` for every `i` in `[0, count)`, possibly concurrently, and
+ * returns only after all of them have completed. For example, a thread pool's parallel for. The
+ * task is a lambda with captures, so the executor should accept any callable, for example as a
+ * template parameter or a `std::function<void(size_t)>`.
+ */
+template <typename Executor>
+concept bulk_executor = requires(Executor &executor) { executor(size_t{}, capturing_task{}); };
+
+// Splits `n` elements of type T into chunks, and calls `body(begin, count)` for every chunk using
+// `launch(chunks, task)`. Runs `body` on the calling thread if the array is below the threshold
+template <typename T, typename Launch, typename Body>
+inline void run_chunked(size_t n, size_t threshold, Launch &&launch, Body &&body)
+{
+    constexpr size_t per_chunk = PARALLEL_CHUNK_SIZE / sizeof(T) ? PARALLEL_CHUNK_SIZE / sizeof(T)
+                                                                  : 1;
+    if (n / per_chunk < 2 || n < threshold / sizeof(T))
+    {
+        body(size_t{0}, n);
+        return;
+    }
+    size_t chunks = (n + per_chunk - 1) / per_chunk;
+    launch(chunks, [&](size_t i) {
+        size_t begin = i * per_chunk;
+        body(begin, per_chunk < n - begin ? per_chunk : n - begin);
+    });
+}
+
+/**
+ * Random access iterator over the indices `[0, count)`, so that tasks can be launched without
+ * allocating an array of indices. The iterators of `std::views::iota` are only input iterators
+ * for the standard algorithms, which run the algorithm sequentially for them.
+ */
+class index_iterator
+{
+  public:
+    using iterator_category = std::random_access_iterator_tag;
+    using value_type = size_t;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = size_t;
+
+    index_iterator() = default;
+
+    explicit index_iterator(size_t index) : i(index)
+    {
+    }
+
+    reference operator*() const
+    {
+        return i;
+    }
+
+    reference operator[](difference_type n) const
+    {
+        return i + static_cast<size_t>(n);
+    }
+
+    index_iterator &operator++()
+    {
+        ++i;
+        return *this;
+    }
+
+    index_iterator operator++(int)
+    {
+        return index_iterator(i++);
+    }
+
+    index_iterator &operator--()
+    {
+        --i;
+        return *this;
+    }
+
+    index_iterator operator--(int)
+    {
+        return index_iterator(i--);
+    }
+
+    index_iterator &operator+=(difference_type n)
+    {
+        i += static_cast<size_t>(n);
+        return *this;
+    }
+
+    index_iterator &operator-=(difference_type n)
+    {
+        i -= static_cast<size_t>(n);
+        return *this;
+    }
+
+    friend index_iterator operator+(index_iterator it, difference_type n)
+    {
+        return it += n;
+    }
+
+    friend index_iterator operator+(difference_type n, index_iterator it)
+    {
+        return it += n;
+    }
+
+    friend index_iterator operator-(index_iterator it, difference_type n)
+    {
+        return it -= n;
+    }
+
+    friend difference_type operator-(index_iterator a, index_iterator b)
+    {
+        return static_cast<difference_type>(a.i - b.i);
+    }
+
+    friend bool operator==(index_iterator a, index_iterator b) = default;
+    friend auto operator<=>(index_iterator a, index_iterator b) = default;
+
+  private:
+    size_t i = 0;
+};
+static_assert(std::random_access_iterator<index_iterator>);
+
+// Runs `task(i)` for every `i` in `[0, count)` with the execution policy
+template <typename ExecutionPolicy> struct policy_launcher
+{
+    ExecutionPolicy &policy;
+
+    template <typename Task> void operator()(size_t count, Task &&task) const
+    {
+        std::for_each(policy, index_iterator(0), index_iterator(count), task);
+    }
+};
+} // namespace internal
+
+namespace bytes
+{
+/**
+ * @brief Encodes an array like `encode_array`, splitting the work using an execution policy
+ *
+ * @code
+ * bytes::encode_array_parallel<endian::little>(std::execution::par, buffer, v.data(), v.size());
+ * @endcode
+ *
+ * @tparam endianness The endianness to use for encoding
+ * @param policy Standard execution policy, such as `std::execution::par`
+ * @param buffer The buffer where the encoded data will be stored
+ * @param arr The array of elements to encode
+ * @param n The number of elements in the array
+ * @param threshold Arrays smaller than this number of bytes are encoded on the calling thread
+ * @return The number of bytes written to the buffer
+ * @note buffer should be of size atleast equal to `sizeof(T) * n`
+ */
+template <endian endianness, typename ExecutionPolicy, typename T>
+    requires std::is_execution_policy_v<std::remove_cvref_t<ExecutionPolicy>>
+inline size_t encode_array_parallel(ExecutionPolicy &&policy, uint8_t *buffer, const T *arr,
+                                    size_t n, size_t threshold = PARALLEL_THRESHOLD)
+{
+    internal::run_chunked<T>(n, threshold, internal::policy_launcher<ExecutionPolicy>{policy},
+                             [&](size_t begin, size_t count) {
+                                 encode_array<endianness>(buffer + begin * sizeof(T), arr + begin,
+                                                          count);
+                             });
+    return n * sizeof(T);
+}
+
+/**
+ * @brief Encodes an array like `encode_array`, splitting the work using `executor`, which is
+ * called as `executor(count, task)` and should run `task(i)` for every `i` in `[0, count)`
+ * before returning
+ */
+template <endian endianness, typename Executor, typename T>
+    requires internal::bulk_executor<Executor>
+inline size_t encode_array_parallel(Executor &&executor, uint8_t *buffer, const T *arr, size_t n,
+                                    size_t threshold = PARALLEL_THRESHOLD)
+{
+    internal::run_chunked<T>(n, threshold, executor, [&](size_t begin, size_t count) {
+        encode_array<endianness>(buffer + begin * sizeof(T), arr + begin, count);
+    });
+    return n * sizeof(T);
+}
+
+/**
+ * @brief Decodes an array like `decode_array`, splitting the work using an execution policy
+ *
+ * @tparam endianness The endianness of the data
+ * @param policy Standard execution policy, such as `std::execution::par`
+ * @param buffer The buffer containing the encoded elements
+ * @param arr Pointer to the array where the decoded elements will be stored
+ * @param n The number of elements to decode
+ * @param threshold Arrays smaller than this number of bytes are decoded on the calling thread
+ * @return The number of bytes read from the buffer
+ * @note buffer should be of size atleast equal to `sizeof(T) * n`
+ */
+template <endian endianness, typename ExecutionPolicy, typename T>
+    requires std::is_execution_policy_v<std::remove_cvref_t<ExecutionPolicy>>
+inline size_t decode_array_parallel(ExecutionPolicy &&policy, const uint8_t *buffer, T *arr,
+                                    size_t n, size_t threshold = PARALLEL_THRESHOLD)
+{
+    internal::run_chunked<T>(n, threshold, internal::policy_launcher<ExecutionPolicy>{policy},
+                             [&](size_t begin, size_t count) {
+                                 decode_array<endianness>(buffer + begin * sizeof(T), arr + begin,
+                                                          count);
+                             });
+    return n * sizeof(T);
+}
+
+/**
+ * @brief Decodes an array like `decode_array`, splitting the work using `executor`, see
+ * `encode_array_parallel`
+ */
+template <endian endianness, typename Executor, typename T>
+    requires internal::bulk_executor<Executor>
+inline size_t decode_array_parallel(Executor &&executor, const uint8_t *buffer, T *arr, size_t n,
+                                    size_t threshold = PARALLEL_THRESHOLD)
+{
+    internal::run_chunked<T>(n, threshold, executor, [&](size_t begin, size_t count) {
+        decode_array<endianness>(buffer + begin * sizeof(T), arr + begin, count);
+    });
+    return n * sizeof(T);
+}
+} // namespace bytes
+} // namespace datapacker
+#endif // A_DATAPACKER_PARALLEL_H
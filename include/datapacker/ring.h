@@ -0,0 +1,291 @@
+/**
+ * @file ring.h
+ * @brief Lock-free ring buffer of length-prefixed messages, for passing encoded messages between
+ * threads without allocating or copying them
+ *
+ * A producer reserves a contiguous slot in the ring and encodes the message directly into it with
+ * a `bytes::writer`, and the consumer decodes it from the ring with a `bytes::reader`. The memory
+ * of the ring is allocated once, when it is constructed.
+ *
+ * @code
+ * datapacker::ring<> queue(1 << 20);
+ * // Producer thread
+ * queue.push(64, [&](bytes::writer &w) { w.put<endian::little>(id, price, quantity); });
+ * // Consumer thread
+ * queue.try_pop([&](bytes::reader &r) { r.get<endian::little>(id, price, quantity); });
+ * @endcode
+ */
+#ifndef A_DATAPACKER_RING_H
+#define A_DATAPACKER_RING_H
+#include "../datapacker.h"
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <thread>
+
+namespace datapacker
+{
+/**
+ * @brief Number of threads which may push messages into a `ring` at the same time
+ */
+enum class ring_producers
+{
+    single,
+    multiple
+};
+
+/**
+ * @brief A bounded queue of messages stored in a single block of memory, for one consumer thread
+ * and one (`ring_producers::single`) or many (`ring_producers::multiple`) producer threads
+ *
+ * Each message is stored as a frame, with an 8 byte header which has the size of the frame and
+ * the length of the message as 32 bit integers, followed by the message. Frames start at
+ * multiples of 8 bytes and are contiguous, when a frame does not fit before the end of the ring,
+ * the rest of the ring is skipped with a padding frame.
+ *
+ * Producers reserve `max_size` bytes for a message, and the message is then encoded in place.
+ * With multiple producers, the space is reserved with an atomic fetch-add (`push`) or with a
+ * compare-and-swap (`try_push`), and each frame is published by an atomic store to its header.
+ * Messages from a producer are popped in the order in which they were pushed.
+ */
+template <ring_producers producers = ring_producers::single> class ring
+{
+  public:
+    /**
+     * @param capacity Size of the ring in bytes, rounded up to a power of 2 between 64 bytes and
+     * 1 GiB
+     */
+    explicit ring(size_t capacity)
+        : size(std::bit_ceil(std::clamp(capacity, size_t(64), MAX_CAPACITY))), mask(size - 1),
+          storage(new uint32_t[size / sizeof(uint32_t)]())
+    {
+    }
+
+    ring(const ring &) = delete;
+    ring &operator=(const ring &) = delete;
+
+    size_t capacity() const
+    {
+        return size;
+    }
+
+    /**
+     * @brief Largest `max_size` which can be passed to `push` and `try_push`
+     */
+    size_t max_message_size() const
+    {
+        return size - HEADER_SIZE;
+    }
+
+    /**
+     * @brief Reserves a slot of `max_size` bytes if there is space in the ring, and calls
+     * `encode(writer)` with a `bytes::writer` over the slot
+     * @return false if the ring is full, if `max_size` is larger than `max_message_size()`, or if
+     * the writer failed because the message was larger than `max_size`, in which case the message
+     * is discarded
+     */
+    template <typename Encode> bool try_push(size_t max_size, Encode &&encode)
+    {
+        if (max_size > max_message_size())
+            return false;
+        size_t frame = frame_size(max_size);
+        while (true)
+        {
+            size_t pos = head.load(std::memory_order_relaxed);
+            size_t claimed;
+            if constexpr (producers == ring_producers::single)
+            {
+                claimed = claim_size(pos, frame);
+                if (!has_space(pos + claimed))
+                    return false;
+            }
+            else
+            {
+                do
+                {
+                    claimed = claim_size(pos, frame);
+                    if (!has_space(pos + claimed))
+                        return false;
+                } while (!head.compare_exchange_weak(pos, pos + claimed,
+                                                     std::memory_order_relaxed));
+            }
+            if (claimed == frame)
+                return write_frame(pos, frame, max_size, encode);
+            // The frame does not fit before the end of the ring, which is skipped
+            publish(pos, claimed, PADDING);
+        }
+    }
+
+    /**
+     * @brief Like `try_push`, but waits until there is space in the ring
+     * @return false if `max_size` is larger than `max_message_size()`, or if the writer failed
+     */
+    template <typename Encode> bool push(size_t max_size, Encode &&encode)
+    {
+        if (max_size > max_message_size())
+            return false;
+        size_t frame = frame_size(max_size);
+        while (true)
+        {
+            size_t pos;
+            size_t claimed;
+            if constexpr (producers == ring_producers::single)
+            {
+                pos = head.load(std::memory_order_relaxed);
+                claimed = claim_size(pos, frame);
+            }
+            else
+            {
+                // The end of the ring is not known before the fetch-add, so if the frame crosses
+                // it, the reserved space is turned into padding and space is reserved again
+                pos = head.fetch_add(frame, std::memory_order_relaxed);
+                claimed = frame;
+            }
+            while (!has_space(pos + claimed))
+                std::this_thread::yield();
+            size_t contiguous = size - (pos & mask);
+            if (contiguous >= frame)
+                return write_frame(pos, frame, max_size, encode);
+            publish(pos, contiguous, PADDING);
+            if constexpr (producers == ring_producers::multiple)
+                publish(pos + contiguous, frame - contiguous, PADDING);
+        }
+    }
+
+    /**
+     * @brief Calls `decode(reader)` with a `bytes::reader` over the oldest message, and then
+     * removes it from the ring. The message is decoded in place, and the slot is not reused until
+     * `decode` returns. Should only be called by the consumer thread.
+     * @return false if the ring is empty, or if the oldest message is still being encoded
+     */
+    template <typename Decode> bool try_pop(Decode &&decode)
+    {
+        size_t pos = tail.load(std::memory_order_relaxed);
+        while (true)
+        {
+            uint32_t frame;
+            if constexpr (producers == ring_producers::single)
+            {
+                if (pos == cached_head)
+                {
+                    cached_head = head.load(std::memory_order_acquire);
+                    if (pos == cached_head)
+                        return false;
+                }
+                frame = header(pos)[0];
+            }
+            else
+            {
+                frame = std::atomic_ref<uint32_t>(header(pos)[0]).load(std::memory_order_acquire);
+                if (frame == 0)
+                    return false;
+            }
+            uint32_t length = header(pos)[1];
+            if (length != PADDING)
+            {
+                bytes::reader r(data() + (pos & mask) + HEADER_SIZE, length);
+                decode(r);
+            }
+            if constexpr (producers == ring_producers::multiple)
+            {
+                // Headers of later frames are read as 0 until they are published
+                memset(data() + (pos & mask), 0, frame);
+            }
+            pos += frame;
+            tail.store(pos, std::memory_order_release);
+            if (length != PADDING)
+                return true;
+        }
+    }
+
+  private:
+    static constexpr size_t HEADER_SIZE = 8;
+    static constexpr size_t ALIGNMENT = 8;
+    // Length of a frame which does not contain a message
+    static constexpr uint32_t PADDING = 0xFFFFFFFF;
+    // Keeps the positions of the producers and the consumer in different cache lines
+    static constexpr size_t CACHE_LINE = 64;
+    // Sizes of frames are stored in 32 bits
+    static constexpr size_t MAX_CAPACITY = size_t(1) << 30;
+
+    const size_t size;
+    const size_t mask;
+    std::unique_ptr<uint32_t[]> storage;
+    // Positions are byte offsets which only increase, the offset in the ring is `pos & mask`
+    alignas(CACHE_LINE) std::atomic<size_t> head{0};
+    // Last value of `tail` seen by the producers
+    size_t cached_tail = 0;
+    alignas(CACHE_LINE) std::atomic<size_t> tail{0};
+    // Last value of `head` seen by the consumer, only used with a single producer
+    size_t cached_head = 0;
+
+    uint8_t *data()
+    {
+        return reinterpret_cast<uint8_t *>(storage.get());
+    }
+
+    uint32_t *header(size_t pos)
+    {
+        return storage.get() + (pos & mask) / sizeof(uint32_t);
+    }
+
+    static size_t frame_size(size_t max_size)
+    {
+        return (HEADER_SIZE + max_size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+    }
+
+    // Bytes to reserve at `pos` for a frame, which are the bytes till the end of the ring if the
+    // frame does not fit before it
+    size_t claim_size(size_t pos, size_t frame) const
+    {
+        size_t contiguous = size - (pos & mask);
+        return contiguous >= frame ? frame : contiguous;
+    }
+
+    // Checks if the consumer has freed the space before `end`
+    bool has_space(size_t end)
+    {
+        if constexpr (producers == ring_producers::single)
+        {
+            if (end - cached_tail <= size)
+                return true;
+            cached_tail = tail.load(std::memory_order_acquire);
+            return end - cached_tail <= size;
+        }
+        else
+        {
+            return end - tail.load(std::memory_order_acquire) <= size;
+        }
+    }
+
+    void publish(size_t pos, size_t frame, uint32_t length)
+    {
+        uint32_t *h = header(pos);
+        h[1] = length;
+        if constexpr (producers == ring_producers::single)
+        {
+            h[0] = static_cast<uint32_t>(frame);
+            head.store(pos + frame, std::memory_order_release);
+        }
+        else
+        {
+            std::atomic_ref<uint32_t>(h[0]).store(static_cast<uint32_t>(frame),
+                                                  std::memory_order_release);
+        }
+    }
+
+    template <typename Encode>
+    bool write_frame(size_t pos, size_t frame, size_t max_size, Encode &encode)
+    {
+        bytes::writer w(data() + (pos & mask) + HEADER_SIZE, max_size);
+        encode(w);
+        bool ok = w.good();
+        // With multiple producers the space has already been reserved, so a message which could
+        // not be encoded is published as padding, and skipped by the consumer
+        if (ok || producers == ring_producers::multiple)
+            publish(pos, frame, ok ? static_cast<uint32_t>(w.position()) : PADDING);
+        return ok;
+    }
+};
+} // namespace datapacker
+#endif // A_DATAPACKER_RING_H
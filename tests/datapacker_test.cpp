@@ -1,11 +1,40 @@
 #include "datapacker.h"
+#include "datapacker/async.h"
+#include "datapacker/checksum.h"
+#include "datapacker/compression.h"
+#include "datapacker/decoder.h"
+#include "datapacker/formats/bmp.h"
+#include "datapacker/formats/png.h"
+#include "datapacker/formats/wav.h"
+#include "datapacker/gather.h"
+#include "datapacker/integer_codecs.h"
+#include "datapacker/mapped_file.h"
+#include "datapacker/offset_index.h"
+#include "datapacker/parallel.h"
+#include "datapacker/ring.h"
+#include <filesystem>
+#include <fstream>
 #include <gtest/gtest.h>
 #include <math.h>
+#include <memory_resource>
+#include <sstream>
+#include <thread>
 #include <vector>
 
 using namespace datapacker::bytes;
-#define encode_length_prefixed datapacker::bytes::encode_length_prefixed<datapacker::endian::big>
-#define decode_length_prefixed datapacker::bytes::decode_length_prefixed<datapacker::endian::big>
+
+// Most of the tests encode and decode length prefixed values in big endian
+template <typename... Args> auto encode_length_prefixed(Args &&...args)
+{
+    return datapacker::bytes::encode_length_prefixed<datapacker::endian::big>(
+        std::forward<Args>(args)...);
+}
+
+template <typename... Args> auto decode_length_prefixed(Args &&...args)
+{
+    return datapacker::bytes::decode_length_prefixed<datapacker::endian::big>(
+        std::forward<Args>(args)...);
+}
 
 TEST(EncodingOfIntegers, SingleByte)
 {
@@ -131,6 +160,48 @@ TEST(EncodingOfIntegers, EightBytes)
         EXPECT_EQ(buffer[i], 0);
 }
 
+template <typename T> void check_shift_fallbacks(T value)
+{
+    using namespace datapacker;
+    uint8_t fast[sizeof(T)], portable[sizeof(T)];
+    encode_le(fast, value);
+    internal::encode_le_shifts(portable, value);
+    EXPECT_EQ(memcmp(fast, portable, sizeof(T)), 0);
+    T decoded = 0;
+    internal::decode_le_shifts(fast, decoded);
+    EXPECT_EQ(decoded, value);
+
+    encode_be(fast, value);
+    internal::encode_be_shifts(portable, value);
+    EXPECT_EQ(memcmp(fast, portable, sizeof(T)), 0);
+    decoded = 0;
+    internal::decode_be_shifts(fast, decoded);
+    EXPECT_EQ(decoded, value);
+}
+
+TEST(EncodingOfIntegers, NativeAndShiftPaths)
+{
+    check_shift_fallbacks<uint8_t>(0xA5);
+    check_shift_fallbacks<int16_t>(-12345);
+    check_shift_fallbacks<uint32_t>(0xDEADBEEF);
+    check_shift_fallbacks<int64_t>(-0x0123456789ABCDEF);
+    check_shift_fallbacks<uint64_t>(0xFEDCBA9876543210);
+
+    // Unaligned buffers
+    uint8_t buffer[16] = {0};
+    uint64_t value = 0;
+    encode_be(buffer + 3, uint64_t(0x0102030405060708));
+    EXPECT_EQ(buffer[3], 0x01);
+    EXPECT_EQ(buffer[10], 0x08);
+    decode_be(buffer + 3, value);
+    EXPECT_EQ(value, 0x0102030405060708);
+    encode_le(buffer + 1, uint32_t(0x0A0B0C0D));
+    EXPECT_EQ(buffer[1], 0x0D);
+    uint32_t small = 0;
+    decode_le(buffer + 1, small);
+    EXPECT_EQ(small, 0x0A0B0C0D);
+}
+
 TEST(DecodingOfIntegers, SingleByte)
 {
     int8_t a = -72, a1;
@@ -323,6 +394,99 @@ TEST(RealNumberTests, DoublePackingAndUnpacking)
     }
 }
 
+TEST(RealNumberTests, SpecialValues)
+{
+    if (!datapacker::internal::native_ieee754)
+        GTEST_SKIP() << "NaN and infinity are not supported by the portable float codec";
+    uint8_t buffer[8];
+    float f;
+    double d;
+
+    encode_float(buffer, INFINITY);
+    decode_float(buffer, f);
+    ASSERT_TRUE(isinf(f) && f > 0);
+    encode_float(buffer, -INFINITY);
+    decode_float(buffer, f);
+    ASSERT_TRUE(isinf(f) && f < 0);
+    encode_float(buffer, NAN);
+    decode_float(buffer, f);
+    ASSERT_TRUE(isnan(f));
+    encode_float(buffer, -0.0f);
+    decode_float(buffer, f);
+    ASSERT_TRUE(f == 0 && signbit(f));
+    encode_float(buffer, FLT_TRUE_MIN);
+    decode_float(buffer, f);
+    ASSERT_EQ(f, FLT_TRUE_MIN);
+
+    encode_double(buffer, INFINITY);
+    decode_double(buffer, d);
+    ASSERT_TRUE(isinf(d) && d > 0);
+    encode_double(buffer, -INFINITY);
+    decode_double(buffer, d);
+    ASSERT_TRUE(isinf(d) && d < 0);
+    encode_double(buffer, NAN);
+    decode_double(buffer, d);
+    ASSERT_TRUE(isnan(d));
+    encode_double(buffer, -0.0);
+    decode_double(buffer, d);
+    ASSERT_TRUE(d == 0 && signbit(d));
+    encode_double(buffer, DBL_TRUE_MIN);
+    decode_double(buffer, d);
+    ASSERT_EQ(d, DBL_TRUE_MIN);
+}
+
+TEST(RealNumberTests, BitPatterns)
+{
+    uint8_t buffer[8];
+    uint32_t i;
+    uint64_t l;
+
+    encode_float(buffer, 1.0f);
+    decode_le(buffer, i);
+    ASSERT_EQ(i, 0x3f800000);
+    encode_float(buffer, -2.5f);
+    decode_le(buffer, i);
+    ASSERT_EQ(i, 0xc0200000);
+    ASSERT_EQ((datapacker::internal::pack754<32, 8>(-2.5f)), 0xc0200000);
+
+    encode_double(buffer, 1.0);
+    decode_le(buffer, l);
+    ASSERT_EQ(l, 0x3ff0000000000000);
+    encode_double(buffer, -2.5);
+    decode_le(buffer, l);
+    ASSERT_EQ(l, 0xc004000000000000);
+    ASSERT_EQ((datapacker::internal::pack754<64, 11>(-2.5)), 0xc004000000000000);
+}
+
+TEST(RealNumberTests, Endianness)
+{
+    using datapacker::endian;
+    uint8_t buffer[8];
+    uint32_t i;
+    uint64_t l;
+    float f;
+    double d;
+
+    encode_float<endian::big>(buffer, -2.5f);
+    decode_be(buffer, i);
+    ASSERT_EQ(i, 0xc0200000);
+    ASSERT_EQ(buffer[0], 0xc0);
+    decode_float<endian::big>(buffer, f);
+    ASSERT_EQ(f, -2.5f);
+
+    ASSERT_EQ(encode<endian::big>(buffer, 3.0), sizeof(double));
+    decode_be(buffer, l);
+    ASSERT_EQ(l, 0x4008000000000000);
+    ASSERT_EQ(buffer[0], 0x40);
+    ASSERT_EQ(decode<endian::big>(buffer, d), sizeof(double));
+    ASSERT_EQ(d, 3.0);
+
+    encode<endian::little>(buffer, 3.0);
+    ASSERT_EQ(buffer[7], 0x40);
+    decode<endian::little>(buffer, d);
+    ASSERT_EQ(d, 3.0);
+}
+
 TEST(MultipleEncodingSameBuffer, Integers)
 {
     uint8_t a = 253, a1;
@@ -359,6 +523,32 @@ TEST(MultipleEncodingSameBuffer, Integers)
     ASSERT_EQ(h, h1);
 }
 
+TEST(MultipleEncodingSameBuffer, MixedTypes)
+{
+    using datapacker::endian;
+    int8_t a = -3, a1;
+    double b = 2.5, b1;
+    uint16_t c = 0x1234, c1;
+    float d = -0.75f, d1;
+    uint64_t e = 0x0102030405060708, e1;
+    uint8_t buffer[23], expected[23];
+
+    ASSERT_EQ(encode<endian::big>(buffer, a, b, c, d, e), 23);
+    encode_be(expected, a);
+    encode_double<endian::big>(expected + 1, b);
+    encode_be(expected + 9, c);
+    encode_float<endian::big>(expected + 11, d);
+    encode_be(expected + 15, e);
+    ASSERT_EQ(memcmp(buffer, expected, sizeof(buffer)), 0);
+
+    ASSERT_EQ(decode<endian::big>(buffer, a1, b1, c1, d1, e1), 23);
+    ASSERT_EQ(a, a1);
+    ASSERT_EQ(b, b1);
+    ASSERT_EQ(c, c1);
+    ASSERT_EQ(d, d1);
+    ASSERT_EQ(e, e1);
+}
+
 #include <string>
 
 TEST(ArrayEncoding, LengthPrefixedInts)
@@ -409,6 +599,96 @@ TEST(ArrayEncoding, LengthPrefixedChars)
     ASSERT_EQ(a, a1);
 }
 
+template <datapacker::endian endianness, typename T> void check_array_encoding(size_t n)
+{
+    std::vector<T> a(n), a1(n);
+    for (size_t i = 0; i < n; ++i)
+        a[i] = static_cast<T>(i * 2654435761u + 17);
+    std::vector<uint8_t> buffer(n * sizeof(T)), expected(n * sizeof(T));
+    for (size_t i = 0; i < n; ++i)
+        encode<endianness, T>(expected.data() + i * sizeof(T), a[i]);
+
+    ASSERT_EQ(encode_array<endianness>(buffer.data(), a.data(), n), n * sizeof(T));
+    ASSERT_EQ(buffer, expected);
+    ASSERT_EQ(decode_array<endianness>(buffer.data(), a1.data(), n), n * sizeof(T));
+    ASSERT_EQ(a, a1);
+}
+
+// Executors are called with capturing lambdas, which do not convert to function pointers
+static_assert(datapacker::internal::bulk_executor<void (*)(size_t, std::function<void(size_t)>)>);
+static_assert(!datapacker::internal::bulk_executor<void (*)(size_t, void (*)(size_t))>);
+
+TEST(ArrayEncoding, ParallelArrays)
+{
+    using datapacker::endian;
+    namespace bytes = datapacker::bytes;
+    std::vector<double> values(300 * 1000);
+    // The sequential encoding which the parallel encoding is compared with
+    check_array_encoding<endian::big, double>(values.size());
+    for (size_t i = 0; i < values.size(); ++i)
+        values[i] = static_cast<double>(i) * 0.5 - 1000.0;
+    std::vector<uint8_t> expected(values.size() * sizeof(double));
+    std::vector<uint8_t> buffer(expected.size());
+    bytes::encode_array<endian::big>(expected.data(), values.data(), values.size());
+
+    ASSERT_EQ(bytes::encode_array_parallel<endian::big>(std::execution::par, buffer.data(),
+                                                        values.data(), values.size()),
+              buffer.size());
+    ASSERT_EQ(buffer, expected);
+    std::vector<double> decoded(values.size());
+    bytes::decode_array_parallel<endian::big>(std::execution::par_unseq, buffer.data(),
+                                              decoded.data(), decoded.size());
+    ASSERT_EQ(decoded, values);
+
+    // An executor which runs the tasks on a few threads
+    size_t tasks = 0;
+    auto executor = [&tasks](size_t count, auto &&task) {
+        tasks = count;
+        std::vector<std::thread> threads;
+        for (size_t t = 0; t < 4; ++t)
+            threads.emplace_back([&, t] {
+                for (size_t i = t; i < count; i += 4)
+                    task(i);
+            });
+        for (auto &thread : threads)
+            thread.join();
+    };
+    std::fill(buffer.begin(), buffer.end(), 0);
+    bytes::encode_array_parallel<endian::big>(executor, buffer.data(), values.data(),
+                                              values.size());
+    ASSERT_EQ(buffer, expected);
+    ASSERT_GT(tasks, static_cast<size_t>(1));
+    std::fill(decoded.begin(), decoded.end(), 0.0);
+    bytes::decode_array_parallel<endian::big>(executor, buffer.data(), decoded.data(),
+                                              decoded.size());
+    ASSERT_EQ(decoded, values);
+
+    // Small arrays are encoded on the calling thread
+    tasks = 0;
+    bytes::encode_array_parallel<endian::big>(executor, buffer.data(), values.data(), 1000);
+    ASSERT_EQ(tasks, static_cast<size_t>(0));
+    ASSERT_TRUE(std::equal(buffer.begin(), buffer.begin() + 8000, expected.begin()));
+}
+
+TEST(ArrayEncoding, BulkArrays)
+{
+    using datapacker::endian;
+    for (size_t n : {0, 1, 3, 7, 16, 33, 1000})
+    {
+        check_array_encoding<endian::little, int8_t>(n);
+        check_array_encoding<endian::big, uint16_t>(n);
+        check_array_encoding<endian::little, uint16_t>(n);
+        check_array_encoding<endian::big, int32_t>(n);
+        check_array_encoding<endian::little, int32_t>(n);
+        check_array_encoding<endian::big, uint64_t>(n);
+        check_array_encoding<endian::little, int64_t>(n);
+        check_array_encoding<endian::big, float>(n);
+        check_array_encoding<endian::little, float>(n);
+        check_array_encoding<endian::big, double>(n);
+        check_array_encoding<endian::little, double>(n);
+    }
+}
+
 TEST(StringEncoding, LengthPrefixed)
 {
     std::string s = "The quick brown fox jumps over the lazy dogs";
@@ -461,6 +741,1919 @@ TEST(VectorEncoding, LengthPrefixed)
     ASSERT_EQ(f, f2);
 }
 
+TEST(StringEncoding, ReusesStorage)
+{
+    std::string s = "hello";
+    std::vector<uint8_t> buffer(8 + s.size());
+    encode_length_prefixed(buffer.data(), s);
+
+    std::string s2 = "a much longer string which has a heap allocated buffer";
+    const char *storage = s2.data();
+    // The limit is only used for validation, nothing is allocated for it
+    ASSERT_EQ(decode_length_prefixed(buffer.data(), s2, SIZE_MAX), s.size() + sizeof(size_t));
+    ASSERT_EQ(s, s2);
+    ASSERT_EQ(s2.data(), storage);
+
+    ASSERT_EQ(decode_length_prefixed(buffer.data(), s2, 2), -1);
+    ASSERT_EQ(s, s2);
+
+    std::vector<int64_t> v = {1, -2, 3}, v2;
+    std::vector<uint8_t> vbuffer(8 + v.size() * sizeof(int64_t));
+    encode_length_prefixed(vbuffer.data(), v);
+    v2.reserve(16);
+    const int64_t *vstorage = v2.data();
+    ASSERT_EQ(decode_length_prefixed(vbuffer.data(), v2, SIZE_MAX), vbuffer.size());
+    ASSERT_EQ(v, v2);
+    ASSERT_EQ(v2.data(), vstorage);
+}
+
+TEST(Views, StringView)
+{
+    std::string s = "The quick brown fox jumps over the lazy dogs";
+    std::vector<uint8_t> buffer(8 + s.size());
+    encode_length_prefixed(buffer.data(), s);
+
+    std::string_view view;
+    ASSERT_EQ(view_length_prefixed<datapacker::endian::big>(buffer.data(), view, s.size()),
+              buffer.size());
+    ASSERT_EQ(view, s);
+    ASSERT_EQ(reinterpret_cast<const uint8_t *>(view.data()), buffer.data() + sizeof(size_t));
+    ASSERT_EQ(view_length_prefixed<datapacker::endian::big>(buffer.data(), view, 3), -1);
+}
+
+TEST(Views, EndianSpan)
+{
+    using datapacker::endian;
+    std::vector<int32_t> v = {3, -1, 2, 0, 6441, INT_MAX, INT_MIN};
+    std::vector<uint8_t> buffer(8 + v.size() * sizeof(int32_t));
+    encode_length_prefixed(buffer.data(), v);
+
+    endian_span<int32_t, endian::big> span;
+    ASSERT_TRUE(span.empty());
+    ASSERT_EQ(view_length_prefixed(buffer.data(), span, v.size()), buffer.size());
+    ASSERT_EQ(span.size(), v.size());
+    ASSERT_EQ(span.bytes().data(), buffer.data() + sizeof(size_t));
+    for (size_t i = 0; i < v.size(); ++i)
+        ASSERT_EQ(span[i], v[i]);
+    std::vector<int32_t> v1(span.begin(), span.end());
+    ASSERT_EQ(v, v1);
+    ASSERT_EQ(view_length_prefixed(buffer.data(), span, 2), -1);
+}
+
+TEST(Cursors, WriterAndReader)
+{
+    using datapacker::endian;
+    uint8_t buffer[64];
+    std::string name = "hello";
+    std::vector<int16_t> v = {1, -2, 300};
+    writer w(buffer, sizeof(buffer));
+    w.put<endian::little>(uint8_t{1}, int32_t{-7}, 2.5).put<endian::big>(uint16_t{0xabcd});
+    w.put_length_prefixed<endian::big>(name).put_length_prefixed<endian::little>(v).pad(3);
+    ASSERT_TRUE(w);
+    ASSERT_EQ(w.position(), 1 + 4 + 8 + 2 + (8 + 5) + (8 + 6) + 3);
+    ASSERT_EQ(buffer[13], 0xab);
+
+    reader r(buffer, w.position());
+    uint8_t a;
+    int32_t b;
+    double c;
+    uint16_t d;
+    std::string name1;
+    std::vector<int16_t> v1;
+    r.get<endian::little>(a, b, c).get<endian::big>(d);
+    r.get_length_prefixed<endian::big>(name1, 100).get_length_prefixed<endian::little>(v1, 100);
+    r.skip(3);
+    ASSERT_TRUE(r);
+    ASSERT_EQ(r.remaining(), 0);
+    ASSERT_EQ(a, 1);
+    ASSERT_EQ(b, -7);
+    ASSERT_EQ(c, 2.5);
+    ASSERT_EQ(d, 0xabcd);
+    ASSERT_EQ(name, name1);
+    ASSERT_EQ(v, v1);
+
+    reader views(buffer + 15, w.position() - 15);
+    std::string_view sv;
+    endian_span<int16_t, endian::little> span;
+    views.view_length_prefixed<endian::big>(sv, 100).view_length_prefixed(span, 100);
+    ASSERT_TRUE(views);
+    ASSERT_EQ(sv, name);
+    ASSERT_EQ(span[2], 300);
+}
+
+TEST(Cursors, BoundsChecks)
+{
+    using datapacker::endian;
+    uint8_t buffer[16];
+    writer w(buffer, sizeof(buffer));
+    w.put<endian::little>(uint64_t{1}, uint32_t{2});
+    ASSERT_TRUE(w);
+    // Does not fit, so nothing is written
+    w.put<endian::little>(uint32_t{3}, uint8_t{4});
+    ASSERT_FALSE(w);
+    ASSERT_EQ(w.position(), 12);
+    // Ignored after failure, even though it fits
+    w.put<endian::little>(uint8_t{5});
+    ASSERT_EQ(w.position(), 12);
+
+    writer w2(buffer, sizeof(buffer));
+    w2.put_length_prefixed<endian::little>(std::string_view("too long string"));
+    ASSERT_FALSE(w2);
+    ASSERT_EQ(w2.position(), 0);
+
+    writer w3(buffer, sizeof(buffer));
+    w3.put_length_prefixed<endian::little>(std::string_view("abc"));
+    ASSERT_TRUE(w3);
+
+    std::string s = "unchanged";
+    reader r(buffer, w3.position());
+    r.get_length_prefixed<endian::little>(s, 2);
+    ASSERT_FALSE(r);
+    ASSERT_EQ(s, "unchanged");
+
+    // Prefix claims more bytes than are available
+    reader r2(buffer, w3.position() - 1);
+    r2.get_length_prefixed<endian::little>(s, 100);
+    ASSERT_FALSE(r2);
+    ASSERT_EQ(s, "unchanged");
+
+    reader r3(buffer, 3);
+    uint32_t x;
+    r3.get<endian::little>(x);
+    ASSERT_FALSE(r3);
+    ASSERT_EQ(r3.position(), 0);
+}
+
+struct SchemaTestRecord
+{
+    uint32_t size;
+    int16_t version;
+    double value;
+    uint8_t flags;
+};
+
+template <>
+struct datapacker::bytes::schema<SchemaTestRecord>
+    : layout<field<&SchemaTestRecord::size, datapacker::endian::big>, padding<2>,
+             field<&SchemaTestRecord::version>, field<&SchemaTestRecord::value>,
+             field<&SchemaTestRecord::flags>>
+{
+};
+
+TEST(Records, EncodeAndDecode)
+{
+    static_assert(packed_size<SchemaTestRecord> == 4 + 2 + 2 + 8 + 1);
+    SchemaTestRecord rec{0x01020304, -3, 2.5, 0xff};
+    uint8_t buffer[packed_size<SchemaTestRecord>];
+    ASSERT_EQ(encode_record(buffer, rec), sizeof(buffer));
+
+    uint8_t expected[sizeof(buffer)];
+    int n = encode_be(expected, rec.size);
+    n += encode_le(expected + n, uint16_t{0}, rec.version);
+    n += encode_double(expected + n, rec.value);
+    encode_le(expected + n, rec.flags);
+    ASSERT_EQ(memcmp(buffer, expected, sizeof(buffer)), 0);
+
+    SchemaTestRecord rec1{};
+    ASSERT_EQ(decode_record(buffer, rec1), sizeof(buffer));
+    ASSERT_EQ(rec1.size, rec.size);
+    ASSERT_EQ(rec1.version, rec.version);
+    ASSERT_EQ(rec1.value, rec.value);
+    ASSERT_EQ(rec1.flags, rec.flags);
+
+    uint8_t cursor_buffer[2 * sizeof(buffer)];
+    writer w(cursor_buffer, sizeof(cursor_buffer));
+    w.put_record(rec).put_record(rec);
+    ASSERT_TRUE(w);
+    w.put_record(rec);
+    ASSERT_FALSE(w);
+    reader r(cursor_buffer, sizeof(cursor_buffer));
+    SchemaTestRecord rec2{};
+    r.get_record(rec1).get_record(rec2);
+    ASSERT_TRUE(r);
+    ASSERT_EQ(rec2.value, rec.value);
+
+    std::ostringstream oss;
+    datapacker::stream::write_record(oss, rec);
+    ASSERT_EQ(oss.str(), std::string(reinterpret_cast<char *>(buffer), sizeof(buffer)));
+    std::istringstream iss(oss.str());
+    SchemaTestRecord rec3{};
+    ASSERT_TRUE(datapacker::stream::read_record(iss, rec3));
+    ASSERT_EQ(rec3.size, rec.size);
+    ASSERT_EQ(rec3.flags, rec.flags);
+}
+
+TEST(Records, Columns)
+{
+    static_assert(column_width<SchemaTestRecord> == 4 + 2 + 8 + 1);
+    std::vector<SchemaTestRecord> records(1500);
+    for (size_t i = 0; i < records.size(); ++i)
+    {
+        records[i] = SchemaTestRecord{static_cast<uint32_t>(i * 1000), static_cast<int16_t>(-i),
+                                      static_cast<double>(i) / 4, static_cast<uint8_t>(i)};
+    }
+    size_t n = records.size();
+    std::vector<uint8_t> buffer(column_width<SchemaTestRecord> * n);
+    ASSERT_EQ(encode_columns(buffer.data(), records.data(), n), buffer.size());
+
+    // The column of each field is stored contiguously, in the endianness of the field
+    uint32_t size;
+    decode<datapacker::endian::big>(buffer.data() + 4 * 2, size);
+    ASSERT_EQ(size, static_cast<uint32_t>(2000));
+    int16_t version;
+    decode<datapacker::endian::little>(buffer.data() + 4 * n + 2 * 3, version);
+    ASSERT_EQ(version, -3);
+
+    std::vector<SchemaTestRecord> decoded(n);
+    ASSERT_EQ(decode_columns(buffer.data(), decoded.data(), n), buffer.size());
+    std::vector<double> values(n);
+    decode_column<&SchemaTestRecord::value>(buffer.data(), n, values.data());
+    auto flags = view_column<&SchemaTestRecord::flags>(buffer.data(), n);
+    auto sizes = view_column<&SchemaTestRecord::size>(buffer.data(), n);
+    ASSERT_EQ(flags.size(), n);
+    for (size_t i = 0; i < n; ++i)
+    {
+        ASSERT_EQ(decoded[i].size, records[i].size);
+        ASSERT_EQ(decoded[i].version, records[i].version);
+        ASSERT_EQ(decoded[i].value, records[i].value);
+        ASSERT_EQ(decoded[i].flags, records[i].flags);
+        ASSERT_EQ(values[i], records[i].value);
+        ASSERT_EQ(flags[i], records[i].flags);
+        ASSERT_EQ(sizes[i], records[i].size);
+    }
+}
+
+TEST(EncodedSize, FixedAndVariable)
+{
+    using datapacker::endian;
+    static_assert(encoded_size<uint8_t, int32_t, double>() == 13);
+    static_assert(encoded_size<>() == 0);
+    static_assert(encoded_size(uint16_t{1}, 2.5f) == 6);
+    static_assert(encoded_size("abc") == sizeof(size_t) + 3);
+
+    std::string s = "hello";
+    std::vector<int32_t> v = {1, 2, 3};
+    SchemaTestRecord rec{1, 2, 3.0, 4};
+    size_t n = encoded_size(uint8_t{1}, s, v, rec, std::string_view("xy"));
+    ASSERT_EQ(n, 1 + (8 + 5) + (8 + 12) + packed_size<SchemaTestRecord> + (8 + 2));
+
+    std::vector<uint8_t> buffer(n);
+    writer w(buffer.data(), buffer.size());
+    w.put<endian::big>(uint8_t{1}, s, v, rec, std::string_view("xy"));
+    ASSERT_TRUE(w);
+    ASSERT_EQ(w.remaining(), 0);
+
+    reader r(buffer.data(), buffer.size());
+    uint8_t a;
+    std::string s1, s2;
+    std::vector<int32_t> v1;
+    SchemaTestRecord rec1{};
+    r.get<endian::big>(a).get_length_prefixed<endian::big>(s1, 100);
+    r.get_length_prefixed<endian::big>(v1, 100).get_record(rec1);
+    r.get_length_prefixed<endian::big>(s2, 100);
+    ASSERT_TRUE(r);
+    ASSERT_EQ(s, s1);
+    ASSERT_EQ(v, v1);
+    ASSERT_EQ(rec1.value, 3.0);
+    ASSERT_EQ(s2, "xy");
+
+    // Only one check is done, so nothing is written if any of the values do not fit
+    writer w2(buffer.data(), n - 1);
+    w2.put<endian::big>(uint8_t{1}, s, v, rec, std::string_view("xy"));
+    ASSERT_FALSE(w2);
+    ASSERT_EQ(w2.position(), 0);
+}
+
+TEST(StreamTests, MultipleValues)
+{
+    using datapacker::endian;
+    using namespace datapacker::stream;
+    std::ostringstream oss;
+    std::string s = "hello";
+    std::vector<double> v = {1.5, -2.5};
+    std::vector<uint8_t> large(2 * datapacker::STREAM_CHUNK_SIZE, 3);
+    SchemaTestRecord rec{1, 2, 3.0, 4};
+    write<endian::little>(oss, 42, s, "literal", v, rec);
+    write<endian::little>(oss, large, s);
+    ASSERT_EQ(oss.str().size(), encoded_size(42, s, "literal", v, rec, large, s));
+
+    std::istringstream iss(oss.str());
+    int x;
+    std::string s1, lit, s2;
+    std::vector<double> v1;
+    std::vector<uint8_t> large1;
+    SchemaTestRecord rec1{};
+    read<endian::little>(iss, x);
+    read<endian::little>(iss, s1);
+    read<endian::little>(iss, lit);
+    read<endian::little>(iss, v1);
+    read<endian::little>(iss, rec1);
+    read<endian::little>(iss, large1);
+    read<endian::little>(iss, s2);
+    ASSERT_TRUE(iss);
+    ASSERT_EQ(x, 42);
+    ASSERT_EQ(s1, s);
+    ASSERT_EQ(lit, "literal");
+    ASSERT_EQ(v1, v);
+    ASSERT_EQ(rec1.flags, 4);
+    ASSERT_EQ(large1, large);
+    ASSERT_EQ(s2, s);
+}
+
+TEST(StreamTests, BufferedWriterAndReader)
+{
+    using datapacker::endian;
+    using datapacker::bytes::varint_prefix;
+    using namespace datapacker::stream;
+    std::ostringstream oss;
+    std::vector<double> large(1000, 3.25);
+    std::vector<uint32_t> swapped(100, 0x01020304);
+    {
+        // A small block, so that values are split across flushes
+        buffered_writer w(oss, 32);
+        for (int i = 0; i < 100; ++i)
+            w.write<endian::big>(i);
+        w.write<endian::little>(large);
+        w.write<endian::big>(swapped);
+        w.write<endian::big, varint_prefix>(std::string("Hello, World!"));
+        w.write<endian::big>(1.5f, static_cast<uint8_t>(7), "abc");
+        w.flush();
+        ASSERT_EQ(w.buffered(), static_cast<size_t>(0));
+    }
+    // The output is the same as that of stream::write
+    std::ostringstream expected;
+    for (int i = 0; i < 100; ++i)
+        write<endian::big>(expected, i);
+    write<endian::little>(expected, large);
+    write<endian::big>(expected, swapped);
+    write<endian::big, varint_prefix>(expected, std::string("Hello, World!"));
+    write<endian::big>(expected, 1.5f, static_cast<uint8_t>(7), "abc");
+    ASSERT_EQ(oss.str(), expected.str());
+
+    std::istringstream iss(oss.str());
+    buffered_reader r(iss, 32);
+    for (int i = 0; i < 100; ++i)
+    {
+        int x;
+        r.read<endian::big>(x);
+        ASSERT_EQ(x, i);
+    }
+    std::vector<double> large_read;
+    std::vector<uint32_t> swapped_read;
+    std::string s1, s2;
+    float f;
+    uint8_t u;
+    r.read<endian::little>(large_read);
+    r.read<endian::big>(swapped_read);
+    r.read<endian::big, varint_prefix>(s1);
+    r.read<endian::big>(f).read<endian::big>(u).read<endian::big>(s2);
+    ASSERT_TRUE(r);
+    ASSERT_EQ(large_read, large);
+    ASSERT_EQ(swapped_read, swapped);
+    ASSERT_EQ(s1, "Hello, World!");
+    ASSERT_EQ(f, 1.5f);
+    ASSERT_EQ(u, 7);
+    ASSERT_EQ(s2, "abc");
+    r.read<endian::big>(u);
+    ASSERT_FALSE(r);
+
+    std::istringstream iss2(expected.str());
+    buffered_reader r2(iss2);
+    int x;
+    r2.read<endian::big>(x);
+    ASSERT_THROW(r2.read<endian::big>(s1, 10), std::runtime_error);
+}
+
+TEST(StreamTests, BufferedFileAndDescriptor)
+{
+    using datapacker::endian;
+    using namespace datapacker::stream;
+    FILE *file = tmpfile();
+    ASSERT_NE(file, nullptr);
+    std::vector<int16_t> v = {1, -2, 3, -4, 5};
+    {
+        buffered_writer w(file);
+        w.write<endian::big>(v, std::string("file"), static_cast<uint64_t>(1) << 40);
+    }
+
+    rewind(file);
+    buffered_reader r(fileno(file));
+    std::vector<int16_t> decoded;
+    std::string s;
+    uint64_t x;
+    r.read<endian::big>(decoded).read<endian::big>(s).read<endian::big>(x);
+    ASSERT_TRUE(r);
+    ASSERT_EQ(decoded, v);
+    ASSERT_EQ(s, "file");
+    ASSERT_EQ(x, static_cast<uint64_t>(1) << 40);
+    fclose(file);
+}
+
+TEST(MappedFile, ReadsInPlace)
+{
+    using datapacker::endian;
+    std::string path = (std::filesystem::temp_directory_path() / "datapacker_mapped_test").string();
+    {
+        std::ofstream os(path, std::ios::binary | std::ios::trunc);
+        ASSERT_TRUE(os);
+        datapacker::stream::buffered_writer w(os);
+        w.write<endian::little>(static_cast<uint32_t>(0xCAFEBABE), std::string("mapped"));
+        for (int i = 0; i < 10000; ++i)
+            w.write<endian::big>(i);
+    }
+
+    {
+        datapacker::mapped_file file(path, datapacker::access_pattern::sequential);
+        ASSERT_EQ(file.size(), static_cast<size_t>(4 + 8 + 6 + 4 * 10000));
+        file.advise(datapacker::access_pattern::random, 5000, 100);
+        auto r = file.reader();
+        uint32_t magic;
+        std::string_view s;
+        r.get<endian::little>(magic).view_length_prefixed<endian::little>(s, 100);
+        ASSERT_EQ(magic, 0xCAFEBABE);
+        ASSERT_EQ(s, "mapped");
+        // The view points into the mapping
+        ASSERT_EQ(reinterpret_cast<const uint8_t *>(s.data()), file.data() + 12);
+        for (int i = 0; i < 10000; ++i)
+        {
+            int x;
+            r.get<endian::big>(x);
+            ASSERT_EQ(x, i);
+        }
+        ASSERT_TRUE(r);
+        ASSERT_EQ(r.remaining(), static_cast<size_t>(0));
+
+        datapacker::mapped_file moved(std::move(file));
+        ASSERT_EQ(file.data(), nullptr);
+        ASSERT_EQ(moved.bytes().size(), static_cast<size_t>(40018));
+    }
+
+    // Empty files have no mapping
+    std::ofstream(path, std::ios::binary | std::ios::trunc).close();
+    {
+        datapacker::mapped_file empty(path);
+        ASSERT_TRUE(empty.empty());
+        int x;
+        ASSERT_FALSE(empty.reader().get<endian::big>(x));
+    }
+    std::filesystem::remove(path);
+
+    ASSERT_THROW(datapacker::mapped_file("/nonexistent/datapacker"), std::system_error);
+}
+
+TEST(Gather, ReferencesLargeArrays)
+{
+    using datapacker::endian;
+    std::vector<uint8_t> blob(10000);
+    for (size_t i = 0; i < blob.size(); ++i)
+        blob[i] = static_cast<uint8_t>(i * 7);
+    std::vector<uint32_t> words(1000, 0x01020304);
+    std::string small = "small";
+
+    uint8_t header[128];
+    datapacker::gather_writer g(header, sizeof(header));
+    g.put<endian::little>(static_cast<uint16_t>(1), 2.5, small);
+    g.put_length_prefixed<endian::little>(blob);
+    g.put<endian::little>(static_cast<uint32_t>(42));
+    g.put_length_prefixed<endian::little>(words);
+    ASSERT_TRUE(g);
+    auto segments = g.segments();
+    ASSERT_EQ(segments.size(), static_cast<size_t>(4));
+    ASSERT_EQ(segments[1].iov_base, blob.data());
+    ASSERT_EQ(segments[3].iov_base, words.data());
+
+    // The concatenated segments are the same as the output of bytes::writer
+    std::vector<uint8_t> expected(g.size());
+    datapacker::bytes::writer w(expected.data(), expected.size());
+    w.put<endian::little>(static_cast<uint16_t>(1), 2.5, small, blob, static_cast<uint32_t>(42),
+                          words);
+    ASSERT_TRUE(w);
+    ASSERT_EQ(w.remaining(), static_cast<size_t>(0));
+    std::vector<uint8_t> joined;
+    for (auto &segment : segments)
+    {
+        auto p = static_cast<const uint8_t *>(segment.iov_base);
+        joined.insert(joined.end(), p, p + segment.iov_len);
+    }
+    ASSERT_EQ(joined, expected);
+
+    // Elements which have to be byte swapped are encoded into the header
+    g.clear();
+    g.put_length_prefixed<endian::big>(words);
+    ASSERT_FALSE(g);
+
+#if !defined(_WIN32)
+    // writev is only available on POSIX
+    char path[] = "/tmp/datapacker_gather_XXXXXX";
+    int fd = mkstemp(path);
+    ASSERT_NE(fd, -1);
+    g.clear();
+    g.put<endian::big>(static_cast<uint8_t>(3)).put_length_prefixed<endian::big>(blob);
+    segments = g.segments();
+    ASSERT_EQ(writev(fd, segments.data(), static_cast<int>(segments.size())),
+              static_cast<ssize_t>(g.size()));
+    close(fd);
+    datapacker::mapped_file file(path);
+    auto r = file.reader();
+    uint8_t type;
+    std::vector<uint8_t> decoded;
+    r.get<endian::big>(type).get_length_prefixed<endian::big>(decoded, blob.size());
+    ASSERT_TRUE(r);
+    ASSERT_EQ(type, 3);
+    ASSERT_EQ(decoded, blob);
+    unlink(path);
+#endif
+}
+
+TEST(StreamTests, ChunkedRead)
+{
+    using datapacker::endian;
+    using namespace datapacker::stream;
+    std::vector<uint32_t> values(100000);
+    for (size_t i = 0; i < values.size(); ++i)
+        values[i] = static_cast<uint32_t>(i * 3);
+    std::ostringstream oss;
+    write<endian::big>(oss, values);
+    write<endian::little>(oss, values);
+    write<endian::big>(oss, std::string("chunked"));
+
+    std::istringstream iss(oss.str());
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        std::vector<uint32_t> decoded;
+        size_t chunks = 0;
+        auto append = [&](std::span<const uint32_t> chunk) {
+            ASSERT_LE(chunk.size_bytes(), datapacker::STREAM_CHUNK_SIZE);
+            decoded.insert(decoded.end(), chunk.begin(), chunk.end());
+            ++chunks;
+        };
+        size_t n = pass == 0 ? read_chunked<endian::big, uint32_t>(iss, append)
+                             : read_chunked<endian::little, uint32_t>(iss, append);
+        ASSERT_EQ(n, values.size());
+        ASSERT_EQ(decoded, values);
+        ASSERT_GT(chunks, static_cast<size_t>(1));
+    }
+    std::string s;
+    read_chunked<endian::big, char>(iss, [&](std::span<const char> chunk) {
+        s.append(chunk.begin(), chunk.end());
+    });
+    ASSERT_TRUE(iss);
+    ASSERT_EQ(s, "chunked");
+
+    std::istringstream limited(oss.str());
+    auto ignore = [](std::span<const uint32_t>) {};
+    ASSERT_THROW((read_chunked<endian::big, uint32_t>(limited, ignore, 10)), std::runtime_error);
+
+    // The stream ends in the middle of the sequence
+    std::istringstream truncated(oss.str().substr(0, 1000));
+    size_t count = 0;
+    read_chunked<endian::big, uint32_t>(
+        truncated, [&](std::span<const uint32_t> chunk) { count += chunk.size(); });
+    ASSERT_FALSE(truncated);
+    ASSERT_LT(count, values.size());
+
+    std::istringstream buffered_input(oss.str());
+    buffered_reader r(buffered_input);
+    std::vector<uint32_t> decoded;
+    ASSERT_EQ((r.read_chunked<endian::big, uint32_t>([&](std::span<const uint32_t> chunk) {
+                  decoded.insert(decoded.end(), chunk.begin(), chunk.end());
+              })),
+              values.size());
+    ASSERT_TRUE(r);
+    ASSERT_EQ(decoded, values);
+}
+
+TEST(StreamTests, ScalarsAndSequences)
+{
+    using datapacker::endian;
+    using namespace datapacker::stream;
+    std::ostringstream oss;
+    std::string s = "The quick brown fox jumps over the lazy dogs";
+    std::vector<int32_t> v = {3, -1, 2, 0, 6441, INT_MAX, INT_MIN};
+    std::vector<double> d = {-1., 0., 3.1415, DBL_MIN, DBL_MAX, 1e100};
+    std::vector<uint16_t> large(10000);
+    for (size_t i = 0; i < large.size(); ++i)
+        large[i] = static_cast<uint16_t>(i * 7);
+
+    write<endian::big>(oss, uint8_t{7});
+    write<endian::big>(oss, -5);
+    write<endian::little>(oss, 2.5f);
+    write<endian::big>(oss, "literal");
+    write<endian::big>(oss, s);
+    write<endian::big>(oss, v);
+    write<endian::little>(oss, d);
+    write<endian::big>(oss, large);
+    write<endian::little>(oss, large);
+
+    std::string str = oss.str();
+    ASSERT_EQ(str[0], 7);
+    ASSERT_EQ(str.size(), 1 + 4 + 4 + (8 + 7) + (8 + s.size()) + (8 + v.size() * 4) +
+                              (8 + d.size() * 8) + 2 * (8 + large.size() * 2));
+    std::istringstream iss(str);
+
+    uint8_t a;
+    int b;
+    float c;
+    std::string lit, s1;
+    std::vector<int32_t> v1;
+    std::vector<double> d1;
+    std::vector<uint16_t> large1, large2;
+    read<endian::big>(iss, a);
+    read<endian::big>(iss, b);
+    read<endian::little>(iss, c);
+    read<endian::big>(iss, lit);
+    read<endian::big>(iss, s1);
+    read<endian::big>(iss, v1);
+    read<endian::little>(iss, d1);
+    read<endian::big>(iss, large1);
+    read<endian::little>(iss, large2);
+    ASSERT_TRUE(iss);
+    ASSERT_EQ(a, 7);
+    ASSERT_EQ(b, -5);
+    ASSERT_EQ(c, 2.5f);
+    ASSERT_EQ(lit, "literal");
+    ASSERT_EQ(s, s1);
+    ASSERT_EQ(v, v1);
+    ASSERT_EQ(d, d1);
+    ASSERT_EQ(large, large1);
+    ASSERT_EQ(large, large2);
+    read<endian::big>(iss, a);
+    ASSERT_FALSE(iss);
+}
+
+TEST(StreamTests, ScratchBuffer)
+{
+    using datapacker::endian;
+    using namespace datapacker::stream;
+    scratch buf(16);
+    std::ostringstream oss;
+    std::vector<float> f = {1.1f, -1.3f, 1e10f, FLT_MIN, FLT_MAX, 0.0013f, 5e-5f};
+    write<endian::big>(oss, f, buf);
+    write<endian::little>(oss, f, buf);
+    write<endian::big>(oss, 42, buf);
+
+    std::istringstream iss(oss.str());
+    std::vector<float> f1, f2;
+    int x;
+    read<endian::big>(iss, f1, buf);
+    read<endian::little>(iss, f2, buf);
+    read<endian::big>(iss, x, buf);
+    ASSERT_TRUE(iss);
+    ASSERT_EQ(f, f1);
+    ASSERT_EQ(f, f2);
+    ASSERT_EQ(x, 42);
+
+    std::istringstream iss2(oss.str());
+    ASSERT_THROW(read<endian::big>(iss2, f1, buf, 3), std::runtime_error);
+}
+
+template <typename T> void check_varint(T value, int expected_size)
+{
+    uint8_t buffer[16] = {0};
+    ASSERT_EQ(datapacker::bytes::varint_size(value), static_cast<size_t>(expected_size));
+    ASSERT_EQ(datapacker::bytes::encode_varint(buffer, value), expected_size);
+    T decoded{};
+    // Decodes from a buffer which is exactly the size of the varint, and from a larger buffer
+    ASSERT_EQ(datapacker::bytes::decode_varint(buffer, expected_size, decoded), expected_size);
+    ASSERT_EQ(decoded, value);
+    decoded = T{};
+    ASSERT_EQ(datapacker::bytes::decode_varint(buffer, sizeof(buffer), decoded), expected_size);
+    ASSERT_EQ(decoded, value);
+    // Truncated varint
+    ASSERT_EQ(datapacker::bytes::decode_varint(buffer, expected_size - 1, decoded), -1);
+}
+
+TEST(Varints, UnsignedAndZigZag)
+{
+    check_varint<uint8_t>(0, 1);
+    check_varint<uint8_t>(127, 1);
+    check_varint<uint8_t>(255, 2);
+    check_varint<uint16_t>(300, 2);
+    check_varint<uint16_t>(65535, 3);
+    check_varint<uint32_t>(UINT32_MAX, 5);
+    check_varint<uint64_t>(1ULL << 56, 9);
+    check_varint<uint64_t>(UINT64_MAX, 10);
+
+    check_varint<int32_t>(0, 1);
+    check_varint<int32_t>(-1, 1);
+    check_varint<int32_t>(1, 1);
+    check_varint<int32_t>(-64, 1);
+    check_varint<int32_t>(64, 2);
+    check_varint<int16_t>(INT16_MIN, 3);
+    check_varint<int32_t>(INT32_MIN, 5);
+    check_varint<int32_t>(INT32_MAX, 5);
+    check_varint<int64_t>(INT64_MIN, 10);
+    check_varint<int64_t>(INT64_MAX, 10);
+
+    uint8_t buffer[16] = {0xAC, 0x02};
+    uint16_t u16;
+    ASSERT_EQ(datapacker::bytes::decode_varint(buffer, 2, u16), 2);
+    ASSERT_EQ(u16, 300);
+
+    // Values which do not fit in the type, and varints longer than the maximum size
+    uint8_t u8;
+    ASSERT_EQ(datapacker::bytes::decode_varint(buffer, 2, u8), -1);
+    uint8_t overlong[16];
+    memset(overlong, 0x80, sizeof(overlong));
+    uint64_t u64;
+    ASSERT_EQ(datapacker::bytes::decode_varint(overlong, sizeof(overlong), u64), -1);
+    overlong[9] = 0x02;
+    ASSERT_EQ(datapacker::bytes::decode_varint(overlong, sizeof(overlong), u64), -1);
+}
+
+TEST(Varints, LengthPrefixes)
+{
+    using datapacker::endian;
+    using datapacker::bytes::varint_prefix;
+    namespace bytes = datapacker::bytes;
+    uint8_t buffer[512];
+
+    std::string s = "Hello, World!";
+    ASSERT_EQ((bytes::encode_length_prefixed<endian::big, varint_prefix>(buffer, s)), 14);
+    ASSERT_EQ(buffer[0], 13);
+    std::string decoded;
+    ASSERT_EQ((bytes::decode_length_prefixed<endian::big, varint_prefix>(buffer, decoded, 100)),
+              14);
+    ASSERT_EQ(decoded, s);
+    std::string_view view;
+    ASSERT_EQ((bytes::view_length_prefixed<endian::big, varint_prefix>(buffer, view, 100)), 14);
+    ASSERT_EQ(view, s);
+
+    std::vector<uint16_t> v(200, 0x1234);
+    ASSERT_EQ((bytes::encode_length_prefixed<endian::little, uint16_t>(buffer, v)), 402);
+    ASSERT_EQ(buffer[0], 200);
+    ASSERT_EQ(buffer[1], 0);
+    std::vector<uint16_t> decoded_v;
+    ASSERT_EQ((bytes::decode_length_prefixed<endian::little, uint16_t>(buffer, decoded_v, 1000)),
+              402);
+    ASSERT_EQ(decoded_v, v);
+
+    std::vector<uint8_t> too_long(300);
+    ASSERT_EQ((bytes::encode_length_prefixed<endian::little, uint8_t>(buffer, too_long)), -1);
+
+    bytes::writer w(buffer, sizeof(buffer));
+    w.put_length_prefixed<endian::big, varint_prefix>(s);
+    w.put_length_prefixed<endian::big, uint8_t>(v);
+    w.put_varint(-300);
+    w.put_length_prefixed<endian::big, uint8_t>(too_long);
+    ASSERT_FALSE(w);
+    ASSERT_EQ(w.position(), static_cast<size_t>(14 + 401 + 2));
+
+    bytes::reader r(buffer, w.position());
+    int value;
+    r.get_length_prefixed<endian::big, varint_prefix>(decoded, 100);
+    r.get_length_prefixed<endian::big, uint8_t>(decoded_v, 1000);
+    r.get_varint(value);
+    ASSERT_TRUE(r);
+    ASSERT_EQ(decoded, s);
+    ASSERT_EQ(decoded_v, v);
+    ASSERT_EQ(value, -300);
+    r.get_varint(value);
+    ASSERT_FALSE(r);
+}
+
+TEST(Varints, StreamPrefixes)
+{
+    using datapacker::endian;
+    using datapacker::bytes::varint_prefix;
+    using namespace datapacker::stream;
+    std::ostringstream oss;
+    std::string s(1000, 'x');
+    std::vector<double> v = {1.5, -2.25, 1e100};
+    write<endian::big, varint_prefix>(oss, s);
+    write<endian::big, varint_prefix>(oss, v);
+    write<endian::big, varint_prefix>(oss, "abc");
+    ASSERT_EQ(oss.str().size(), static_cast<size_t>(2 + 1000 + 1 + 24 + 1 + 3));
+    ASSERT_THROW((write<endian::big, uint8_t>(oss, s)), std::runtime_error);
+
+    std::istringstream iss(oss.str());
+    std::string s1, s2;
+    std::vector<double> v1;
+    read<endian::big, varint_prefix>(iss, s1);
+    read<endian::big, varint_prefix>(iss, v1);
+    read<endian::big, varint_prefix>(iss, s2);
+    ASSERT_TRUE(iss);
+    ASSERT_EQ(s1, s);
+    ASSERT_EQ(v1, v);
+    ASSERT_EQ(s2, "abc");
+
+    std::istringstream overlong(std::string(16, '\x80'));
+    ASSERT_THROW((read<endian::big, varint_prefix>(overlong, s1)), std::runtime_error);
+}
+
+TEST(Allocators, PmrContainers)
+{
+    using datapacker::endian;
+    namespace bytes = datapacker::bytes;
+    uint8_t buffer[1024];
+    bytes::writer w(buffer, sizeof(buffer));
+    std::vector<int32_t> ints = {1, -2, 3, -4};
+    w.put<endian::big>(std::string("a string which is too long for small string optimization"),
+                       ints);
+    ASSERT_TRUE(w);
+
+    // Every allocation comes from the arena, the upstream resource throws if it is used
+    alignas(std::max_align_t) uint8_t arena[4096];
+    std::pmr::monotonic_buffer_resource resource(arena, sizeof(arena),
+                                                 std::pmr::null_memory_resource());
+    std::pmr::string s(&resource);
+    std::pmr::vector<int32_t> v(&resource);
+    int n = bytes::decode_length_prefixed<endian::big>(buffer, s, 100);
+    ASSERT_EQ(n, static_cast<int>(sizeof(size_t) + 56));
+    ASSERT_NE(bytes::decode_length_prefixed<endian::big>(buffer + n, v, 100), -1);
+    ASSERT_EQ(s, "a string which is too long for small string optimization");
+    ASSERT_EQ(std::vector<int32_t>(v.begin(), v.end()), ints);
+
+    bytes::reader r(buffer, w.position());
+    std::pmr::string s2(&resource);
+    std::pmr::vector<int32_t> v2(&resource);
+    r.get_length_prefixed<endian::big>(s2, 100).get_length_prefixed<endian::big>(v2, 100);
+    ASSERT_TRUE(r);
+    ASSERT_EQ(s2, s);
+    ASSERT_EQ(v2, v);
+
+    std::ostringstream oss;
+    datapacker::stream::write<endian::little>(oss, v);
+    datapacker::stream::write<endian::little>(oss, s);
+    std::istringstream iss(oss.str());
+    std::pmr::vector<int32_t> v3(&resource);
+    std::pmr::string s3(&resource);
+    datapacker::stream::read<endian::little>(iss, v3);
+    datapacker::stream::read<endian::little>(iss, s3);
+    ASSERT_TRUE(iss);
+    ASSERT_EQ(v3, v);
+    ASSERT_EQ(s3, s);
+    ASSERT_EQ(bytes::encoded_size(s3, v3), w.position());
+}
+
+TEST(IncrementalDecoder, Fragments)
+{
+    using datapacker::endian;
+    namespace bytes = datapacker::bytes;
+    using bytes::decode_status;
+    uint8_t buffer[512];
+    bytes::writer w(buffer, sizeof(buffer));
+    std::vector<double> doubles = {1.5, -2.25, 1e100, 0.0};
+    SchemaTestRecord rec{0x01020304, -3, 2.5, 0xff};
+    w.put<endian::big>(static_cast<uint32_t>(0xDEADBEEF));
+    w.put_length_prefixed<endian::big, bytes::varint_prefix>(std::string(200, 'x'));
+    w.put_varint(-12345);
+    w.put<endian::little>(doubles, rec);
+    ASSERT_TRUE(w);
+    size_t message_size = w.position();
+    // A second message follows the first one
+    w.put<endian::big>(static_cast<uint32_t>(7));
+    w.put_length_prefixed<endian::big, bytes::varint_prefix>(std::string("next"));
+    w.put_varint(1);
+    w.put<endian::little>(std::vector<double>{}, rec);
+
+    uint32_t id;
+    std::string name;
+    int delta;
+    std::vector<double> values;
+    SchemaTestRecord decoded_rec;
+    bytes::incremental_decoder d;
+    d.expect<endian::big>(id)
+        .expect<endian::big, bytes::varint_prefix>(name, 1000)
+        .expect_varint(delta)
+        .expect<endian::little>(values)
+        .expect<endian::little>(decoded_rec);
+
+    // Every fragment size, so that fields and elements are split at every offset
+    for (size_t fragment = 1; fragment <= message_size; ++fragment)
+    {
+        d.restart();
+        size_t offset = 0;
+        decode_status status = decode_status::need_more;
+        while (status == decode_status::need_more)
+        {
+            size_t n = fragment < w.position() - offset ? fragment : w.position() - offset;
+            status = d.feed(buffer + offset, n);
+            offset += d.consumed();
+        }
+        ASSERT_EQ(status, decode_status::done);
+        ASSERT_EQ(offset, message_size);
+        ASSERT_EQ(id, 0xDEADBEEF);
+        ASSERT_EQ(name, std::string(200, 'x'));
+        ASSERT_EQ(delta, -12345);
+        ASSERT_EQ(values, doubles);
+        ASSERT_EQ(decoded_rec.version, rec.version);
+        ASSERT_EQ(decoded_rec.value, rec.value);
+    }
+
+    d.restart();
+    ASSERT_EQ(d.feed(buffer + message_size, w.position() - message_size), decode_status::done);
+    ASSERT_EQ(d.consumed(), w.position() - message_size);
+    ASSERT_EQ(id, static_cast<uint32_t>(7));
+    ASSERT_EQ(name, "next");
+    ASSERT_TRUE(values.empty());
+
+    // A sequence longer than the maximum is an error, which stays until restart
+    d.clear();
+    d.expect<endian::big, bytes::varint_prefix>(name, 10);
+    uint8_t long_string[] = {200, 1};
+    ASSERT_EQ(d.feed(long_string, sizeof(long_string)), decode_status::error);
+    ASSERT_EQ(d.feed(long_string, sizeof(long_string)), decode_status::error);
+    d.restart();
+    uint8_t short_string[] = {2, 'o', 'k'};
+    ASSERT_EQ(d.feed(short_string, 1), decode_status::need_more);
+    ASSERT_EQ(d.feed(short_string + 1, 2), decode_status::done);
+    ASSERT_EQ(name, "ok");
+}
+
+// An in memory pipe which accepts and returns atmost a few bytes per call, and reports that it is
+// not ready every other call, to exercise suspension
+struct TestPipe
+{
+    std::vector<uint8_t> data;
+    size_t read_pos = 0;
+    size_t max_per_call = 3;
+    bool ready = false;
+    bool closed = false;
+    std::vector<std::coroutine_handle<>> waiting;
+
+    struct awaiter
+    {
+        TestPipe &pipe;
+        bool await_ready() const noexcept
+        {
+            return false;
+        }
+        void await_suspend(std::coroutine_handle<> h)
+        {
+            pipe.waiting.push_back(h);
+        }
+        void await_resume() const noexcept
+        {
+        }
+    };
+
+    ptrdiff_t read_some(uint8_t *p, size_t n)
+    {
+        ready = !ready;
+        if (read_pos == data.size())
+            return closed ? 0 : -1;
+        if (!ready)
+            return -1;
+        n = std::min({n, max_per_call, data.size() - read_pos});
+        memcpy(p, data.data() + read_pos, n);
+        read_pos += n;
+        return static_cast<ptrdiff_t>(n);
+    }
+
+    ptrdiff_t write_some(const uint8_t *p, size_t n)
+    {
+        ready = !ready;
+        if (!ready)
+            return -1;
+        n = std::min(n, max_per_call);
+        data.insert(data.end(), p, p + n);
+        return static_cast<ptrdiff_t>(n);
+    }
+
+    awaiter readable()
+    {
+        return awaiter{*this};
+    }
+
+    awaiter writable()
+    {
+        return awaiter{*this};
+    }
+
+    // Resumes suspended coroutines until none are waiting
+    void run()
+    {
+        while (!waiting.empty())
+        {
+            auto h = waiting.back();
+            waiting.pop_back();
+            h.resume();
+        }
+    }
+};
+
+static datapacker::task<> write_message(TestPipe &pipe, const std::vector<int32_t> &v)
+{
+    using datapacker::endian;
+    co_await datapacker::async_write<endian::big>(pipe, static_cast<uint16_t>(0xABCD), 2.5);
+    co_await datapacker::async_write<endian::big>(pipe, v);
+    co_await datapacker::async_write<endian::little, datapacker::bytes::varint_prefix>(
+        pipe, std::string("coroutine"));
+}
+
+static datapacker::task<int> read_message(TestPipe &pipe, std::vector<int32_t> &v, std::string &s)
+{
+    using datapacker::endian;
+    uint16_t tag;
+    double d;
+    int values = 0;
+    values += co_await datapacker::async_read<endian::big>(pipe, tag);
+    values += co_await datapacker::async_read<endian::big>(pipe, d);
+    values += co_await datapacker::async_read<endian::big>(pipe, v);
+    values += co_await datapacker::async_read<endian::little, datapacker::bytes::varint_prefix>(
+        pipe, s);
+    EXPECT_EQ(tag, 0xABCD);
+    EXPECT_EQ(d, 2.5);
+    // The input has ended
+    int32_t extra;
+    values += co_await datapacker::async_read<endian::big>(pipe, extra);
+    co_return values;
+}
+
+TEST(Async, ReadAndWrite)
+{
+    TestPipe pipe;
+    std::vector<int32_t> v = {1, -2, 3, 0x7FFFFFFF};
+    auto writer = write_message(pipe, v);
+    writer.start();
+    pipe.run();
+    ASSERT_TRUE(writer.done());
+    writer.result();
+
+    // async_write produces the same bytes as stream::write
+    std::ostringstream expected;
+    datapacker::stream::write<datapacker::endian::big>(expected, static_cast<uint16_t>(0xABCD),
+                                                       2.5, v);
+    datapacker::stream::write<datapacker::endian::little, datapacker::bytes::varint_prefix>(
+        expected, std::string("coroutine"));
+    ASSERT_EQ(std::string(pipe.data.begin(), pipe.data.end()), expected.str());
+
+    pipe.closed = true;
+    std::vector<int32_t> decoded;
+    std::string s;
+    auto reader = read_message(pipe, decoded, s);
+    reader.start();
+    pipe.run();
+    ASSERT_TRUE(reader.done());
+    ASSERT_EQ(reader.result(), 4);
+    ASSERT_EQ(decoded, v);
+    ASSERT_EQ(s, "coroutine");
+
+    // Errors are rethrown by the task, the length of the vector is more than max_elements
+    TestPipe invalid;
+    invalid.data.assign(2 + 8 + 8, 0xFF);
+    invalid.closed = true;
+    auto failing = read_message(invalid, decoded, s);
+    failing.start();
+    invalid.run();
+    ASSERT_TRUE(failing.done());
+    ASSERT_THROW(failing.result(), std::runtime_error);
+}
+
+TEST(Checksums, Crc32cAndXxhash64)
+{
+    using datapacker::checksum;
+    using datapacker::crc32c;
+    using datapacker::xxhash64;
+    auto bytes_of = [](std::string_view s) { return reinterpret_cast<const uint8_t *>(s.data()); };
+    std::string_view digits = "123456789";
+    ASSERT_EQ(checksum<crc32c>(bytes_of(digits), digits.size()), 0xE3069283u);
+    std::vector<uint8_t> zeros(32, 0), ones(32, 0xFF);
+    ASSERT_EQ(checksum<crc32c>(zeros.data(), zeros.size()), 0x8A9136AAu);
+    ASSERT_EQ(checksum<crc32c>(ones.data(), ones.size()), 0x62A8AB43u);
+    ASSERT_EQ(checksum<crc32c>(nullptr, 0), 0u);
+
+    ASSERT_EQ(checksum<xxhash64>(nullptr, 0), 0xEF46DB3751D8E999ULL);
+    ASSERT_EQ(checksum<xxhash64>(bytes_of("a"), 1), 0xD24EC4F1A98C6E5BULL);
+    ASSERT_EQ(checksum<xxhash64>(bytes_of("abc"), 3), 0x44BC2CF5AD770999ULL);
+    std::string_view text = "Nobody inspects the spammish repetition";
+    ASSERT_EQ(checksum<xxhash64>(bytes_of(text), text.size()), 0xFBCEA83C8A378BF1ULL);
+
+    // Updating in pieces gives the same result as a single update
+    std::vector<uint8_t> data(1000);
+    for (size_t i = 0; i < data.size(); ++i)
+        data[i] = static_cast<uint8_t>(i * 7 + 3);
+    crc32c crc;
+    xxhash64 xxh(42);
+    for (size_t i = 0, step = 1; i < data.size(); i += step, step = step * 3 % 67 + 1)
+    {
+        size_t n = std::min(step, data.size() - i);
+        crc.update(data.data() + i, n);
+        xxh.update(data.data() + i, n);
+    }
+    ASSERT_EQ(crc.value(), checksum<crc32c>(data.data(), data.size()));
+    // The table and the crc32 instructions, if the cpu has them, give the same result
+    for (size_t n : {0, 1, 3, 4, 7, 8, 9, 1000})
+        ASSERT_EQ(datapacker::internal::crc32c_update(0xFFFFFFFFu, data.data() + 1, n - (n > 0)),
+                  datapacker::internal::crc32c_update_table(0xFFFFFFFFu, data.data() + 1,
+                                                            n - (n > 0)));
+    xxhash64 whole(42);
+    whole.update(data.data(), data.size());
+    ASSERT_EQ(xxh.value(), whole.value());
+    ASSERT_NE(xxh.value(), checksum<xxhash64>(data.data(), data.size()));
+    crc.reset();
+    ASSERT_EQ(crc.value(), 0u);
+}
+
+TEST(Checksums, WriterReaderAdapters)
+{
+    using namespace datapacker;
+    uint8_t buffer[128];
+    bytes::writer w(buffer, sizeof(buffer));
+    checksum_writer<crc32c> cw(w);
+    std::vector<uint16_t> values = {1, 2, 3, 500};
+    cw.put<endian::little>(uint32_t(7), -2.5)
+        .put_length_prefixed<endian::big, uint8_t>(std::string("frame"))
+        .put_length_prefixed<endian::little, uint16_t>(values)
+        .put_varint(300u)
+        .pad(3);
+    size_t payload = w.position();
+    w.put<endian::little>(cw.value());
+    ASSERT_TRUE(w);
+    ASSERT_EQ(cw.value(), checksum<crc32c>(buffer, payload));
+
+    bytes::reader r(buffer, w.position());
+    checksum_reader<crc32c> cr(r);
+    uint32_t id;
+    double x;
+    std::string s;
+    std::vector<uint16_t> v;
+    unsigned varint;
+    cr.get<endian::little>(id, x)
+        .get_length_prefixed<endian::big, uint8_t>(s, 16)
+        .get_length_prefixed<endian::little, uint16_t>(v, 16)
+        .get_varint(varint)
+        .skip(3);
+    uint32_t expected;
+    r.get<endian::little>(expected);
+    ASSERT_TRUE(cr);
+    ASSERT_EQ(expected, cr.value());
+    ASSERT_EQ(id, 7u);
+    ASSERT_EQ(s, "frame");
+    ASSERT_EQ(v, values);
+    ASSERT_EQ(varint, 300u);
+
+    // A corrupted byte changes the checksum
+    buffer[5] ^= 0x10;
+    bytes::reader corrupt(buffer, w.position());
+    checksum_reader<crc32c> cc(corrupt);
+    cc.skip(payload);
+    ASSERT_NE(cc.value(), expected);
+
+    // The observer of a buffered writer sees every byte of the output
+    std::ostringstream os;
+    xxhash64 xxh;
+    {
+        stream::buffered_writer bw(os, 64);
+        bw.observe([&xxh](const uint8_t *data, size_t n) { xxh.update(data, n); });
+        std::vector<uint32_t> large(100, 9);
+        for (int i = 0; i < 20; ++i)
+            bw.write<endian::big>(i, std::string("entry"));
+        bw.write<endian::little>(large);
+        bw.flush();
+    }
+    std::string out = os.str();
+    ASSERT_EQ(xxh.value(), checksum<xxhash64>(reinterpret_cast<const uint8_t *>(out.data()),
+                                              out.size()));
+}
+
+// Run length encoding, so that the compression stage can be tested without LZ4 or Zstandard
+struct RunLengthCodec
+{
+    size_t bound(size_t n) const
+    {
+        return 2 * n;
+    }
+
+    size_t compress(uint8_t *dst, size_t capacity, const uint8_t *src, size_t n)
+    {
+        size_t count = 0;
+        for (size_t i = 0; i < n;)
+        {
+            size_t run = 1;
+            while (i + run < n && run < 255 && src[i + run] == src[i])
+                ++run;
+            if (count + 2 > capacity)
+                return 0;
+            dst[count++] = static_cast<uint8_t>(run);
+            dst[count++] = src[i];
+            i += run;
+        }
+        return count;
+    }
+
+    bool decompress(uint8_t *dst, size_t size, const uint8_t *src, size_t n)
+    {
+        size_t count = 0;
+        for (size_t i = 0; i + 1 < n; i += 2)
+        {
+            if (count + src[i] > size)
+                return false;
+            memset(dst + count, src[i + 1], src[i]);
+            count += src[i];
+        }
+        return count == size && n % 2 == 0;
+    }
+};
+
+TEST(Compression, CompressedStreams)
+{
+    using namespace datapacker;
+    static_assert(block_codec<RunLengthCodec>);
+    std::vector<double> zeros(100000, 0.0);
+    std::vector<uint8_t> noise(3000);
+    for (size_t i = 0; i < noise.size(); ++i)
+        noise[i] = static_cast<uint8_t>(i * 2654435761u >> 13);
+    std::stringstream ss;
+    size_t written;
+    {
+        stream::compressed_writer<RunLengthCodec> w(ss, RunLengthCodec(), 64, 4096);
+        w.write<endian::little>(zeros).write<endian::big>(42, std::string("small"));
+        w.flush();
+        // A small block is stored as is
+        w.write<endian::big>(uint16_t(7));
+        w.flush();
+        w.write<endian::little>(noise);
+        w.flush();
+        written = w.written();
+    }
+    ASSERT_EQ(written, ss.str().size());
+    ASSERT_LT(written, zeros.size() * sizeof(double) / 10);
+
+    stream::compressed_reader<RunLengthCodec> r(ss, RunLengthCodec(), 4096);
+    std::vector<double> v;
+    int x;
+    std::string s;
+    uint16_t y;
+    std::vector<uint8_t> n;
+    r.read<endian::little>(v, zeros.size()).read<endian::big>(x).read<endian::big>(s);
+    r.read<endian::big>(y).read<endian::little>(n);
+    ASSERT_TRUE(r);
+    ASSERT_EQ(v, zeros);
+    ASSERT_EQ(x, 42);
+    ASSERT_EQ(s, "small");
+    ASSERT_EQ(y, 7);
+    ASSERT_EQ(n, noise);
+    r.read<endian::big>(y);
+    ASSERT_FALSE(r);
+
+    // The stream ends in the middle of a block
+    std::string data = ss.str();
+    std::stringstream truncated(data.substr(0, data.size() - 10));
+    stream::compressed_reader<RunLengthCodec> tr(truncated, RunLengthCodec(), 4096);
+    tr.read<endian::little>(v, zeros.size()).read<endian::big>(x).read<endian::big>(s);
+    tr.read<endian::big>(y).read<endian::little>(n);
+    ASSERT_FALSE(tr);
+
+    // Blocks larger than the limit of the reader are rejected
+    std::stringstream large(data);
+    stream::compressed_reader<RunLengthCodec> lr(large, RunLengthCodec(), 1024);
+    ASSERT_THROW(lr.read<endian::little>(v, zeros.size()), std::runtime_error);
+
+    std::string corrupt = data;
+    corrupt[0] = 7;
+    std::stringstream cs(corrupt);
+    stream::compressed_reader<RunLengthCodec> cr(cs, RunLengthCodec(), 4096);
+    ASSERT_THROW(cr.read<endian::little>(v, zeros.size()), std::runtime_error);
+}
+
+#if defined(DATAPACKER_HAS_LZ4) || defined(DATAPACKER_HAS_ZSTD)
+template <typename Codec> void compressed_round_trip()
+{
+    using namespace datapacker;
+    std::vector<double> values(50000);
+    for (size_t i = 0; i < values.size(); ++i)
+        values[i] = static_cast<double>(i % 100);
+    std::stringstream ss;
+    stream::compressed_writer<Codec> w(ss);
+    w.template write<endian::little>(values);
+    w.flush();
+    ASSERT_LT(ss.str().size(), values.size() * sizeof(double) / 2);
+    stream::compressed_reader<Codec> r(ss);
+    std::vector<double> v;
+    r.template read<endian::little>(v, values.size());
+    ASSERT_TRUE(r);
+    ASSERT_EQ(v, values);
+}
+
+TEST(Compression, Codecs)
+{
+#if defined(DATAPACKER_HAS_LZ4)
+    compressed_round_trip<datapacker::lz4_codec>();
+#endif
+#if defined(DATAPACKER_HAS_ZSTD)
+    compressed_round_trip<datapacker::zstd_codec>();
+#endif
+}
+#endif
+
+template <typename Codec, typename T> std::vector<T> integers_round_trip(const std::vector<T> &v)
+{
+    using datapacker::endian;
+    std::vector<uint8_t> buffer(integers_bound<Codec, T, varint_prefix>(v.size()));
+    int n = encode_integers<Codec, endian::big, varint_prefix>(buffer.data(), v);
+    EXPECT_GT(n, 0);
+    std::vector<T> out = {1, 2, 3};
+    EXPECT_EQ((decode_integers<Codec, endian::big, varint_prefix>(
+                  buffer.data(), static_cast<size_t>(n), out, v.size())),
+              n);
+    // Truncated input is rejected
+    std::vector<T> partial;
+    if (!v.empty())
+    {
+        EXPECT_EQ((decode_integers<Codec, endian::big, varint_prefix>(
+                      buffer.data(), static_cast<size_t>(n - 1), partial, v.size())),
+                  -1);
+    }
+    return out;
+}
+
+TEST(IntegerCodecs, RoundTrip)
+{
+    using datapacker::endian;
+    std::vector<int64_t> timestamps(1000);
+    for (size_t i = 0; i < timestamps.size(); ++i)
+        timestamps[i] = 1700000000000LL + static_cast<int64_t>(i * 1000 + i % 7);
+    std::vector<int16_t> signals = {-32768, 32767, 0, -1, 1, -32768, 5};
+    std::vector<uint32_t> ids(300);
+    for (size_t i = 0; i < ids.size(); ++i)
+        ids[i] = static_cast<uint32_t>(4000000000u + (i * 37) % 1000);
+    std::vector<uint64_t> extremes = {0, UINT64_MAX, 1, UINT64_MAX - 1};
+    std::vector<int8_t> constant(130, -5);
+    std::vector<int32_t> empty;
+
+    ASSERT_EQ(integers_round_trip<fixed_width_codec>(timestamps), timestamps);
+    ASSERT_EQ(integers_round_trip<delta_codec>(timestamps), timestamps);
+    ASSERT_EQ(integers_round_trip<frame_of_reference_codec>(timestamps), timestamps);
+    ASSERT_EQ(integers_round_trip<delta_codec>(signals), signals);
+    ASSERT_EQ(integers_round_trip<frame_of_reference_codec>(signals), signals);
+    ASSERT_EQ(integers_round_trip<delta_codec>(ids), ids);
+    ASSERT_EQ(integers_round_trip<frame_of_reference_codec>(ids), ids);
+    ASSERT_EQ(integers_round_trip<delta_codec>(extremes), extremes);
+    ASSERT_EQ(integers_round_trip<frame_of_reference_codec>(extremes), extremes);
+    ASSERT_EQ(integers_round_trip<frame_of_reference_codec>(constant), constant);
+    ASSERT_EQ(integers_round_trip<delta_codec>(empty), empty);
+    ASSERT_EQ(integers_round_trip<frame_of_reference_codec>(empty), empty);
+
+    // Every bit width, with blocks which are not full
+    for (unsigned width = 0; width <= 64; ++width)
+    {
+        std::vector<uint64_t> v(200);
+        for (size_t i = 0; i < v.size(); ++i)
+        {
+            uint64_t x = (i * 0x9E3779B97F4A7C15ULL) >> (64 - (width == 0 ? 1 : width));
+            v[i] = width == 0 ? 7 : 7 + x;
+        }
+        ASSERT_EQ(integers_round_trip<frame_of_reference_codec>(v), v) << width;
+    }
+
+    // The fixed width codec has the same format as encode_length_prefixed
+    std::vector<uint8_t> a(integers_bound<fixed_width_codec, uint32_t>(ids.size()));
+    std::vector<uint8_t> b(a.size());
+    ASSERT_EQ((encode_integers<fixed_width_codec, endian::little>(a.data(), ids)),
+              (encode_length_prefixed<endian::little>(b.data(), ids)));
+    ASSERT_EQ(a, b);
+
+    // Timestamps take 2 bytes with deltas and 17 bits with frame of reference, instead of 8 bytes
+    std::vector<uint8_t> buffer(integers_bound<delta_codec, int64_t>(timestamps.size()));
+    int delta = encode_integers<delta_codec, endian::little>(buffer.data(), timestamps);
+    int packed =
+        encode_integers<frame_of_reference_codec, endian::little>(buffer.data(), timestamps);
+    ASSERT_LT(delta, static_cast<int>(timestamps.size() * sizeof(int64_t) / 3));
+    ASSERT_LT(packed, static_cast<int>(timestamps.size() * sizeof(int64_t) / 3));
+
+    std::vector<int64_t> out;
+    ASSERT_EQ((decode_integers<frame_of_reference_codec, endian::little>(
+                  buffer.data(), buffer.size(), out, 999)),
+              -1);
+    // A bit width larger than the type is invalid
+    buffer[sizeof(size_t) + sizeof(int64_t)] = 65;
+    ASSERT_EQ((decode_integers<frame_of_reference_codec, endian::little>(
+                  buffer.data(), buffer.size(), out, 1000)),
+              -1);
+}
+
+TEST(Formats, BmpWavPng)
+{
+    using namespace datapacker;
+    uint8_t bmp[54] = {'B', 'M', 0x36, 0x4B, 0x1D, 0, 0, 0, 0, 0, 54, 0, 0, 0, 40, 0, 0, 0,
+                       0x20, 3, 0, 0, 0xA8, 0xFD, 0xFF, 0xFF, 1, 0, 32, 0};
+    formats::bmp_header header;
+    ASSERT_TRUE(formats::parse_bmp_header(bmp, sizeof(bmp), header));
+    ASSERT_EQ(header.size, 1919798u);
+    ASSERT_EQ(header.starting_offset, 54u);
+    ASSERT_EQ(header.width, 800);
+    ASSERT_EQ(header.height, -600);
+    ASSERT_EQ(header.bpp, 32);
+    ASSERT_FALSE(formats::parse_bmp_header(bmp, sizeof(bmp) - 1, header));
+    bmp[1] = 'X';
+    ASSERT_FALSE(formats::parse_bmp_header(bmp, sizeof(bmp), header));
+
+    // A WAV file with a LIST chunk before the samples
+    uint8_t wav[64] = {'R', 'I', 'F', 'F', 56, 0, 0, 0, 'W', 'A', 'V', 'E', 'f', 'm', 't', ' ',
+                       16, 0, 0, 0, 1, 0, 2, 0, 0x44, 0xAC, 0, 0, 0x10, 0xB1, 2, 0, 4, 0,
+                       16, 0, 'L', 'I', 'S', 'T', 3, 0, 0, 0, 'a', 'b', 'c', 0,
+                       'd', 'a', 't', 'a', 8, 0, 0, 0};
+    formats::wav_header wh;
+    ASSERT_TRUE(formats::parse_wav_header(wav, sizeof(wav), wh));
+    ASSERT_EQ(wh.channels, 2);
+    ASSERT_EQ(wh.sample_rate, 44100u);
+    ASSERT_EQ(wh.byte_rate, 176400u);
+    ASSERT_EQ(wh.bits_per_sample, 16);
+    size_t offset = 0, length = 0;
+    ASSERT_TRUE(
+        formats::find_riff_chunk(wav, sizeof(wav), formats::fourcc("data"), offset, length));
+    ASSERT_EQ(offset, 56u);
+    ASSERT_EQ(length, 8u);
+    ASSERT_FALSE(formats::find_riff_chunk(wav, sizeof(wav) - 1, formats::fourcc("data"), offset,
+                                          length));
+    ASSERT_FALSE(formats::find_riff_chunk(wav, sizeof(wav), formats::fourcc("fact"), offset,
+                                          length));
+    wav[8] = 'A';
+    ASSERT_FALSE(formats::parse_wav_header(wav, sizeof(wav), wh));
+
+    // The schema decodes the same values as a chain of decode_be calls
+    formats::png_header ph = {formats::PNG_SIGNATURE, 13, formats::fourcc("IHDR"), 640, 480, 8, 6,
+                              0, 0, 1, 0xDEADBEEF};
+    uint8_t png[45];
+    bytes::encode_record(png, ph);
+    bytes::encode_be(png + 33, uint32_t(0), formats::fourcc("IEND"), uint32_t(0xAE426082));
+    formats::png_header decoded;
+    ASSERT_TRUE(formats::parse_png_header(png, sizeof(png), decoded));
+    uint64_t signature;
+    uint32_t ihdr_length, ihdr_type, width, height, crc;
+    uint8_t depth, color, compression, filter, interlace;
+    bytes::decode_be(png, signature, ihdr_length, ihdr_type, width, height, depth, color,
+                     compression, filter, interlace, crc);
+    ASSERT_EQ(decoded.signature, signature);
+    ASSERT_EQ(decoded.width, width);
+    ASSERT_EQ(decoded.height, height);
+    ASSERT_EQ(decoded.interlace, interlace);
+    ASSERT_EQ(decoded.crc, crc);
+    formats::png_chunk_header chunk;
+    ASSERT_TRUE(formats::parse_png_chunk_header(png, sizeof(png), 33, chunk));
+    ASSERT_EQ(chunk.type, formats::fourcc("IEND"));
+    ASSERT_EQ(chunk.length, 0u);
+    ASSERT_FALSE(formats::parse_png_chunk_header(png, sizeof(png) - 1, 33, chunk));
+    ASSERT_FALSE(formats::parse_png_header(png, 32, decoded));
+    png[0] = 0;
+    ASSERT_FALSE(formats::parse_png_header(png, sizeof(png), decoded));
+}
+
+TEST(Ring, SingleProducer)
+{
+    using namespace datapacker;
+    ring<> queue(100);
+    ASSERT_EQ(queue.capacity(), 128u);
+    auto pop = [&queue](uint32_t &id, std::string &name) {
+        return queue.try_pop([&](bytes::reader &r) {
+            r.get<endian::little>(id).get_length_prefixed<endian::little, uint8_t>(name, 32);
+        });
+    };
+    uint32_t id = 0;
+    std::string name;
+    ASSERT_FALSE(pop(id, name));
+    // Frames of 24 bytes wrap around the end of the ring many times
+    for (uint32_t i = 0; i < 50; ++i)
+    {
+        for (uint32_t j = 0; j < 3; ++j)
+        {
+            ASSERT_TRUE(queue.try_push(16, [&](bytes::writer &w) {
+                w.put<endian::little>(i * 3 + j).put_length_prefixed<endian::little, uint8_t>(
+                    std::string(j + 1, 'x'));
+            }));
+        }
+        for (uint32_t j = 0; j < 3; ++j)
+        {
+            ASSERT_TRUE(pop(id, name));
+            ASSERT_EQ(id, i * 3 + j);
+            ASSERT_EQ(name, std::string(j + 1, 'x'));
+        }
+        ASSERT_FALSE(pop(id, name));
+    }
+    // The ring is full, and messages larger than the reserved size are discarded
+    int pushed = 0;
+    while (queue.try_push(20, [](bytes::writer &w) { w.put<endian::little>(uint32_t(7)); }))
+        ++pushed;
+    ASSERT_GT(pushed, 0);
+    ASSERT_LE(pushed * 32, 128);
+    ASSERT_FALSE(queue.try_push(200, [](bytes::writer &) {}));
+    while (pop(id, name))
+        --pushed;
+    ASSERT_EQ(pushed, 0);
+    ASSERT_FALSE(queue.try_push(4, [](bytes::writer &w) { w.put<endian::little>(uint64_t(1)); }));
+    ASSERT_FALSE(pop(id, name));
+
+    // The largest message fits in the ring once the padding till its end has been popped
+    ASSERT_TRUE(queue.try_push(4, [](bytes::writer &w) { w.put<endian::little>(uint32_t(1)); }));
+    ASSERT_TRUE(pop(id, name));
+    std::vector<uint8_t> large(queue.max_message_size(), 9);
+    auto encode_large = [&](bytes::writer &w) { w.put_bytes(large.data(), large.size()); };
+    ASSERT_FALSE(queue.try_push(large.size(), encode_large));
+    ASSERT_FALSE(pop(id, name));
+    ASSERT_TRUE(queue.try_push(large.size(), encode_large));
+    ASSERT_TRUE(queue.try_pop([](bytes::reader &r) { ASSERT_EQ(r.size(), 120u); }));
+
+    // Messages are passed between threads in order
+    ring<> spsc(4096);
+    constexpr uint64_t count = 100000;
+    std::thread producer([&spsc] {
+        for (uint64_t i = 0; i < count; ++i)
+        {
+            spsc.push(64, [i](bytes::writer &w) {
+                w.put<endian::little>(i).put_length_prefixed<endian::little, uint8_t>(
+                    std::vector<uint8_t>(i % 40, static_cast<uint8_t>(i)));
+            });
+        }
+    });
+    uint64_t expected = 0;
+    bool valid = true;
+    auto check = [&](bytes::reader &r) {
+        uint64_t value;
+        std::vector<uint8_t> payload;
+        r.get<endian::little>(value).get_length_prefixed<endian::little, uint8_t>(payload, 64);
+        valid = valid && r && value == expected && payload.size() == expected % 40;
+        ++expected;
+    };
+    while (expected < count)
+    {
+        if (!spsc.try_pop(check))
+            std::this_thread::yield();
+    }
+    producer.join();
+    ASSERT_TRUE(valid);
+}
+
+TEST(Ring, MultipleProducers)
+{
+    using namespace datapacker;
+    ring<ring_producers::multiple> queue(1 << 12);
+    constexpr uint32_t producers = 4;
+    constexpr uint32_t count = 20000;
+    std::vector<std::thread> threads;
+    for (uint32_t p = 0; p < producers; ++p)
+    {
+        threads.emplace_back([&queue, p] {
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                auto encode = [&](bytes::writer &w) {
+                    w.put<endian::big>(p, i).put_length_prefixed<endian::big, uint16_t>(
+                        std::string(i % 30, 'a'));
+                };
+                // Half of the producers reserve space with fetch-add and half with CAS
+                if (p % 2 == 0)
+                    queue.push(48, encode);
+                else
+                    while (!queue.try_push(48, encode))
+                        std::this_thread::yield();
+            }
+            // Too large for the reserved space, the consumer skips it
+            queue.push(4, [](bytes::writer &w) { w.put<endian::big>(uint64_t(0)); });
+        });
+    }
+    std::vector<uint32_t> next(producers, 0);
+    uint32_t received = 0;
+    bool valid = true;
+    auto check = [&](bytes::reader &r) {
+        uint32_t p = 0, i = 0;
+        std::string s;
+        r.get<endian::big>(p, i).get_length_prefixed<endian::big, uint16_t>(s, 64);
+        if (!r)
+        {
+            valid = false;
+            ++received;
+            return;
+        }
+        valid = valid && p < producers && next[p] == i && s.size() == i % 30;
+        if (p < producers)
+            next[p] = i + 1;
+        ++received;
+    };
+    while (received < producers * count)
+    {
+        if (!queue.try_pop(check))
+            std::this_thread::yield();
+    }
+    for (auto &t : threads)
+        t.join();
+    ASSERT_TRUE(valid);
+    ASSERT_FALSE(queue.try_pop([](bytes::reader &) {}));
+}
+
+struct PlainReading
+{
+    uint16_t sensor;
+    int32_t value;
+    double time;
+    char unit;
+};
+
+struct SingleField
+{
+    uint64_t id;
+};
+
+TEST(Structs, EncodeAndDecode)
+{
+    using datapacker::endian;
+    static_assert(datapacker::internal::field_count<PlainReading>() == 4);
+    static_assert(datapacker::bytes::struct_size<PlainReading> == 15);
+    static_assert(datapacker::bytes::struct_size<SingleField> == 8);
+
+    const PlainReading reading{513, -70000, 2.5, 'C'};
+    uint8_t buffer[datapacker::bytes::struct_size<PlainReading>];
+    uint8_t expected[sizeof(buffer)];
+    ASSERT_EQ(encode_struct<endian::big>(buffer, reading), 15);
+    encode<endian::big>(expected, reading.sensor, reading.value, reading.time, reading.unit);
+    EXPECT_EQ(memcmp(buffer, expected, sizeof(buffer)), 0);
+    EXPECT_EQ(buffer[0], 0x02);
+    EXPECT_EQ(buffer[1], 0x01);
+
+    PlainReading decoded{};
+    ASSERT_EQ(decode_struct<endian::big>(buffer, decoded), 15);
+    EXPECT_EQ(decoded.sensor, reading.sensor);
+    EXPECT_EQ(decoded.value, reading.value);
+    EXPECT_EQ(decoded.time, reading.time);
+    EXPECT_EQ(decoded.unit, reading.unit);
+
+    SingleField single{0x0102030405060708}, single_decoded{};
+    ASSERT_EQ(encode_struct<endian::little>(buffer, single), 8);
+    EXPECT_EQ(buffer[0], 0x08);
+    ASSERT_EQ(decode_struct<endian::little>(buffer, single_decoded), 8);
+    EXPECT_EQ(single_decoded.id, single.id);
+}
+
+// A stream buffer which cannot seek, like a pipe
+class UnseekableBuffer : public std::streambuf
+{
+  public:
+    explicit UnseekableBuffer(std::string data) : contents(std::move(data))
+    {
+        setg(contents.data(), contents.data(), contents.data() + contents.size());
+    }
+
+  private:
+    std::string contents;
+};
+
+TEST(Skip, BytesAndReader)
+{
+    using namespace datapacker;
+    std::string name = "skipped";
+    std::vector<uint32_t> values = {1, 2, 3};
+    uint8_t buffer[64];
+    bytes::writer w(buffer, sizeof(buffer));
+    w.put_length_prefixed<endian::little, bytes::varint_prefix>(name)
+        .put_length_prefixed<endian::little>(values)
+        .put<endian::little>(uint16_t(77));
+    ASSERT_TRUE(w);
+
+    int n = skip_length_prefixed<endian::little, std::string, varint_prefix>(buffer, w.position());
+    ASSERT_EQ(n, 8);
+    EXPECT_EQ((skip_length_prefixed<endian::little, std::vector<uint32_t>>(
+                  buffer + n, w.position() - static_cast<size_t>(n))),
+              20);
+    // Truncated and too long sequences
+    EXPECT_EQ((skip_length_prefixed<endian::little, std::string, varint_prefix>(buffer, 7)), -1);
+    EXPECT_EQ((skip_length_prefixed<endian::little, std::string, varint_prefix>(buffer, 64, 6)),
+              -1);
+
+    bytes::reader r(buffer, w.position());
+    uint16_t last = 0;
+    r.skip_length_prefixed<endian::little, std::string, varint_prefix>(100)
+        .skip_length_prefixed<endian::little, std::vector<uint32_t>>(100)
+        .get<endian::little>(last);
+    ASSERT_TRUE(r);
+    EXPECT_EQ(last, 77);
+
+    bytes::reader short_reader(buffer, 10);
+    short_reader.skip_length_prefixed<endian::little, std::string, varint_prefix>(100)
+        .skip_length_prefixed<endian::little, std::vector<uint32_t>>(100);
+    EXPECT_FALSE(short_reader);
+}
+
+TEST(Skip, Streams)
+{
+    using namespace datapacker;
+    SchemaTestRecord header{513, 2, 3.5, 4};
+    std::ostringstream os;
+    stream::write<endian::big>(os, std::vector<double>(1000, 1.5));
+    stream::write<endian::big>(os, uint32_t(5));
+    stream::write_record(os, header);
+    stream::write<endian::big, varint_prefix>(os, std::string("name"));
+    stream::write<endian::big>(os, int8_t(-3));
+    std::string data = os.str();
+
+    auto check = [](std::istream &is) {
+        int8_t last = 0;
+        stream::skip<endian::big, std::vector<double>>(is);
+        stream::skip<endian::big, uint32_t>(is);
+        stream::skip<endian::big, SchemaTestRecord>(is);
+        stream::skip<endian::big, std::string, varint_prefix>(is);
+        stream::read<endian::big>(is, last);
+        EXPECT_TRUE(is);
+        EXPECT_EQ(last, -3);
+    };
+    std::istringstream seekable(data);
+    check(seekable);
+    UnseekableBuffer buffer(data);
+    std::istream unseekable(&buffer);
+    check(unseekable);
+
+    UnseekableBuffer truncated_buffer(data.substr(0, 100));
+    std::istream truncated(&truncated_buffer);
+    stream::skip<endian::big, std::vector<double>>(truncated);
+    EXPECT_FALSE(truncated);
+
+    std::istringstream too_long(data);
+    EXPECT_THROW((stream::skip<endian::big, std::vector<double>>(too_long, 999)),
+                 std::runtime_error);
+}
+
+TEST(Skip, OffsetIndex)
+{
+    using namespace datapacker;
+    std::ostringstream os;
+    for (uint32_t i = 0; i < 50; i++)
+    {
+        stream::write<endian::little>(os, i);
+        stream::write<endian::little>(os, std::string(i, 'a'));
+    }
+    // A partial record at the end is not indexed
+    stream::write<endian::little>(os, uint32_t(50));
+    stream::write<endian::little>(os, size_t(1000));
+    std::string data = os.str();
+
+    std::istringstream is(data);
+    auto index = offset_index::build(is, [](std::istream &s) {
+        stream::skip<endian::little, uint32_t>(s);
+        stream::skip<endian::little, std::string>(s);
+    });
+    ASSERT_EQ(index.size(), 50);
+    EXPECT_EQ(index[0], 0);
+    EXPECT_EQ(index[1], 12);
+    for (uint32_t i : {49u, 7u, 0u, 23u})
+    {
+        uint32_t key;
+        std::string value;
+        index.seek(is, i);
+        stream::read<endian::little>(is, key);
+        stream::read<endian::little>(is, value);
+        ASSERT_TRUE(is);
+        EXPECT_EQ(key, i);
+        EXPECT_EQ(value.size(), i);
+    }
+
+    auto bytes = reinterpret_cast<const uint8_t *>(data.data());
+    bytes::reader r(bytes, data.size());
+    auto buffer_index = offset_index::build(r, [](bytes::reader &records) {
+        records.skip(sizeof(uint32_t)).skip_length_prefixed<endian::little, std::string>(100);
+    });
+    EXPECT_EQ(buffer_index.offsets(), index.offsets());
+    uint32_t key = 0;
+    buffer_index.reader(bytes, data.size(), 30).get<endian::little>(key);
+    EXPECT_EQ(key, 30);
+
+    offset_index saved(index.offsets());
+    EXPECT_EQ(saved[49], index[49]);
+
+    // The index ends at a record which skip_record does not move past, instead of adding its
+    // offset forever
+    int skipped = 0;
+    is.clear();
+    is.seekg(0);
+    auto stream_prefix = offset_index::build(is, [&skipped](std::istream &s) {
+        if (skipped++ < 3)
+        {
+            stream::skip<endian::little, uint32_t>(s);
+            stream::skip<endian::little, std::string>(s);
+        }
+    });
+    EXPECT_EQ(stream_prefix.size(), 3);
+    EXPECT_TRUE(offset_index::build(is, [](std::istream &) {}).empty());
+    skipped = 0;
+    bytes::reader r2(bytes, data.size());
+    auto buffer_prefix = offset_index::build(r2, [&skipped](bytes::reader &records) {
+        if (skipped++ < 3)
+            records.skip(sizeof(uint32_t)).skip_length_prefixed<endian::little, std::string>(100);
+    });
+    EXPECT_EQ(buffer_prefix.offsets(), std::vector<uint64_t>(index.offsets().begin(),
+                                                             index.offsets().begin() + 3));
+}
+
+TEST(Stats, Histogram)
+{
+    using namespace datapacker;
+    stats::histogram h;
+    EXPECT_EQ(h.quantile(0.5), 0);
+    h.buckets[0] = 1;
+    h.buckets[3] = 2;
+    h.buckets[64] = 1;
+    EXPECT_EQ(h.count(), 4);
+    EXPECT_EQ(h.quantile(0), 0);
+    EXPECT_EQ(h.quantile(0.5), 7);
+    EXPECT_EQ(h.quantile(1), std::numeric_limits<uint64_t>::max());
+    EXPECT_EQ(stats::histogram::bucket_limit(1), 1);
+    EXPECT_EQ(stats::histogram::bucket_limit(10), 1023);
+}
+
+// Only written by Stats.StreamCalls, so that no other test has added it to the report
+struct StatsTestReading
+{
+    uint32_t sensor;
+    float value;
+};
+
+template <>
+struct datapacker::bytes::schema<StatsTestReading>
+    : layout<field<&StatsTestReading::sensor>, field<&StatsTestReading::value>>
+{
+};
+
+TEST(Stats, StreamCalls)
+{
+    using namespace datapacker;
+    stats::reset();
+    std::stringstream ss;
+    std::vector<double> values(300, 1.5);
+    std::vector<int16_t> samples(5000, 3);
+    stream::write<endian::little>(ss, uint32_t(7));
+    stream::write<endian::little>(ss, values);
+    stream::write<endian::big, bytes::varint_prefix>(ss, std::string("hello"));
+    stream::write<endian::little>(ss, samples);
+    stream::write<endian::little>(ss, values);
+    stream::write<endian::little>(ss, uint32_t(8), uint32_t(9));
+    stream::write<endian::little>(ss, StatsTestReading{3, 20.5f});
+
+    uint32_t x;
+    std::vector<double> out;
+    std::string str;
+    stream::read<endian::little>(ss, x);
+    stream::read<endian::little>(ss, out);
+    stream::read<endian::big, bytes::varint_prefix>(ss, str);
+    stream::read_chunked<endian::little, int16_t>(ss, [](std::span<const int16_t>) {});
+    EXPECT_THROW(stream::read<endian::little>(ss, out, 100), std::runtime_error);
+
+    std::stringstream buffered;
+    {
+        stream::buffered_writer w(buffered);
+        w.write<endian::big>("literal");
+    }
+
+    stats::report report = stats::snapshot();
+    if (!stats::enabled)
+    {
+        EXPECT_TRUE(report.types.empty());
+        EXPECT_EQ(report.max_elements_rejections, 0);
+        return;
+    }
+
+    auto u32 = report.find<uint32_t>(endian::little);
+    ASSERT_NE(u32, nullptr);
+    EXPECT_EQ(u32->writes.calls, 3);
+    EXPECT_EQ(u32->writes.bytes, 12);
+    // Values written together are counted, but not timed
+    EXPECT_EQ(u32->writes.nanoseconds.count(), 1);
+    EXPECT_EQ(u32->writes.lengths.count(), 0);
+    EXPECT_EQ(u32->reads.calls, 1);
+    EXPECT_EQ(u32->reads.bytes, 4);
+    // Only the endianness which was used is reported
+    auto readings = report.find<StatsTestReading>(endian::little);
+    ASSERT_NE(readings, nullptr);
+    EXPECT_EQ(readings->writes.calls, 1);
+    EXPECT_EQ(readings->writes.bytes, 8);
+    EXPECT_EQ(report.find<StatsTestReading>(endian::big), nullptr);
+
+    auto doubles = report.find<std::vector<double>>(endian::little);
+    ASSERT_NE(doubles, nullptr);
+    EXPECT_EQ(doubles->writes.calls, 2);
+    EXPECT_EQ(doubles->writes.bytes, 2 * (sizeof(size_t) + 300 * sizeof(double)));
+    EXPECT_EQ(doubles->writes.lengths.buckets[std::bit_width(300u)], 2);
+    // The rejected read is counted, without its size
+    EXPECT_EQ(doubles->reads.calls, 2);
+    EXPECT_EQ(doubles->reads.nanoseconds.count(), 2);
+    EXPECT_EQ(doubles->reads.bytes, sizeof(size_t) + 300 * sizeof(double));
+    EXPECT_EQ(doubles->reads.lengths.count(), 1);
+    EXPECT_EQ(doubles->reads.lengths.quantile(0.5), 511);
+
+    auto strings = report.find<std::string>(endian::big);
+    ASSERT_NE(strings, nullptr);
+    EXPECT_EQ(strings->writes.bytes, 6);
+    EXPECT_EQ(strings->reads.bytes, 6);
+
+    auto chunks = report.find<std::span<const int16_t>>(endian::little);
+    ASSERT_NE(chunks, nullptr);
+    EXPECT_EQ(chunks->reads.calls, 1);
+    EXPECT_EQ(chunks->reads.bytes, sizeof(size_t) + 5000 * sizeof(int16_t));
+    EXPECT_EQ(chunks->reads.lengths.quantile(1), 8191);
+
+    auto literals = report.find<const char *>(endian::big);
+    ASSERT_NE(literals, nullptr);
+    EXPECT_EQ(literals->writes.calls, 1);
+    EXPECT_EQ(literals->writes.bytes, sizeof(size_t) + 7);
+
+    EXPECT_EQ(report.max_elements_rejections, 1);
+    EXPECT_EQ(report.rejected_lengths.quantile(1), 511);
+
+    stats::reset();
+    report = stats::snapshot();
+    u32 = report.find<uint32_t>(endian::little);
+    ASSERT_NE(u32, nullptr);
+    EXPECT_EQ(u32->writes.calls, 0);
+    EXPECT_EQ(report.max_elements_rejections, 0);
+}
+
 int main(int argc, char *argv[])
 {
     ::testing::InitGoogleTest(&argc, argv);